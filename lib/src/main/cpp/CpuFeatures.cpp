@@ -0,0 +1,182 @@
+#include "CpuFeatures.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+// <asm/hwcap.h>只在ARM的头文件里有, 这里抄一份用到的位
+static const uint64_t kHwcapVfp = 1 << 6;
+static const uint64_t kHwcapNeon = 1 << 12;
+static const uint64_t kHwcapIdivA = 1 << 17;
+static const uint64_t kHwcapVfpD32 = 1 << 19;
+static const uint64_t kHwcap2V8Mask = 0x1F;  // aes pmull sha1 sha2 crc32
+
+static const unsigned long kAtHwcap = 16;
+static const unsigned long kAtHwcap2 = 26;
+
+uint32_t CpuFeatures::FromArmHwcap(uint64_t hwcap, uint64_t hwcap2) {
+    uint32_t features = 0;
+    if (hwcap & kHwcapVfp) features |= kVfp;
+    if (hwcap & kHwcapVfpD32) features |= kVfpD32;
+    if (hwcap & kHwcapNeon) features |= kNeon;
+    if (hwcap & kHwcapIdivA) features |= kIdiv;
+    if (hwcap2 & kHwcap2V8Mask) features |= kArmV8;
+    return features;
+}
+
+static bool IsTokenChar(char c) {
+    return c != '\0' && c != ' ' && c != '\t' && c != '\n';
+}
+
+uint32_t CpuFeatures::FromArmCpuinfo(const char *cpuinfo) {
+    static const struct {
+        const char *name;
+        uint32_t feature;
+    } kTokens[] = {
+            {"vfp",    kVfp},
+            {"fp",     kVfp},      // 64位内核对32位进程有时给出的是arm64的名字
+            {"vfpd32", kVfpD32},
+            {"neon",   kNeon},
+            {"asimd",  kNeon},
+            {"idiva",  kIdiv},
+            {"aes",    kArmV8},
+            {"pmull",  kArmV8},
+            {"sha1",   kArmV8},
+            {"sha2",   kArmV8},
+            {"crc32",  kArmV8},
+    };
+
+    const char *line = cpuinfo;
+    while (line != nullptr && strncmp(line, "Features", 8) != 0) {
+        line = strchr(line, '\n');
+        if (line != nullptr) {
+            line++;
+        }
+    }
+    if (line == nullptr || (line = strchr(line, ':')) == nullptr) {
+        return 0;
+    }
+
+    uint32_t features = 0;
+    const char *p = line + 1;
+    while (*p != '\0' && *p != '\n') {
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+        const char *start = p;
+        while (IsTokenChar(*p)) {
+            p++;
+        }
+        size_t length = p - start;
+        for (const auto &token : kTokens) {
+            if (strlen(token.name) == length && strncmp(start, token.name, length) == 0) {
+                features |= token.feature;
+            }
+        }
+    }
+    return features;
+}
+
+#if !defined(__x86_64__) && !defined(__i386__)
+
+// 读整个文件到buffer, 返回读到的字节数; /proc下的文件stat拿不到大小, 只能读到EOF
+static size_t ReadFile(const char *path, char *buffer, size_t size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    size_t total = 0;
+    while (total < size) {
+        ssize_t n = read(fd, buffer + total, size - total);
+        if (n <= 0) {
+            break;
+        }
+        total += n;
+    }
+    close(fd);
+    return total;
+}
+
+#endif
+
+CpuFeatures CpuFeatures::Detect() {
+    CpuFeatures cpu;
+    cpu.features = 0;
+    cpu.hwcap = 0;
+    cpu.hwcap2 = 0;
+    cpu.source = kSourceNone;
+
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        cpu.source = kSourceCpuid;
+        const unsigned int kOsxsave = 1u << 27;
+        const unsigned int kAvx = 1u << 28;
+        if ((ecx & (kOsxsave | kAvx)) == (kOsxsave | kAvx)) {
+            uint32_t xcr0Low, xcr0High;
+            __asm__ volatile("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+            //xmm和ymm状态都要由系统保存
+            if ((xcr0Low & 6) == 6) {
+                cpu.features |= CpuFeatures::kAvx;
+            }
+        }
+    }
+#else
+    unsigned long auxv[128];
+    size_t size = ReadFile("/proc/self/auxv", reinterpret_cast<char *>(auxv), sizeof(auxv));
+    for (size_t i = 0; i + 1 < size / sizeof(auxv[0]); i += 2) {
+        if (auxv[i] == kAtHwcap) {
+            cpu.hwcap = auxv[i + 1];
+            cpu.source = kSourceAuxv;
+        } else if (auxv[i] == kAtHwcap2) {
+            cpu.hwcap2 = auxv[i + 1];
+        } else if (auxv[i] == 0) {
+            break;
+        }
+    }
+    if (cpu.source == kSourceAuxv) {
+        cpu.features = FromArmHwcap(cpu.hwcap, cpu.hwcap2);
+    } else {
+        //Features在第一个processor块里, 不用读完
+        char cpuinfo[4096];
+        size_t length = ReadFile("/proc/cpuinfo", cpuinfo, sizeof(cpuinfo) - 1);
+        if (length > 0) {
+            cpuinfo[length] = '\0';
+            cpu.features = FromArmCpuinfo(cpuinfo);
+            cpu.source = kSourceCpuinfo;
+        }
+    }
+#endif
+    return cpu;
+}
+
+const CpuFeatures &CpuFeatures::Get() {
+    static const CpuFeatures cpu = Detect();
+    return cpu;
+}
+
+TrampolineVariant SelectTrampolineVariant(const CpuFeatures &cpu) {
+#if defined(__x86_64__)
+    return cpu.Has(CpuFeatures::kAvx) ? kTrampolineX64Avx : kTrampolineX64Sse;
+#else
+    //armeabi-v7a是softfp, 跳板只动核心寄存器, 没有依赖特性的更优写法
+    (void) cpu;
+    return kTrampolineA32;
+#endif
+}
+
+const char *TrampolineVariantName(TrampolineVariant variant) {
+    switch (variant) {
+        case kTrampolineA32:
+            return "a32";
+        case kTrampolineX64Sse:
+            return "x64-sse";
+        case kTrampolineX64Avx:
+            return "x64-avx";
+    }
+    return "unknown";
+}
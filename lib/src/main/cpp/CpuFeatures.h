@@ -0,0 +1,66 @@
+#ifndef PROFILER_CPUFEATURES_H
+#define PROFILER_CPUFEATURES_H
+
+#include <stdint.h>
+
+/**
+ * 运行时探测的CPU特性, 进程内只探测一次.
+ *
+ * ARM从/proc/self/auxv读AT_HWCAP/AT_HWCAP2(getauxval要API 18, minSdk是15),
+ * 读不到时解析/proc/cpuinfo的Features行; x86-64用cpuid, AVX还要求系统在XCR0里
+ * 开启了ymm状态的保存.
+ */
+class CpuFeatures {
+public:
+    enum Feature {
+        kVfp = 1 << 0,
+        kVfpD32 = 1 << 1,
+        kNeon = 1 << 2,
+        kIdiv = 1 << 3,
+        kArmV8 = 1 << 4,  // AArch32下的ARMv8核, 由aes/pmull/sha/crc32推断
+        kAvx = 1 << 5,
+    };
+
+    enum Source {
+        kSourceNone = 0,
+        kSourceAuxv,
+        kSourceCpuinfo,
+        kSourceCpuid,
+    };
+
+    uint32_t features;
+    uint64_t hwcap;
+    uint64_t hwcap2;
+    Source source;
+
+    static const CpuFeatures &Get();
+
+    bool Has(Feature feature) const {
+        return (features & feature) != 0;
+    }
+
+    static uint32_t FromArmHwcap(uint64_t hwcap, uint64_t hwcap2);
+
+    /**
+     * @param cpuinfo /proc/cpuinfo的内容, 只看第一行Features
+     */
+    static uint32_t FromArmCpuinfo(const char *cpuinfo);
+
+private:
+    static CpuFeatures Detect();
+};
+
+/**
+ * 跳板模板的变体, 数值通过InnerHooker.trampolineStats()报给Java, 不能改
+ */
+enum TrampolineVariant {
+    kTrampolineA32 = 0,
+    kTrampolineX64Sse = 1,
+    kTrampolineX64Avx = 2,  // 用VEX编码保存xmm, 调用方ymm高位是脏的时也没有SSE/AVX切换开销
+};
+
+TrampolineVariant SelectTrampolineVariant(const CpuFeatures &cpu);
+
+const char *TrampolineVariantName(TrampolineVariant variant);
+
+#endif //PROFILER_CPUFEATURES_H
@@ -0,0 +1,50 @@
+#include "CpuFeatures.h"
+
+#include <gtest/gtest.h>
+
+TEST(CpuFeaturesTest, DetectsOnce) {
+    const CpuFeatures &first = CpuFeatures::Get();
+    EXPECT_EQ(&first, &CpuFeatures::Get());
+    EXPECT_NE(first.source, CpuFeatures::kSourceNone);
+}
+
+TEST(CpuFeaturesTest, ArmHwcap) {
+    // Cortex-A53上的32位进程: half thumb fastmult vfp edsp neon vfpv3 tls vfpv4 idiva idivt
+    // vfpd32 lpae evtstrm, aes pmull sha1 sha2 crc32
+    uint32_t features = CpuFeatures::FromArmHwcap(0x3FB0D6, 0x1F);
+    EXPECT_EQ(features, (uint32_t) (CpuFeatures::kVfp | CpuFeatures::kVfpD32 |
+                                    CpuFeatures::kNeon | CpuFeatures::kIdiv |
+                                    CpuFeatures::kArmV8));
+    // Cortex-A9: half thumb fastmult vfp edsp neon vfpv3 tls vfpd32, 没有idiv和ARMv8扩展
+    EXPECT_EQ(CpuFeatures::FromArmHwcap(0x8B0D6, 0),
+              (uint32_t) (CpuFeatures::kVfp | CpuFeatures::kVfpD32 | CpuFeatures::kNeon));
+}
+
+TEST(CpuFeaturesTest, ArmCpuinfo) {
+    const char *cpuinfo =
+            "processor\t: 0\n"
+            "model name\t: ARMv7 Processor rev 4 (v7l)\n"
+            "Features\t: half thumb fastmult vfp edsp neon vfpv3 tls vfpv4 idiva idivt lpae\n"
+            "CPU implementer\t: 0x41\n"
+            "Features\t: aes\n";
+    EXPECT_EQ(CpuFeatures::FromArmCpuinfo(cpuinfo),
+              (uint32_t) (CpuFeatures::kVfp | CpuFeatures::kNeon | CpuFeatures::kIdiv));
+    // vfpv3不能被当成vfp的前缀匹配到vfpd32
+    EXPECT_EQ(CpuFeatures::FromArmCpuinfo("Features: vfpv3 crc32"),
+              (uint32_t) CpuFeatures::kArmV8);
+    EXPECT_EQ(CpuFeatures::FromArmCpuinfo("processor: 0\n"), 0u);
+    EXPECT_EQ(CpuFeatures::FromArmCpuinfo(""), 0u);
+}
+
+TEST(CpuFeaturesTest, VariantSelection) {
+    CpuFeatures cpu = CpuFeatures::Get();
+#if defined(__x86_64__)
+    cpu.features = 0;
+    EXPECT_EQ(SelectTrampolineVariant(cpu), kTrampolineX64Sse);
+    cpu.features = CpuFeatures::kAvx;
+    EXPECT_EQ(SelectTrampolineVariant(cpu), kTrampolineX64Avx);
+#else
+    EXPECT_EQ(SelectTrampolineVariant(cpu), kTrampolineA32);
+#endif
+    EXPECT_STREQ(TrampolineVariantName(kTrampolineX64Avx), "x64-avx");
+}
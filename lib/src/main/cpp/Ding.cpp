@@ -3,12 +3,22 @@
 //
 
 #include "Ding.h"
+#include "CpuFeatures.h"
+#include "FFIHook.h"
+#include "ICacheBatch.h"
+#include "InstructionEncoding.h"
+#include "LocalFrame.h"
+#include "PagePool.h"
+#include "TrampolineStencil.h"
+#include "utils/async_log.h"
 #include <fb/Build.h>
 #include <fb/ALog.h>
 #include <fb/fbjni.h>
+#include <fb/fbjni/ByteBuffer.h>
 #include <unistd.h>
 #include <sys/mman.h>
 #include <dlfcn.h>
+#include <string.h>
 
 extern "C" {
 #include <stdint.h>
@@ -16,6 +26,7 @@ extern "C" {
 
 #include <cstdio>
 #include <string>
+#include <vector>
 #include <iostream>
 
 using namespace facebook::jni;
@@ -174,7 +185,7 @@ void initHook() {
     RuntimeOffset runtimeOffset;
     {
         //runtime first
-        loge("dodola", "runtimeAddress:%p", ext->getRuntime());
+        ASYNC_LOGI("dodola", "runtimeAddress:%p", ext->getRuntime());
         size_t startOffset = (pointerSize == 4) ? 200 : 384;
         size_t endOffset = startOffset + (100 * pointerSize);
         int STD_STRING_SIZE = 3 * pointerSize;
@@ -201,9 +212,9 @@ void initHook() {
                 runtimeOffset.heapOffset = heapOffset;
                 runtimeOffset.internTable = internTableOffset;
                 runtimeOffset.threadList = threadListOffset;
-                loge("dododola", "classLinker:%zu  heapOffset:%zu internTable:%zu threadList:%zu",
-                     classLinkerOffset,
-                     heapOffset, internTableOffset, threadListOffset);
+                ASYNC_LOGI("dododola", "classLinker:%zu  heapOffset:%zu internTable:%zu threadList:%zu",
+                           classLinkerOffset,
+                           heapOffset, internTableOffset, threadListOffset);
                 break;
             }
         }
@@ -218,7 +229,7 @@ void initHook() {
 
         size_t *internTableAddress = (size_t *) internTable;
         size_t *classLinkerAddress = (size_t *) classLinker;
-        loge("dodola", "runtimeAddress:%p classLinker:%zu", ext->getRuntime(), *classLinkerAddress);
+        ASYNC_LOGI("dodola", "runtimeAddress:%p classLinker:%zu", ext->getRuntime(), *classLinkerAddress);
 
 
         for (size_t offset = startOffset; offset != endOffset; offset += pointerSize) {
@@ -245,37 +256,58 @@ void initHook() {
     void *handle = dlopen("libart.so", RTLD_LAZY | RTLD_GLOBAL);
     artInterpreterToCompiledCodeBridge = dlsym(handle,
                                                "artInterpreterToCompiledCodeBridge");
-    loge("dodola", "runtimeAddress:%zu classLinker:%zu", *classLinkerAddress, *jnitrampoline);
+    ASYNC_LOGI("dodola", "runtimeAddress:%zu classLinker:%zu", *classLinkerAddress, *jnitrampoline);
 }
 
 
-extern "C" jobject JNICALL
-hookMethod(JNIEnv *env, jobject objOrClass, RegisterContext *reg, HookInfo *info) {
-//    loge("dodola", "========call hook method=========%d %s", art_method, originStr);
+#define INNER_HOOKER_CLASS "profiler/dodola/lib/InnerHooker"
+#define CALL_ORIGIN_SIGNATURE "(Lprofiler/dodola/lib/ArtMethod;Ljava/lang/Object;)V"
 
+//hook回调线程上的FindClass找不到app的类, 所以在JNI_OnLoad里先解析一次放进IdCache,
+//之后回调里只是无锁的读取
+static bool resolveCallOrigin(JNIEnv *env, jclass *innerHooker, jmethodID *method) {
+    *innerHooker = FBJNI_CACHED_CLASS(env, INNER_HOOKER_CLASS);
+    *method = FBJNI_CACHED_STATIC_METHOD(env, INNER_HOOKER_CLASS, "callOrigin",
+                                         CALL_ORIGIN_SIGNATURE);
+    return *innerHooker != nullptr && *method != nullptr;
+}
 
-    jclass innerHooker = env->FindClass("profiler/dodola/lib/InnerHooker");
-    jmethodID callOrignMethod = env->GetStaticMethodID(innerHooker, "callOrigin",
-                                                       "(Lprofiler/dodola/lib/ArtMethod;Ljava/lang/Object;)V");
-    env->CallStaticVoidMethod(innerHooker, callOrignMethod, info->reflectedMethod, objOrClass);
+static void callOrigin(JNIEnv *env, jobject reflectedMethod, jobject objOrClass) {
+    jclass innerHooker;
+    jmethodID method;
+    if (resolveCallOrigin(env, &innerHooker, &method)) {
+        env->CallStaticVoidMethod(innerHooker, method, reflectedMethod, objOrClass);
+    }
+}
 
-//    const char *originChars = env->GetStringUTFChars(originStr, 0);
-    jstring str = env->NewStringUTF("==========");
-//    loge("dodola", "getresultsssssss %d %d %s", reg->general.regs.r0, env, originChars);
-    return str;
+extern "C" jobject JNICALL
+hookMethod(JNIEnv *env, jobject objOrClass, RegisterContext *reg, HookInfo *info) {
+    //回调里的fbjni调用直接用这个env, 不用再查线程的attach状态
+    ThreadScope ts(env, facebook::jni::internal::CacheEnvTag{});
+    //这里拿不到shorty, 只用回调自己的那部分
+    return (jstring) LocalFrame::Run(env, LocalFrame::kCallbackLocalRefs, [&]() -> jobject {
+//        loge("dodola", "========call hook method=========%d %s", art_method, originStr);
+        callOrigin(env, info->reflectedMethod, objOrClass);
+
+//        const char *originChars = env->GetStringUTFChars(originStr, 0);
+        jstring str = env->NewStringUTF("==========");
+//        loge("dodola", "getresultsssssss %d %d %s", reg->general.regs.r0, env, originChars);
+        return str;
+    });
 }
 
 
 ArtMethodSpec getArtMethodSpec() {
     JNIEnv *env = Environment::current();
-    jclass process = env->FindClass("android/os/Process");
-    jmethodID setArgV0 = env->GetStaticMethodID(process, "setArgV0", "(Ljava/lang/String;)V");
+    jclass process = FBJNI_CACHED_CLASS(env, "android/os/Process");
+    jmethodID setArgV0 = FBJNI_CACHED_STATIC_METHOD(env, "android/os/Process", "setArgV0",
+                                                    "(Ljava/lang/String;)V");
     RuntimeBounds runtime_bounds;
     uint offset;
     size_t jniCodeOffset = NULL;
     size_t accessFlagsOffset = NULL;
     uint32_t expectedAccessFlags = kAccPublic | kAccStatic | kAccFinal | kAccNative;
-    size_t entrypointFieldSize = 4;//apiLevel<=21 ?8 :4
+    size_t entrypointFieldSize = sizeof(void *);//apiLevel<=21 ?8 :4
 
     runtime_bounds.start = NULL;
     runtime_bounds.end = NULL;
@@ -292,12 +324,14 @@ ArtMethodSpec getArtMethodSpec() {
     char perms[5] = {0,};
 
     maps = fopen("/proc/self/maps", "r");
-    char *libpath = const_cast<char *>("/system/lib/libandroid_runtime.so");
+    char *libpath = const_cast<char *>(sizeof(void *) == 8
+                                       ? "/system/lib64/libandroid_runtime.so"
+                                       : "/system/lib/libandroid_runtime.so");
 
     while (!found && fgets(buff, sizeof(buff), maps)) {
 
         if (strstr(buff, "r-xp") && strstr(buff, libpath)) {
-            loge("TAG", "============found %s", buff);
+            ASYNC_LOGD("TAG", "============found %s", buff);
             sscanf(buff,
                    "%"
                    G_GINT64_MODIFIER
@@ -319,7 +353,7 @@ ArtMethodSpec getArtMethodSpec() {
     }
 
     fclose(maps);
-    loge("TAG", "============found %d", found);
+    ASYNC_LOGD("TAG", "============found %d", found);
 
 
     int remaining = 2;
@@ -339,16 +373,16 @@ ArtMethodSpec getArtMethodSpec() {
             }
         }
     }
-    loge("TAG", "============make spec =========");
+    ASYNC_LOGD("TAG", "============make spec =========");
     size_t quickCodeOffset = (size_t) (jniCodeOffset + entrypointFieldSize);
-    size_t size = quickCodeOffset + 4;
+    size_t size = quickCodeOffset + entrypointFieldSize;
     ArtMethodSpec spec;
     spec.accessFlags = accessFlagsOffset;
     spec.jniCode = jniCodeOffset;
     spec.quickCode = quickCodeOffset;
     spec.size = size;
     spec.interpreterCode = jniCodeOffset - entrypointFieldSize;
-    loge("TAG", "============make spec end =========");
+    ASYNC_LOGD("TAG", "============make spec end =========");
 
     return spec;
 }
@@ -382,119 +416,106 @@ static HookInfo *enableHook(void *art_method, jobject additional_info, jobject b
 
 }
 
+//enableHook的逆过程, 只用于还没有装上的hook
+static void disableHook(HookInfo *hookInfo) {
+    JNIEnv *env = Environment::current();
+    env->DeleteGlobalRef(hookInfo->reflectedMethod);
+    env->DeleteGlobalRef(hookInfo->additionalInfo);
+    free(hookInfo);
+}
+
+
+static TrampolineStencil hookStencil;
+//按CPU特性选出的模板变体, 只在JNI_OnLoad里设置一次
+static TrampolineVariant hookVariant;
 
-#define __ masm->
-
-void GenerateDemo(MacroAssembler *masm) {
-    __ Ldr(r1, 1);
-    __ Add(r0, r0, r1);
-    __ Bx(lr);
-}
-
-
-void generatorJumpMethod(HookInfo *hookInfo, MacroAssembler *masm) {
-    loge("dodola", "hookMethod %x", (uint32_t) hookMethod);
-
-
-    __ Sub(sp, sp, Operand(14 * 4));
-    __ Str(lr, MemOperand(sp, 13 * 4));
-    __ Str(r12, MemOperand(sp, 12 * 4));
-    __ Str(r11, MemOperand(sp, 11 * 4));
-    __ Str(r10, MemOperand(sp, 10 * 4));
-    __ Str(r9, MemOperand(sp, 9 * 4));
-    __ Str(r8, MemOperand(sp, 8 * 4));
-    __ Str(r7, MemOperand(sp, 7 * 4));
-    __ Str(r6, MemOperand(sp, 6 * 4));
-    __ Str(r5, MemOperand(sp, 5 * 4));
-    __ Str(r4, MemOperand(sp, 4 * 4));
-    __ Str(r3, MemOperand(sp, 3 * 4));
-    __ Str(r2, MemOperand(sp, 2 * 4));
-    __ Str(r1, MemOperand(sp, 1 * 4));
-    __ Str(r0, MemOperand(sp, 0 * 4));
-    __ Sub(sp, sp, Operand(8));
-    //要保留r0 和 r1 寄存器，r0=>env r1 => class or obj r2=>RegisterContext r3 hook info
-    __ Mov(r2, sp);
-    __ Mov(r3, (uint32_t) hookInfo);
-    __ Mov(r4, (uint32_t) hookMethod);
-    __ Blx(r4);
-    //需要还原lr
-    __ Add(sp, sp, Operand(8));
-    __ Ldr(r1, MemOperand(sp, 4, PostIndex));
-    __ Ldr(r1, MemOperand(sp, 4, PostIndex));
-    __ Ldr(r1, MemOperand(sp, 4, PostIndex));
-    __ Ldr(r1, MemOperand(sp, 4, PostIndex));
-    __ Ldr(r1, MemOperand(sp, 4, PostIndex));
-    __ Ldr(r1, MemOperand(sp, 4, PostIndex));
-    __ Ldr(r1, MemOperand(sp, 4, PostIndex));
-    __ Ldr(r1, MemOperand(sp, 4, PostIndex));
-    __ Ldr(r1, MemOperand(sp, 4, PostIndex));
-    __ Ldr(r1, MemOperand(sp, 4, PostIndex));
-    __ Ldr(r1, MemOperand(sp, 4, PostIndex));
-    __ Ldr(r1, MemOperand(sp, 4, PostIndex));
-    __ Ldr(r1, MemOperand(sp, 4, PostIndex));
-    __ Ldr(lr, MemOperand(sp, 4, PostIndex));
-    __ Bx(lr);
-
-}
-
-
-uint32_t gens(HookInfo *hookInfo) {
-
-    MacroAssembler masm(A32);
-    Label demo;
-    masm.Bind(&demo);
-    generatorJumpMethod(hookInfo, &masm);
-    masm.FinalizeCode();
-
-    byte *code = masm.GetBuffer()->GetStartAddress<byte *>();
-    uint32_t code_size = masm.GetSizeOfCodeGenerated();
-    ExecutableMemory memory(code, code_size);
-    uint32_t
-    (*demo_function)(JNIEnv, jobject, ...) = memory.GetEntryPoint<uint32_t (*)(JNIEnv, jobject,
-                                                                               ...)>
-            (demo, masm.GetInstructionSetInUse());
-    return reinterpret_cast<uint32_t>(demo_function);
-
-}
-
-
-void testVixl() {
-    loge("dodola", "===============testVixl===========");
-
-    MacroAssembler masm;
-    Label demo;
-    masm.Bind(&demo);
-    GenerateDemo(&masm);
-    masm.FinalizeCode();
-    std::cout << std::endl;
-    std::cout << "Standard disassembly:" << std::endl;
-    PrintDisassembler print_disassembler(std::cout);
-    print_disassembler.DisassembleA32Buffer(masm.GetBuffer()->GetOffsetAddress<uint32_t *>(0),
-                                            masm.GetBuffer()->GetSizeInBytes());
-
-    byte *code = masm.GetBuffer()->GetStartAddress<byte *>();
-    uint32_t code_size = masm.GetSizeOfCodeGenerated();
-    ExecutableMemory memory(code, code_size);
-    uint32_t (*demo_function)(uint32_t) = memory.GetEntryPoint<uint32_t (*)(
-            uint32_t)>(demo, masm.GetInstructionSetInUse());
-    uint32_t input_value = 2;
-    uint32_t output_value = (*demo_function)(input_value);
-    loge("dodola", "native: demo(0x%08x) = 0x%08x\n", input_value, output_value);
+#if defined(__x86_64__)
+
+static void initTrampolineStencil() {
+    hookVariant = SelectTrampolineVariant(CpuFeatures::Get());
+    BuildTrampolineStencilX64(&hookStencil, hookVariant);
+    ASYNC_LOGI("dodola", "trampoline variant %s, stencil %zu bytes",
+               TrampolineVariantName(hookVariant), hookStencil.code.size());
 }
 
+#else
+
+//跳板模板是编译期常量, 不再经过vixl; 指令序列与原先generatorJumpMethod生成的相同
+//hookInfo和hookMethod不再跟在代码后面, 两条ldr literal的偏移在实例化时指向arena的常量岛
+static const size_t kHookInfoLoadOffset = 17 * 4;
+static const size_t kHookMethodLoadOffset = 18 * 4;
+
+static constexpr uint32_t kHookTrampolineA32[] = {
+        A32Encoder::SubImmediate(A32Encoder::kSp, A32Encoder::kSp, 14 * 4),
+        A32Encoder::Str(A32Encoder::kLr, A32Encoder::kSp, 13 * 4),
+        A32Encoder::Str(12, A32Encoder::kSp, 12 * 4),
+        A32Encoder::Str(11, A32Encoder::kSp, 11 * 4),
+        A32Encoder::Str(10, A32Encoder::kSp, 10 * 4),
+        A32Encoder::Str(9, A32Encoder::kSp, 9 * 4),
+        A32Encoder::Str(8, A32Encoder::kSp, 8 * 4),
+        A32Encoder::Str(7, A32Encoder::kSp, 7 * 4),
+        A32Encoder::Str(6, A32Encoder::kSp, 6 * 4),
+        A32Encoder::Str(5, A32Encoder::kSp, 5 * 4),
+        A32Encoder::Str(4, A32Encoder::kSp, 4 * 4),
+        A32Encoder::Str(3, A32Encoder::kSp, 3 * 4),
+        A32Encoder::Str(2, A32Encoder::kSp, 2 * 4),
+        A32Encoder::Str(1, A32Encoder::kSp, 1 * 4),
+        A32Encoder::Str(0, A32Encoder::kSp, 0 * 4),
+        A32Encoder::SubImmediate(A32Encoder::kSp, A32Encoder::kSp, 8),
+        //要保留r0 和 r1 寄存器，r0=>env r1 => class or obj r2=>RegisterContext r3 hook info
+        A32Encoder::Mov(2, A32Encoder::kSp),
+        A32Encoder::LdrLiteral(3, 0),
+        A32Encoder::LdrLiteral(4, 0),
+        A32Encoder::Blx(4),
+        //需要还原lr
+        A32Encoder::AddImmediate(A32Encoder::kSp, A32Encoder::kSp, 8),
+        A32Encoder::LdrPostIndex(1, A32Encoder::kSp, 4),
+        A32Encoder::LdrPostIndex(1, A32Encoder::kSp, 4),
+        A32Encoder::LdrPostIndex(1, A32Encoder::kSp, 4),
+        A32Encoder::LdrPostIndex(1, A32Encoder::kSp, 4),
+        A32Encoder::LdrPostIndex(1, A32Encoder::kSp, 4),
+        A32Encoder::LdrPostIndex(1, A32Encoder::kSp, 4),
+        A32Encoder::LdrPostIndex(1, A32Encoder::kSp, 4),
+        A32Encoder::LdrPostIndex(1, A32Encoder::kSp, 4),
+        A32Encoder::LdrPostIndex(1, A32Encoder::kSp, 4),
+        A32Encoder::LdrPostIndex(1, A32Encoder::kSp, 4),
+        A32Encoder::LdrPostIndex(1, A32Encoder::kSp, 4),
+        A32Encoder::LdrPostIndex(1, A32Encoder::kSp, 4),
+        A32Encoder::LdrPostIndex(1, A32Encoder::kSp, 4),
+        A32Encoder::LdrPostIndex(A32Encoder::kLr, A32Encoder::kSp, 4),
+        A32Encoder::Bx(A32Encoder::kLr),
+};
 
-void jni_testMethod(alias_ref<jclass>, jobject method, jint flags, jobject backup) {
-    JNIEnv *env = Environment::current();
-    jlong methodAddress = (jlong) env->FromReflectedMethod(method);
+static_assert(kHookTrampolineA32[kHookInfoLoadOffset / 4] == A32Encoder::LdrLiteral(3, 0) &&
+              kHookTrampolineA32[kHookMethodLoadOffset / 4] == A32Encoder::LdrLiteral(4, 0),
+              "load offsets must point at the literal loads");
+
+static void initTrampolineStencil() {
+    hookVariant = SelectTrampolineVariant(CpuFeatures::Get());
+    const uint8_t *code = reinterpret_cast<const uint8_t *>(kHookTrampolineA32);
+    hookStencil.code.assign(code, code + sizeof(kHookTrampolineA32));
+    hookStencil.literalLoad = TrampolineStencil::kA32LdrLiteral;
+    hookStencil.dataLoadOffset = kHookInfoLoadOffset;
+    hookStencil.dataLoadSize = 4;
+    hookStencil.handlerLoadOffset = kHookMethodLoadOffset;
+    hookStencil.handlerLoadSize = 4;
+    ASYNC_LOGI("dodola", "trampoline variant %s, stencil %zu bytes, hookMethod %x",
+               TrampolineVariantName(hookVariant), hookStencil.code.size(), (uint32_t) hookMethod);
+}
 
-    //判断是thumb还是art
-    uint32_t hookMethodAddress = gens(
-            enableHook(reinterpret_cast<void *>(methodAddress), nullptr, backup));
-    int runtimeType = hookMethodAddress & 1;
-    loge("dodola", "=======  %s", runtimeType == 1 ? "thumb" : "art");
+
+#endif
+
+//跳板只是模板的拷贝, 不再调用汇编器; ARM下是A32代码, 入口地址不带thumb位
+uintptr_t gens(HookInfo *hookInfo) {
+    return InstantiateTrampoline(hookStencil, hookInfo, (void *) hookMethod);
+}
+
+
+static void replaceEntry(jlong methodAddress, uintptr_t entry, jint flags) {
     ArtMethodSpec spec = getArtMethodSpec();
-    *((size_t *) (methodAddress + spec.jniCode)) = (size_t) hookMethodAddress;
-    loge("dodola", "***********************begin*********************");
+    *((size_t *) (methodAddress + spec.jniCode)) = (size_t) entry;
+    ASYNC_LOGD("dodola", "***********************begin*********************");
 
     *((int *) (methodAddress + spec.accessFlags)) = kAccNative | kAccFastNative | flags;
 
@@ -502,8 +523,151 @@ void jni_testMethod(alias_ref<jclass>, jobject method, jint flags, jobject backu
     *((size_t *) (methodAddress +
                   spec.interpreterCode)) = (size_t) artInterpreterToCompiledCodeBridge;
 
-    loge("dodola", "**********************end**********************");
+    ASYNC_LOGD("dodola", "**********************end**********************");
+}
+
+void jni_testMethod(alias_ref<jclass>, jobject method, jint flags, jobject backup) {
+    JNIEnv *env = Environment::current();
+    jlong methodAddress = (jlong) env->FromReflectedMethod(method);
 
+    //判断是thumb还是art
+    HookInfo *hookInfo = enableHook(reinterpret_cast<void *>(methodAddress), nullptr, backup);
+    uintptr_t hookMethodAddress = gens(hookInfo);
+    if (hookMethodAddress == 0) {
+        disableHook(hookInfo);
+        throwNewJavaException("java/lang/OutOfMemoryError", "failed to allocate trampoline");
+    }
+    int runtimeType = hookMethodAddress & 1;
+    ASYNC_LOGD("dodola", "=======  %s", runtimeType == 1 ? "thumb" : "art");
+    replaceEntry(methodAddress, hookMethodAddress, flags);
+}
+
+//批量hook: 先生成全部跳板, 指令缓存合并起来只刷新一次, 刷新之后才替换入口
+void jni_testMethods(alias_ref<jclass>, jobjectArray methods, jint flags, jobjectArray backups) {
+    JNIEnv *env = Environment::current();
+    if (methods == nullptr || backups == nullptr) {
+        throwNewJavaException("java/lang/NullPointerException", "%s == null",
+                              methods == nullptr ? "methods" : "backups");
+    }
+    jsize count = env->GetArrayLength(methods);
+    if (env->GetArrayLength(backups) != count) {
+        throwNewJavaException("java/lang/IllegalArgumentException",
+                              "methods.length(%d) != backups.length(%d)", count,
+                              env->GetArrayLength(backups));
+    }
+
+    std::vector<jlong> methodAddresses((size_t) count);
+    std::vector<HookInfo *> hookInfos((size_t) count);
+    std::vector<uintptr_t> entries((size_t) count);
+    jsize built = 0;
+    const char *nullElement = nullptr;
+    {
+        ICacheBatch batch;
+        for (; built < count; ++built) {
+            jobject method = env->GetObjectArrayElement(methods, built);
+            jobject backup = env->GetObjectArrayElement(backups, built);
+            if (method == nullptr || backup == nullptr) {
+                nullElement = method == nullptr ? "methods" : "backups";
+                env->DeleteLocalRef(backup);
+                env->DeleteLocalRef(method);
+                break;
+            }
+            methodAddresses[built] = (jlong) env->FromReflectedMethod(method);
+            hookInfos[built] = enableHook(reinterpret_cast<void *>(methodAddresses[built]),
+                                          nullptr, backup);
+            entries[built] = gens(hookInfos[built]);
+            env->DeleteLocalRef(backup);
+            env->DeleteLocalRef(method);
+            if (entries[built] == 0) {
+                disableHook(hookInfos[built]);
+                break;
+            }
+        }
+    }
+    //还没有替换任何入口, 失败时把已经生成的跳板和HookInfo都还回去, 整批都不生效
+    if (built < count) {
+        for (jsize i = 0; i < built; ++i) {
+            ReleaseTrampoline(hookStencil, entries[i]);
+            disableHook(hookInfos[i]);
+        }
+        if (nullElement != nullptr) {
+            throwNewJavaException("java/lang/NullPointerException", "%s[%d] == null",
+                                  nullElement, built);
+        }
+        throwNewJavaException("java/lang/OutOfMemoryError",
+                              "failed to allocate trampoline %d of %d", built, count);
+    }
+    for (jsize i = 0; i < count; ++i) {
+        replaceEntry(methodAddresses[i], entries[i], flags);
+    }
+}
+
+//与hookMethod相同的行为, 但参数已经由libffi按shorty解析好
+static void typedHookMethod(FFIClosure *, void *ret, void **args, void *userdata) {
+    TypedHook *hook = reinterpret_cast<TypedHook *>(userdata);
+    JNIEnv *env = *reinterpret_cast<JNIEnv **>(args[0]);
+    jobject objOrClass = *reinterpret_cast<jobject *>(args[1]);
+    ThreadScope ts(env, facebook::jni::internal::CacheEnvTag{});
+
+    jvalue result;
+    memset(&result, 0, sizeof(result));
+    result.l = LocalFrame::Run(env, hook->localFrameCapacity, [&]() -> jobject {
+        callOrigin(env, hook->hookInfo->reflectedMethod, objOrClass);
+        return nullptr;
+    });
+    SetTypedHookResult(hook->shorty[0], ret, &result);
+}
+
+void jni_testMethodTyped(alias_ref<jclass>, jobject method, jint flags, jobject backup,
+                         jstring shorty) {
+    JNIEnv *env = Environment::current();
+    jlong methodAddress = (jlong) env->FromReflectedMethod(method);
+
+    if (shorty == nullptr) {
+        throwNewJavaException("java/lang/NullPointerException", "shorty == null");
+    }
+    const char *shortyChars = env->GetStringUTFChars(shorty, 0);
+    HookInfo *hookInfo = enableHook(reinterpret_cast<void *>(methodAddress), nullptr, backup);
+    TypedHook *hook = CreateTypedHook(shortyChars, hookInfo, typedHookMethod);
+    env->ReleaseStringUTFChars(shorty, shortyChars);
+    if (hook == nullptr) {
+        disableHook(hookInfo);
+        throwNewJavaException("java/lang/OutOfMemoryError", "failed to allocate ffi closure");
+    }
+    replaceEntry(methodAddress, (uintptr_t) hook->GetEntry(), flags);
+}
+
+static void javaRawHookMethod(JavaRawHook *hook, void *ret, ffi_java_raw *args) {
+    JNIEnv *env = reinterpret_cast<JNIEnv *>(args[0].ptr);
+    jobject objOrClass = reinterpret_cast<jobject>(args[1].ptr);
+    ThreadScope ts(env, facebook::jni::internal::CacheEnvTag{});
+
+    jvalue result;
+    memset(&result, 0, sizeof(result));
+    result.l = LocalFrame::Run(env, hook->localFrameCapacity, [&]() -> jobject {
+        callOrigin(env, hook->hookInfo->reflectedMethod, objOrClass);
+        return nullptr;
+    });
+    SetTypedHookResult(hook->shorty[0], ret, &result);
+}
+
+void jni_testMethodRaw(alias_ref<jclass>, jobject method, jint flags, jobject backup,
+                       jstring shorty) {
+    JNIEnv *env = Environment::current();
+    jlong methodAddress = (jlong) env->FromReflectedMethod(method);
+
+    if (shorty == nullptr) {
+        throwNewJavaException("java/lang/NullPointerException", "shorty == null");
+    }
+    const char *shortyChars = env->GetStringUTFChars(shorty, 0);
+    HookInfo *hookInfo = enableHook(reinterpret_cast<void *>(methodAddress), nullptr, backup);
+    JavaRawHook *hook = CreateJavaRawHook(shortyChars, hookInfo, javaRawHookMethod);
+    env->ReleaseStringUTFChars(shorty, shortyChars);
+    if (hook == nullptr) {
+        disableHook(hookInfo);
+        throwNewJavaException("java/lang/OutOfMemoryError", "failed to allocate ffi closure");
+    }
+    replaceEntry(methodAddress, (uintptr_t) hook->GetEntry(), flags);
 }
 
 
@@ -517,13 +681,8 @@ jlong jni_getMethodAddress(alias_ref<jclass>, jobject method) {
 void jni_memput(alias_ref<jclass>, jbyteArray src, jlong dest) {
     JNIEnv *env = Environment::current();
 
-    jbyte *srcPnt = env->GetByteArrayElements(src, 0);
     jsize length = env->GetArrayLength(src);
-    unsigned char *destPnt = (unsigned char *) dest;
-    for (int i = 0; i < length; ++i) {
-        destPnt[i] = (unsigned char) srcPnt[i];
-    }
-    env->ReleaseByteArrayElements(src, srcPnt, 0);
+    env->GetByteArrayRegion(src, 0, length, (jbyte *) dest);
 }
 
 jbyteArray jni_memget(alias_ref<jclass>, jlong src, jint length) {
@@ -533,53 +692,338 @@ jbyteArray jni_memget(alias_ref<jclass>, jlong src, jint length) {
     if (dest == NULL) {
         return NULL;
     }
-    unsigned char *destPnt = (unsigned char *) env->GetByteArrayElements(dest, 0);
-    unsigned char *srcPnt = (unsigned char *) src;
-    for (int i = 0; i < length; ++i) {
-        destPnt[i] = srcPnt[i];
-    }
-    env->ReleaseByteArrayElements(dest, (jbyte *) destPnt, 0);
+    env->SetByteArrayRegion(dest, 0, length, (const jbyte *) src);
 
     return dest;
 }
 
+//读取到调用方提供的数组中,避免每次分配新的byte[]
+void jni_memgetInto(alias_ref<jclass>, jlong src, jbyteArray dest, jint offset, jint length) {
+    JNIEnv *env = Environment::current();
+
+    env->SetByteArrayRegion(dest, offset, length, (const jbyte *) src);
+}
+
+static size_t checkRanges(alias_ref<jlongArray> addresses, alias_ref<jintArray> lengths) {
+    size_t count = addresses->size();
+    if (lengths->size() != count) {
+        throwNewJavaException("java/lang/IllegalArgumentException",
+                              "addresses.length(%zu) != lengths.length(%zu)",
+                              count, lengths->size());
+    }
+    return count;
+}
+
+static size_t sumRanges(const jint *lengths, size_t count) {
+    size_t total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        //32位上多个接近2G的长度相加会回绕, 溢出同样当作放不下
+        if (lengths[i] < 0 || total > SIZE_MAX - (size_t) lengths[i]) {
+            return SIZE_MAX;
+        }
+        total += (size_t) lengths[i];
+    }
+    return total;
+}
+
+//gather: 把多段(address, length)依次拷贝到dest中,一次JNI调用完成
+void jni_memgetv(alias_ref<jclass>, alias_ref<jlongArray> addresses, alias_ref<jintArray> lengths,
+                 alias_ref<jbyteArray> dest) {
+    size_t count = checkRanges(addresses, lengths);
+    auto addressPin = addresses->pinCritical();
+    auto lengthPin = lengths->pinCritical();
+    auto destPin = dest->pinCritical();
+
+    size_t total = sumRanges(lengthPin.get(), count);
+    if (total > destPin.size()) {
+        destPin.abort();
+        lengthPin.release();
+        addressPin.release();
+        throwNewJavaException("java/lang/IndexOutOfBoundsException",
+                              "ranges do not fit into dest(%zu)", dest->size());
+    }
+
+    jbyte *out = destPin.get();
+    for (size_t i = 0; i < count; ++i) {
+        memcpy(out, (const void *) addressPin[i], (size_t) lengthPin[i]);
+        out += lengthPin[i];
+    }
+}
+
+//scatter: 把src依次写入多段(address, length)
+void jni_memputv(alias_ref<jclass>, alias_ref<jbyteArray> src, alias_ref<jlongArray> addresses,
+                 alias_ref<jintArray> lengths) {
+    size_t count = checkRanges(addresses, lengths);
+    auto addressPin = addresses->pinCritical();
+    auto lengthPin = lengths->pinCritical();
+    auto srcPin = src->pinCritical();
+
+    size_t total = sumRanges(lengthPin.get(), count);
+    if (total > srcPin.size()) {
+        srcPin.abort();
+        lengthPin.release();
+        addressPin.release();
+        throwNewJavaException("java/lang/IndexOutOfBoundsException",
+                              "ranges do not fit into src(%zu)", src->size());
+    }
+
+    const jbyte *in = srcPin.get();
+    for (size_t i = 0; i < count; ++i) {
+        memcpy((void *) addressPin[i], in, (size_t) lengthPin[i]);
+        in += lengthPin[i];
+    }
+    srcPin.abort();
+}
+
+static uint8_t *directRange(alias_ref<JByteBuffer> buffer, jint offset, jint length) {
+    size_t capacity = buffer->getDirectSize();
+    if (offset < 0 || length < 0 || (size_t) offset + (size_t) length > capacity) {
+        throwNewJavaException("java/lang/IndexOutOfBoundsException",
+                              "offset=%d length=%d capacity=%zu", offset, length, capacity);
+    }
+    return buffer->getDirectBytes() + offset;
+}
+
+void jni_memgetDirect(alias_ref<jclass>, jlong src, alias_ref<JByteBuffer> dest, jint offset,
+                      jint length) {
+    memcpy(directRange(dest, offset, length), (const void *) src, (size_t) length);
+}
+
+void jni_memputDirect(alias_ref<jclass>, alias_ref<JByteBuffer> src, jint offset, jint length,
+                      jlong dest) {
+    memcpy((void *) dest, directRange(src, offset, length), (size_t) length);
+}
+
+
+static void checkFieldLayout(alias_ref<jintArray> offsets, alias_ref<jintArray> widths) {
+    size_t fieldCount = offsets->size();
+    if (widths->size() != fieldCount) {
+        throwNewJavaException("java/lang/IllegalArgumentException",
+                              "offsets.length(%zu) != widths.length(%zu)",
+                              fieldCount, widths->size());
+    }
+    auto widthPin = widths->pinCritical();
+    for (size_t f = 0; f < fieldCount; ++f) {
+        jint width = widthPin[f];
+        if (width != 4 && width != 8) {
+            widthPin.abort();
+            throwNewJavaException("java/lang/IllegalArgumentException",
+                                  "unsupported field width %d", width);
+        }
+    }
+}
+
+//methods.length * fields.length, 32位上乘积可能回绕, 回绕后的小值会让越界检查失效
+static size_t fieldTableSize(size_t methodCount, size_t fieldCount) {
+    if (fieldCount != 0 && methodCount > SIZE_MAX / fieldCount) {
+        throwNewJavaException("java/lang/IllegalArgumentException",
+                              "%zu methods * %zu fields overflows", methodCount, fieldCount);
+    }
+    return methodCount * fieldCount;
+}
+
+//批量读取ArtMethod字段, 结果按字段分组: out[f * methods.length + i]
+void jni_readFields(alias_ref<jclass>, alias_ref<jlongArray> methods,
+                    alias_ref<jintArray> offsets, alias_ref<jintArray> widths,
+                    alias_ref<jlongArray> out) {
+    checkFieldLayout(offsets, widths);
+    size_t methodCount = methods->size();
+    size_t fieldCount = offsets->size();
+    size_t total = fieldTableSize(methodCount, fieldCount);
+    if (out->size() < total) {
+        throwNewJavaException("java/lang/IndexOutOfBoundsException",
+                              "out.length(%zu) < %zu", out->size(), total);
+    }
+
+    auto methodPin = methods->pinCritical();
+    auto offsetPin = offsets->pinCritical();
+    auto widthPin = widths->pinCritical();
+    auto outPin = out->pinCritical();
+    jlong *result = outPin.get();
+    for (size_t f = 0; f < fieldCount; ++f) {
+        jint offset = offsetPin[f];
+        if (widthPin[f] == 4) {
+            for (size_t i = 0; i < methodCount; ++i) {
+                uint32_t value;
+                memcpy(&value, (const void *) (methodPin[i] + offset), sizeof(value));
+                *result++ = value;
+            }
+        } else {
+            for (size_t i = 0; i < methodCount; ++i) {
+                uint64_t value;
+                memcpy(&value, (const void *) (methodPin[i] + offset), sizeof(value));
+                *result++ = (jlong) value;
+            }
+        }
+    }
+}
+
+//批量写入ArtMethod字段, values布局与readFields一致
+void jni_writeFields(alias_ref<jclass>, alias_ref<jlongArray> methods,
+                     alias_ref<jintArray> offsets, alias_ref<jintArray> widths,
+                     alias_ref<jlongArray> values) {
+    checkFieldLayout(offsets, widths);
+    size_t methodCount = methods->size();
+    size_t fieldCount = offsets->size();
+    size_t total = fieldTableSize(methodCount, fieldCount);
+    if (values->size() < total) {
+        throwNewJavaException("java/lang/IndexOutOfBoundsException",
+                              "values.length(%zu) < %zu", values->size(), total);
+    }
+
+    auto methodPin = methods->pinCritical();
+    auto offsetPin = offsets->pinCritical();
+    auto widthPin = widths->pinCritical();
+    auto valuePin = values->pinCritical();
+    //先整体校验,避免写到一半才发现溢出
+    for (size_t f = 0; f < fieldCount; ++f) {
+        if (widthPin[f] != 4) {
+            continue;
+        }
+        for (size_t i = 0; i < methodCount; ++i) {
+            if (valuePin[f * methodCount + i] > 0xFFFFFFFFLL) {
+                valuePin.abort();
+                widthPin.abort();
+                offsetPin.abort();
+                methodPin.abort();
+                throwNewJavaException("java/lang/IllegalStateException", "overflow may occur");
+            }
+        }
+    }
+
+    const jlong *value = valuePin.get();
+    for (size_t f = 0; f < fieldCount; ++f) {
+        jint offset = offsetPin[f];
+        if (widthPin[f] == 4) {
+            for (size_t i = 0; i < methodCount; ++i) {
+                uint32_t field = (uint32_t) *value++;
+                memcpy((void *) (methodPin[i] + offset), &field, sizeof(field));
+            }
+        } else {
+            for (size_t i = 0; i < methodCount; ++i) {
+                uint64_t field = (uint64_t) *value++;
+                memcpy((void *) (methodPin[i] + offset), &field, sizeof(field));
+            }
+        }
+    }
+    valuePin.abort();
+    widthPin.abort();
+    offsetPin.abort();
+    methodPin.abort();
+}
+
 
 jlong jni_mmap(alias_ref<jclass>, jint length) {
-    void *space = mmap(0, (size_t) length, PROT_READ | PROT_WRITE | PROT_EXEC,
-                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    if (space == MAP_FAILED) {
+    if (length <= 0) {
         return 0;
     }
-    return (jlong) space;
+    return (jlong) PagePool::Get().Allocate((size_t) length);
 }
 
 jboolean jni_munmap(alias_ref<jclass>, jlong addr, jint length) {
-    int r = munmap((void *) addr, (size_t) length);
-    if (r == -1) {
+    if (length <= 0 || !PagePool::Get().Free((void *) addr, (size_t) length)) {
         return JNI_FALSE;
     }
     return JNI_TRUE;
 }
 
+//布局与InnerHooker.POOL_STAT_*一致
+local_ref<jlongArray> jni_poolStats(alias_ref<jclass>) {
+    PagePool::Stats stats = PagePool::Get().GetStats();
+    jlong values[8 + PagePool::kClassCount] = {
+            (jlong) stats.mappedBytes,
+            (jlong) stats.usedBytes,
+            (jlong) stats.requestedBytes,
+            (jlong) stats.allocations,
+            (jlong) stats.frees,
+            (jlong) stats.mmapCalls,
+            (jlong) stats.munmapCalls,
+            (jlong) stats.cachedPages,
+    };
+    for (size_t i = 0; i < PagePool::kClassCount; ++i) {
+        values[8 + i] = (jlong) stats.classBlocks[i];
+    }
+    jsize count = (jsize) (sizeof(values) / sizeof(values[0]));
+    auto result = make_long_array(count);
+    result->setRegion(0, count, values);
+    return result;
+}
+
+local_ref<jlongArray> jni_trampolineStats(alias_ref<jclass>) {
+    const CpuFeatures &cpu = CpuFeatures::Get();
+    TrampolineArena::Stats stats = TrampolineArena::Get().GetStats();
+    ICacheBatch::Stats icache = ICacheBatch::GetStats();
+    jlong values[] = {
+            (jlong) hookVariant,
+            (jlong) cpu.features,
+            (jlong) cpu.source,
+            (jlong) cpu.hwcap,
+            (jlong) cpu.hwcap2,
+            (jlong) stats.blocks,
+            (jlong) stats.trampolines,
+            (jlong) stats.codeBytes,
+            (jlong) stats.constantBytes,
+            (jlong) stats.sharedConstantHits,
+            (jlong) icache.ranges,
+            (jlong) icache.flushes,
+            (jlong) icache.batches,
+    };
+    jsize count = (jsize) (sizeof(values) / sizeof(values[0]));
+    auto result = make_long_array(count);
+    result->setRegion(0, count, values);
+    return result;
+}
+
 jint JNICALL JNI_OnLoad(JavaVM *vm, void *) {
     return initialize(vm, [] {
 
         std::cout.rdbuf(new androidbuf);
 
-        loge("dodola", "===============hook JNI_OnLoad===========");
+        ASYNC_LOGI("dodola", "===============hook JNI_OnLoad===========");
         nativeEngineClass = findClassStatic(
                 "profiler/dodola/lib/InnerHooker");
         nativeEngineClass->registerNatives({
                                                    makeNativeMethod("testMethod", jni_testMethod),
+                                                   makeNativeMethod("testMethods", jni_testMethods),
+                                                   makeNativeMethod("testMethodTyped",
+                                                                    jni_testMethodTyped),
+                                                   makeNativeMethod("testMethodRaw",
+                                                                    jni_testMethodRaw),
                                                    makeNativeMethod("memput", jni_memput),
                                                    makeNativeMethod("memget", jni_memget),
+                                                   makeNativeMethod("memgetInto", jni_memgetInto),
+                                                   makeNativeMethod("memgetv", jni_memgetv),
+                                                   makeNativeMethod("memputv", jni_memputv),
+                                                   makeNativeMethod("memgetDirect",
+                                                                    jni_memgetDirect),
+                                                   makeNativeMethod("memputDirect",
+                                                                    jni_memputDirect),
+                                                   makeNativeMethod("readFields", jni_readFields),
+                                                   makeNativeMethod("writeFields", jni_writeFields),
                                                    makeNativeMethod("mmap", jni_mmap),
                                                    makeNativeMethod("munmap", jni_munmap),
+                                                   makeNativeMethod("poolStats", jni_poolStats),
+                                                   makeNativeMethod("trampolineStats",
+                                                                    jni_trampolineStats),
                                                    makeNativeMethod("getMethodAddress",
                                                                     jni_getMethodAddress)
                                            });
         initHook();
+        initTrampolineStencil();
+
+        jclass innerHooker;
+        jmethodID callOriginMethod;
+        if (!resolveCallOrigin(Environment::current(), &innerHooker, &callOriginMethod)) {
+            throwPendingJniExceptionAsCppException();
+        }
     });
 }
 
+void JNICALL JNI_OnUnload(JavaVM *vm, void *) {
+    JNIEnv *env = nullptr;
+    if (vm->GetEnv(reinterpret_cast<void **>(&env), JNI_VERSION_1_6) == JNI_OK) {
+        IdCache::clear(env);
+    }
+}
+
 
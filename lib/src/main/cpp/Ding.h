@@ -15,14 +15,10 @@ extern "C" {
 }
 
 #include <cstdio>
+#include <streambuf>
 #include <string>
-#include "aarch32/constants-aarch32.h"
-#include "aarch32/instructions-aarch32.h"
-#include "aarch32/macro-assembler-aarch32.h"
-#include "aarch32/disasm-aarch32.h"
-
-using namespace vixl;
-using namespace vixl::aarch32;
+#include "TrampolineX64.h"
+#include "utils/async_log.h"
 
 #include <fb/include/fb/fbjni.h>
 
@@ -35,45 +31,6 @@ JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM *vm, void *reserved);
 JNIEXPORT void JNICALL JNI_OnUnload(JavaVM *vm, void *reserved);
 
 
-class ExecutableMemory {
-public:
-    ExecutableMemory(const byte *code_start, size_t size)
-            : size_(size),
-              buffer_(reinterpret_cast<byte *>(mmap(NULL,
-                                                    size,
-                                                    PROT_READ | PROT_WRITE | PROT_EXEC,
-                                                    MAP_SHARED | MAP_ANONYMOUS,
-                                                    -1,
-                                                    0))) {
-        VIXL_ASSERT(reinterpret_cast<intptr_t>(buffer_) != -1);
-        memcpy(buffer_, code_start, size_);
-        __builtin___clear_cache((char *) (buffer_), (char *) (buffer_ + size_));
-    }
-
-//    ~ExecutableMemory() { munmap(buffer_, size_); }
-
-    template<typename T>
-    T GetEntryPoint(const Label &entry_point, InstructionSet isa) const {
-        int32_t location = entry_point.GetLocation();
-        if (isa == T32) location += 1;
-        return GetOffsetAddress<T>(location);
-    }
-
-protected:
-    template<typename T>
-    T GetOffsetAddress(int32_t offset) const {
-        VIXL_ASSERT((offset >= 0) && (static_cast<size_t>(offset) <= size_));
-        T function_address;
-        byte *buffer_address = buffer_ + offset;
-        memcpy(&function_address, &buffer_address, sizeof(T));
-        return function_address;
-    }
-
-private:
-    size_t size_;
-    byte *buffer_;
-};
-
 class androidbuf : public std::streambuf {
 public:
     enum {
@@ -90,14 +47,12 @@ private:
         return this->sync() ? traits_type::eof() : traits_type::not_eof(c);
     }
 
+    //setp时留了一个字节给结尾的0, 内容在记录里拷贝一份, 不再构造std::string
     int sync() {
         int rc = 0;
         if (this->pbase() != this->pptr()) {
-            __android_log_print(ANDROID_LOG_ERROR,
-                                "Native",
-                                "%s",
-                                std::string(this->pbase(),
-                                            this->pptr() - this->pbase()).c_str());
+            *this->pptr() = '\0';
+            ASYNC_LOGE("Native", "%s", this->pbase());
             rc = 0;
             this->setp(buffer, buffer + bufsize - 1);
         }
@@ -116,6 +71,12 @@ struct HookInfo {
 //    const char *shorty;
 };
 
+#if defined(__x86_64__)
+
+typedef RegisterContextX64 RegisterContext;
+
+#else
+
 typedef struct _RegisterContext {
     uint32_t dummy_0;
     uint32_t dummy_1;
@@ -130,6 +91,8 @@ typedef struct _RegisterContext {
     uint32_t lr;
 } RegisterContext;
 
+#endif
+
 
 
 
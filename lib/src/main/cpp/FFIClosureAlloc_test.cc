@@ -0,0 +1,160 @@
+#include "ffi.h"
+
+#include <gtest/gtest.h>
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <set>
+#include <vector>
+
+namespace {
+
+//为真时memfd_create像老内核一样返回ENOSYS
+bool memfdUnavailable = false;
+
+}  // namespace
+
+//closures.c经由syscall()调用memfd_create, 在这里拦截, 其余的原样转发
+extern "C" long syscall(long number, ...) {
+    typedef long (*SyscallFn)(long, ...);
+    static SyscallFn real = reinterpret_cast<SyscallFn>(dlsym(RTLD_NEXT, "syscall"));
+#ifdef __NR_memfd_create
+    if (number == __NR_memfd_create && memfdUnavailable) {
+        errno = ENOSYS;
+        return -1;
+    }
+#endif
+    va_list args;
+    va_start(args, number);
+    long a[6];
+    for (int i = 0; i < 6; i++) {
+        a[i] = va_arg(args, long);
+    }
+    va_end(args);
+    return real(number, a[0], a[1], a[2], a[3], a[4], a[5]);
+}
+
+namespace {
+
+size_t PageSize() {
+    return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+void *PageOf(void *address) {
+    return reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(address) & ~(PageSize() - 1));
+}
+
+bool IsMapped(void *address) {
+    unsigned char resident;
+    return mincore(PageOf(address), PageSize(), &resident) == 0;
+}
+
+void Double(ffi_cif *, void *ret, void **args, void *) {
+    *static_cast<ffi_arg *>(ret) = *static_cast<int32_t *>(args[0]) * 2;
+}
+
+//在size字节的闭包内存里建一个int32_t(int32_t)的闭包, 经由可执行别名调用
+int32_t CallThroughAlias(size_t size, int32_t value) {
+    static ffi_type *argTypes[] = {&ffi_type_sint32};
+    static ffi_cif cif;
+    if (cif.arg_types == nullptr) {
+        EXPECT_EQ(FFI_OK, ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 1, &ffi_type_sint32, argTypes));
+    }
+    void *code = nullptr;
+    ffi_closure *closure = static_cast<ffi_closure *>(ffi_closure_alloc(size, &code));
+    if (closure == nullptr) {
+        ADD_FAILURE() << "ffi_closure_alloc(" << size << ") failed";
+        return 0;
+    }
+    EXPECT_EQ(FFI_OK, ffi_prep_closure_loc(closure, &cif, Double, nullptr, code));
+    int32_t result = reinterpret_cast<int32_t (*)(int32_t)>(code)(value);
+    ffi_closure_free(closure);
+    return result;
+}
+
+class FFIClosureAllocTest : public ::testing::Test {
+protected:
+    void TearDown() override {
+        memfdUnavailable = false;
+    }
+};
+
+}  // namespace
+
+TEST_F(FFIClosureAllocTest, FreedSlotsAreReused) {
+    void *code = nullptr;
+    void *first = ffi_closure_alloc(sizeof(ffi_closure), &code);
+    ASSERT_NE(nullptr, first);
+    //可写和可执行是同一个memfd的两个映射
+    EXPECT_NE(first, code);
+    ffi_closure_free(first);
+
+    void *again = ffi_closure_alloc(sizeof(ffi_closure), &code);
+    EXPECT_EQ(first, again);
+
+    //超过一个块的数量, 逼着补充新块; 全部释放后再分配拿回的还是这些槽
+    std::vector<void *> slots;
+    std::set<void *> distinct;
+    for (size_t i = 0; i < 4 * PageSize() / sizeof(ffi_closure) + 1; i++) {
+        void *slot = ffi_closure_alloc(sizeof(ffi_closure), &code);
+        ASSERT_NE(nullptr, slot);
+        slots.push_back(slot);
+        distinct.insert(slot);
+    }
+    EXPECT_EQ(slots.size(), distinct.size());
+    EXPECT_EQ(0u, distinct.count(again));
+    for (void *slot : slots) {
+        ffi_closure_free(slot);
+    }
+    for (void *&slot : slots) {
+        slot = ffi_closure_alloc(sizeof(ffi_closure), &code);
+        EXPECT_EQ(1u, distinct.count(slot));
+    }
+    for (void *slot : slots) {
+        ffi_closure_free(slot);
+    }
+    ffi_closure_free(again);
+}
+
+TEST_F(FFIClosureAllocTest, OversizedRequestsGetTheirOwnMapping) {
+    size_t size = 3 * PageSize();
+    void *code = nullptr;
+    char *writable = static_cast<char *>(ffi_closure_alloc(size, &code));
+    ASSERT_NE(nullptr, writable);
+    ASSERT_NE(static_cast<void *>(writable), code);
+
+    //整段都能写, 从可执行别名读到的是同样的内容
+    memset(writable, 0x5a, size);
+    EXPECT_EQ(0x5a, static_cast<const char *>(code)[size - 1]);
+    EXPECT_TRUE(IsMapped(writable + size - 1));
+
+    ffi_closure_free(writable);
+    EXPECT_FALSE(IsMapped(writable));
+    EXPECT_FALSE(IsMapped(code));
+}
+
+TEST_F(FFIClosureAllocTest, FallsBackToRwxWithoutMemfd) {
+    memfdUnavailable = true;
+    size_t size = 2 * PageSize();
+    void *code = nullptr;
+    void *writable = ffi_closure_alloc(size, &code);
+    ASSERT_NE(nullptr, writable);
+    //只有一个RWX映射, 两个地址相同
+    EXPECT_EQ(writable, code);
+    ffi_closure_free(writable);
+    EXPECT_FALSE(IsMapped(writable));
+
+    EXPECT_EQ(84, CallThroughAlias(size, 42));
+}
+
+TEST_F(FFIClosureAllocTest, ExecAliasRuns) {
+    EXPECT_EQ(14, CallThroughAlias(sizeof(ffi_closure), 7));
+    EXPECT_EQ(-10, CallThroughAlias(2 * PageSize(), -5));
+}
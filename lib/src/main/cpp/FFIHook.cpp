@@ -0,0 +1,129 @@
+#include "FFIHook.h"
+#include "LocalFrame.h"
+
+#include <string.h>
+
+#include <mutex>
+#include <unordered_map>
+
+static FFIType FFITypeFromShorty(char type) {
+    switch (type) {
+        case 'Z':
+            return FFIType::kFFITypeU1;
+        case 'B':
+            return FFIType::kFFITypeS1;
+        case 'C':
+            return FFIType::kFFITypeU2;
+        case 'S':
+            return FFIType::kFFITypeS2;
+        case 'I':
+            return FFIType::kFFITypeS4;
+        case 'J':
+            return FFIType::kFFITypeS8;
+        case 'F':
+            return FFIType::kFFITypeFloat;
+        case 'D':
+            return FFIType::kFFITypeDouble;
+        case 'V':
+            return FFIType::kFFITypeVoid;
+        default:
+            //L和数组都是引用
+            return FFIType::kFFITypePointer;
+    }
+}
+
+FFICallInterface *GetShortyCallInterface(const std::string &shorty) {
+    static std::mutex lock;
+    static std::unordered_map<std::string, FFICallInterface *> cache;
+
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = cache.find(shorty);
+    if (it != cache.end()) {
+        return it->second;
+    }
+    FFICallInterface *cif = new FFICallInterface(FFITypeFromShorty(shorty[0]));
+    //JNIEnv* 和 this/class
+    cif->Parameter(FFIType::kFFITypePointer)->Parameter(FFIType::kFFITypePointer);
+    for (size_t i = 1; i < shorty.size(); ++i) {
+        cif->Parameter(FFITypeFromShorty(shorty[i]));
+    }
+    cif->FinalizeCif();
+    cache[shorty] = cif;
+    return cif;
+}
+
+TypedHook *CreateTypedHook(const std::string &shorty, HookInfo *hookInfo, FFICallback callback) {
+    TypedHook *hook = new TypedHook();
+    hook->hookInfo = hookInfo;
+    hook->shorty = shorty;
+    hook->localFrameCapacity = LocalFrame::CapacityForShorty(shorty.c_str());
+    hook->closure = GetShortyCallInterface(shorty)->CreateClosure(hook, callback);
+    if (hook->closure == nullptr) {
+        delete hook;
+        return nullptr;
+    }
+    return hook;
+}
+
+static void DispatchJavaRawHook(ffi_cif *, void *ret, ffi_java_raw *args, void *userdata) {
+    JavaRawHook *hook = reinterpret_cast<JavaRawHook *>(userdata);
+    hook->callback(hook, ret, args);
+}
+
+JavaRawHook *CreateJavaRawHook(const std::string &shorty, HookInfo *hookInfo,
+                               JavaRawHookCallback callback) {
+    void *code = nullptr;
+    ffi_java_raw_closure *closure = reinterpret_cast<ffi_java_raw_closure *>(
+            ffi_closure_alloc(sizeof(ffi_java_raw_closure), &code));
+    if (closure == nullptr) {
+        return nullptr;
+    }
+    JavaRawHook *hook = new JavaRawHook();
+    hook->hookInfo = hookInfo;
+    hook->shorty = shorty;
+    hook->localFrameCapacity = LocalFrame::CapacityForShorty(shorty.c_str());
+    hook->callback = callback;
+    hook->closure = closure;
+    hook->code = code;
+    if (ffi_prep_java_raw_closure_loc(closure, GetShortyCallInterface(shorty)->GetCif(),
+                                      DispatchJavaRawHook, hook, code) != FFI_OK) {
+        ffi_closure_free(closure);
+        delete hook;
+        return nullptr;
+    }
+    return hook;
+}
+
+void SetTypedHookResult(char returnType, void *ret, const void *value) {
+    switch (returnType) {
+        case 'V':
+            break;
+        case 'Z':
+            *reinterpret_cast<ffi_arg *>(ret) = *reinterpret_cast<const uint8_t *>(value);
+            break;
+        case 'B':
+            *reinterpret_cast<ffi_sarg *>(ret) = *reinterpret_cast<const int8_t *>(value);
+            break;
+        case 'C':
+            *reinterpret_cast<ffi_arg *>(ret) = *reinterpret_cast<const uint16_t *>(value);
+            break;
+        case 'S':
+            *reinterpret_cast<ffi_sarg *>(ret) = *reinterpret_cast<const int16_t *>(value);
+            break;
+        case 'I':
+            *reinterpret_cast<ffi_sarg *>(ret) = *reinterpret_cast<const int32_t *>(value);
+            break;
+        case 'J':
+            memcpy(ret, value, sizeof(int64_t));
+            break;
+        case 'F':
+            memcpy(ret, value, sizeof(float));
+            break;
+        case 'D':
+            memcpy(ret, value, sizeof(double));
+            break;
+        default:
+            memcpy(ret, value, sizeof(void *));
+            break;
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef PROFILER_FFIHOOK_H
+#define PROFILER_FFIHOOK_H
+
+#include <string.h>
+
+#include <string>
+
+#include "ffi_cxx.h"
+
+struct HookInfo;
+
+/**
+ * 基于libffi closure的hook, 回调拿到的是按shorty解析好的参数, 不需要再去解RegisterContext.
+ *
+ * closure的调用约定就是JNI native方法的调用约定:
+ *   args[0] => JNIEnv **, args[1] => jobject * (this或class), args[2 + i] => 第i个参数的地址
+ * float/double以及拆在两个寄存器或栈上的long/double都由libffi处理好.
+ */
+struct TypedHook {
+    HookInfo *hookInfo;
+    std::string shorty;
+    int localFrameCapacity;  // 回调的LocalFrame大小, 按shorty算好
+    FFIClosure *closure;
+
+    void *GetEntry() {
+        return closure->GetCode();
+    }
+};
+
+struct JavaRawHook;
+
+/**
+ * args是java_raw格式的参数: 按JNI参数顺序紧密排列的ffi_java_raw数组, 没有void**的间接寻址
+ *   args[0] => JNIEnv *, args[1] => this或class, 之后每个参数一个slot, long/double占两个slot
+ * slot的排布与Java局部变量表一致, 可以原样交给按Java slot取参数的代码.
+ */
+typedef void (*JavaRawHookCallback)(JavaRawHook *hook, void *ret, ffi_java_raw *args);
+
+struct JavaRawHook {
+    HookInfo *hookInfo;
+    std::string shorty;
+    int localFrameCapacity;
+    JavaRawHookCallback callback;
+    ffi_java_raw_closure *closure;
+    void *code;
+
+    void *GetEntry() {
+        return code;
+    }
+};
+
+/**
+ * @return 从slot开始的long/double参数, 32位下拼接两个slot, 64位下在第一个slot里
+ */
+static inline int64_t GetJavaRawWide(const ffi_java_raw *slot) {
+    int64_t value;
+    memcpy(&value, slot, sizeof(value));
+    return value;
+}
+
+/**
+ * @return shorty(如"VJLD")对应的JNI native方法的FFICallInterface, 相同shorty共用同一个
+ */
+FFICallInterface *GetShortyCallInterface(const std::string &shorty);
+
+/**
+ * 为hookInfo创建一个closure, callback的userdata是返回的TypedHook
+ *
+ * @return closure池耗尽或申请不到可执行内存时返回nullptr
+ */
+TypedHook *CreateTypedHook(const std::string &shorty, HookInfo *hookInfo, FFICallback callback);
+
+/**
+ * 与CreateTypedHook相同, 但callback收到java_raw格式的参数, 返回值仍用SetTypedHookResult写入ret
+ *
+ * @return 申请不到可执行内存时返回nullptr
+ */
+JavaRawHook *CreateJavaRawHook(const std::string &shorty, HookInfo *hookInfo,
+                               JavaRawHookCallback callback);
+
+/**
+ * 按shorty的返回类型把value写进closure的ret, 小于ffi_arg的整数会做符号/零扩展
+ */
+void SetTypedHookResult(char returnType, void *ret, const void *value);
+
+#endif //PROFILER_FFIHOOK_H
@@ -0,0 +1,79 @@
+#include "ffi_signature.h"
+
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+
+namespace {
+
+int64_t Mix(int32_t a, double b, int8_t c, const char *d) {
+    return a * 1000 + (int64_t) (b * 10) + c + (d[0] == 'x' ? 1000000 : 0);
+}
+
+struct Recorded {
+    int calls = 0;
+    int32_t a = 0;
+    double b = 0;
+    int8_t c = 0;
+};
+
+int8_t OnCall(void *userdata, int32_t a, double b, int8_t c) {
+    Recorded *recorded = static_cast<Recorded *>(userdata);
+    recorded->calls++;
+    recorded->a = a;
+    recorded->b = b;
+    recorded->c = c;
+    return (int8_t) (c - 1);
+}
+
+void OnVoidCall(void *userdata, int64_t value) {
+    *static_cast<int64_t *>(userdata) = value;
+}
+
+}  // namespace
+
+TEST(FFISignatureTest, DescribesTypesAtCompileTime) {
+    typedef FFISignature<int64_t(int32_t, double, int8_t, const char *)> Sig;
+    EXPECT_EQ(4u, Sig::kArgCount);
+    EXPECT_EQ(&ffi_type_sint64, Sig::ReturnType());
+    EXPECT_EQ(&ffi_type_sint32, Sig::ArgTypes()[0]);
+    EXPECT_EQ(&ffi_type_double, Sig::ArgTypes()[1]);
+    EXPECT_EQ(&ffi_type_sint8, Sig::ArgTypes()[2]);
+    EXPECT_EQ(&ffi_type_pointer, Sig::ArgTypes()[3]);
+    EXPECT_EQ(Sig::GetCif(), Sig::GetCif());
+    EXPECT_EQ(4u, Sig::GetCif()->nargs);
+}
+
+TEST(FFISignatureTest, CallPassesEveryArgument) {
+    typedef FFISignature<int64_t(int32_t, double, int8_t, const char *)> Sig;
+    EXPECT_EQ(Mix(7, 2.5, -3, "x"),
+              Sig::Call(reinterpret_cast<void *>(Mix), 7, 2.5, (int8_t) -3, "x"));
+}
+
+TEST(FFISignatureTest, TypedClosureUnpacksArgumentsAndWidensResult) {
+    Recorded recorded;
+    FFITypedClosure<int8_t(int32_t, double, int8_t)> closure(OnCall, &recorded);
+    ASSERT_NE(nullptr, closure.GetCode());
+    EXPECT_EQ(&recorded, closure.GetUserData());
+
+    typedef int8_t (*Entry)(int32_t, double, int8_t);
+    Entry entry = reinterpret_cast<Entry>(closure.GetCode());
+    EXPECT_EQ(-6, entry(-42, 1.25, -5));
+    EXPECT_EQ(1, recorded.calls);
+    EXPECT_EQ(-42, recorded.a);
+    EXPECT_EQ(1.25, recorded.b);
+    EXPECT_EQ(-5, recorded.c);
+
+    //闭包的入口也可以按同一个签名经由ffi_call调用
+    typedef FFISignature<int8_t(int32_t, double, int8_t)> Sig;
+    EXPECT_EQ(9, Sig::Call(closure.GetCode(), 1, 0.5, (int8_t) 10));
+    EXPECT_EQ(2, recorded.calls);
+}
+
+TEST(FFISignatureTest, VoidClosure) {
+    int64_t seen = 0;
+    FFITypedClosure<void(int64_t)> closure(OnVoidCall, &seen);
+    ASSERT_NE(nullptr, closure.GetCode());
+    reinterpret_cast<void (*)(int64_t)>(closure.GetCode())(INT64_C(0x123456789));
+    EXPECT_EQ(INT64_C(0x123456789), seen);
+}
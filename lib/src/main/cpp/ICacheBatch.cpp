@@ -0,0 +1,79 @@
+#include "ICacheBatch.h"
+
+#include <algorithm>
+#include <atomic>
+
+static thread_local ICacheBatch *currentBatch = nullptr;
+
+static std::atomic<size_t> rangeCount(0);
+static std::atomic<size_t> flushCount(0);
+static std::atomic<size_t> batchCount(0);
+
+ICacheBatch::ICacheBatch() : outer_(currentBatch) {
+    if (outer_ == nullptr) {
+        currentBatch = this;
+    }
+}
+
+ICacheBatch::~ICacheBatch() {
+    if (outer_ != nullptr) {
+        return;
+    }
+    currentBatch = nullptr;
+    if (ranges_.empty()) {
+        return;
+    }
+    Coalesce(&ranges_);
+    for (const Range &range : ranges_) {
+        Flush(range.begin, range.end);
+    }
+    batchCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ICacheBatch::Invalidate(const void *begin, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    rangeCount.fetch_add(1, std::memory_order_relaxed);
+    uintptr_t start = reinterpret_cast<uintptr_t>(begin);
+    ICacheBatch *batch = currentBatch;
+    if (batch == nullptr) {
+        Flush(start, start + size);
+        return;
+    }
+    Range range = {start, start + size};
+    batch->ranges_.push_back(range);
+}
+
+void ICacheBatch::Coalesce(std::vector<Range> *ranges) {
+    if (ranges->size() < 2) {
+        return;
+    }
+    std::sort(ranges->begin(), ranges->end(), [](const Range &a, const Range &b) {
+        return a.begin < b.begin;
+    });
+    size_t last = 0;
+    for (size_t i = 1; i < ranges->size(); ++i) {
+        Range &merged = (*ranges)[last];
+        const Range &next = (*ranges)[i];
+        if (next.begin <= merged.end + kCoalesceGap) {
+            merged.end = std::max(merged.end, next.end);
+        } else {
+            (*ranges)[++last] = next;
+        }
+    }
+    ranges->resize(last + 1);
+}
+
+void ICacheBatch::Flush(uintptr_t begin, uintptr_t end) {
+    __builtin___clear_cache(reinterpret_cast<char *>(begin), reinterpret_cast<char *>(end));
+    flushCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+ICacheBatch::Stats ICacheBatch::GetStats() {
+    Stats stats;
+    stats.ranges = rangeCount.load(std::memory_order_relaxed);
+    stats.flushes = flushCount.load(std::memory_order_relaxed);
+    stats.batches = batchCount.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,57 @@
+#ifndef PROFILER_ICACHEBATCH_H
+#define PROFILER_ICACHEBATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+/**
+ * 合并指令缓存维护. 写完代码后调用ICacheBatch::Invalidate:
+ * 当前线程没有活动的ICacheBatch时立即刷新, 与之前每段代码单独__builtin___clear_cache一样;
+ * 有活动的ICacheBatch时只记下范围, 析构时把相邻和重叠的范围合并, 每个合并后的范围刷新一次.
+ * 32位ARM上每次刷新都是一次cacheflush系统调用(内核里带一次屏障), 批量装hook时能省下大部分.
+ *
+ * 批次结束前记下的代码还不能被执行, 入口地址要等析构之后再发布. 嵌套的ICacheBatch并入最外层.
+ */
+class ICacheBatch {
+public:
+    struct Range {
+        uintptr_t begin;
+        uintptr_t end;
+    };
+
+    struct Stats {
+        size_t ranges;   // 记下的范围
+        size_t flushes;  // 实际的刷新次数
+        size_t batches;
+    };
+
+    // 间隔不超过一个缓存行的范围也合并, 中间多刷的部分本来就在同一行上
+    static const size_t kCoalesceGap = 64;
+
+    ICacheBatch();
+
+    ~ICacheBatch();
+
+    static void Invalidate(const void *begin, size_t size);
+
+    static Stats GetStats();
+
+    /**
+     * 按起始地址排序后合并, 结果写回ranges
+     */
+    static void Coalesce(std::vector<Range> *ranges);
+
+private:
+    ICacheBatch(const ICacheBatch &);
+
+    ICacheBatch &operator=(const ICacheBatch &);
+
+    static void Flush(uintptr_t begin, uintptr_t end);
+
+    ICacheBatch *outer_;
+    std::vector<Range> ranges_;
+};
+
+#endif //PROFILER_ICACHEBATCH_H
@@ -0,0 +1,71 @@
+#include "ICacheBatch.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+std::vector<ICacheBatch::Range> Coalesced(std::vector<ICacheBatch::Range> ranges) {
+    ICacheBatch::Coalesce(&ranges);
+    return ranges;
+}
+
+size_t Flushes() {
+    return ICacheBatch::GetStats().flushes;
+}
+
+}  // namespace
+
+TEST(ICacheBatchTest, CoalescesAdjacentAndOverlappingRanges) {
+    std::vector<ICacheBatch::Range> ranges = Coalesced({
+            {0x2000, 0x2040},
+            {0x1000, 0x1090},
+            {0x1090, 0x1100},  // 相邻
+            {0x1010, 0x1020},  // 被包含
+            {0x1110, 0x1200},  // 间隔小于一个缓存行
+            {0x3000, 0x3010},
+    });
+    ASSERT_EQ(ranges.size(), 3u);
+    EXPECT_EQ(ranges[0].begin, 0x1000u);
+    EXPECT_EQ(ranges[0].end, 0x1200u);
+    EXPECT_EQ(ranges[1].begin, 0x2000u);
+    EXPECT_EQ(ranges[1].end, 0x2040u);
+    EXPECT_EQ(ranges[2].begin, 0x3000u);
+    EXPECT_EQ(ranges[2].end, 0x3010u);
+
+    EXPECT_TRUE(Coalesced({}).empty());
+    EXPECT_EQ(Coalesced({{0x1000, 0x1004}}).size(), 1u);
+}
+
+TEST(ICacheBatchTest, FlushesImmediatelyWithoutBatch) {
+    static char code[256];
+    size_t before = Flushes();
+    ICacheBatch::Invalidate(code, 16);
+    ICacheBatch::Invalidate(code + 16, 16);
+    EXPECT_EQ(Flushes() - before, 2u);
+    ICacheBatch::Invalidate(code, 0);
+    EXPECT_EQ(Flushes() - before, 2u);
+}
+
+TEST(ICacheBatchTest, FlushesOncePerMergedRange) {
+    static char code[4096];
+    size_t before = Flushes();
+    size_t batches = ICacheBatch::GetStats().batches;
+    {
+        ICacheBatch batch;
+        for (int i = 31; i >= 0; --i) {
+            ICacheBatch::Invalidate(code + i * 40, 36);
+        }
+        {
+            //嵌套的批次并入外层, 析构时不刷新
+            ICacheBatch inner;
+            ICacheBatch::Invalidate(code + 3000, 16);
+        }
+        EXPECT_EQ(Flushes(), before);
+    }
+    EXPECT_EQ(Flushes() - before, 2u);
+    EXPECT_EQ(ICacheBatch::GetStats().batches - batches, 1u);
+
+    //批次结束后恢复立即刷新
+    ICacheBatch::Invalidate(code, 4);
+    EXPECT_EQ(Flushes() - before, 3u);
+}
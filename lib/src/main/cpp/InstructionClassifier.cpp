@@ -0,0 +1,559 @@
+#include "InstructionClassifier.h"
+
+#include <string.h>
+
+#include <vector>
+
+//表项里的寄存器字段, 字段的值为15时表示读/写pc
+enum RegisterField {
+    kFieldRm = 1 << 0,      //[3:0]
+    kFieldRs = 1 << 1,      //[11:8], T32里是Rd
+    kFieldRd = 1 << 2,      //[15:12]
+    kFieldRn = 1 << 3,      //[19:16]
+    kFieldList = 1 << 4,    //寄存器列表里的pc, [15]
+    kFieldT16Rm = 1 << 5,   //T16高寄存器指令的Rm, [6:3]
+    kFieldT16Rdn = 1 << 6,  //T16高寄存器指令的Rdn, D:[2:0]
+    kFieldRdPair = 1 << 7,  //ldrd/strd的第二个寄存器Rd+1, Rd为14时是pc
+    kFieldRmPair = 1 << 8,  //strexd的Rm+1
+};
+
+enum TargetKind {
+    kTargetNone,
+    kTargetA32Branch,
+    kTargetA32Blx,
+    kTargetA32AddPc,
+    kTargetA32SubPc,
+    kTargetA32Literal12,
+    kTargetA32Literal8,
+    kTargetA32LiteralWords,
+    kTargetT16Cond,
+    kTargetT16Branch,
+    kTargetT16Cbz,
+    kTargetT16Literal,
+    kTargetT32Cond,
+    kTargetT32Branch,
+    kTargetT32Blx,
+    kTargetT32AddPc,
+    kTargetT32SubPc,
+    kTargetT32Literal12,
+    kTargetT32LiteralWords,
+    kTargetA64Imm26,
+    kTargetA64Imm19,
+    kTargetA64Imm14,
+    kTargetA64Adr,
+    kTargetA64Adrp,
+};
+
+struct DecodeEntry {
+    uint32_t mask;
+    uint32_t value;
+    uint8_t flags;
+    uint8_t target;
+    //这些字段为pc时分别加上kInstructionPcRelative和kInstructionBranch
+    uint16_t reads;
+    uint16_t writes;
+};
+
+static const uint8_t kPcRel = kInstructionPcRelative;
+static const uint8_t kB = kInstructionBranch;
+static const uint8_t kCall = kInstructionCall;
+static const uint8_t kCond = kInstructionConditional;
+
+static const uint16_t kRm = kFieldRm;
+static const uint16_t kRs = kFieldRs;
+static const uint16_t kRd = kFieldRd;
+static const uint16_t kRn = kFieldRn;
+static const uint16_t kList = kFieldList;
+static const uint16_t kPair = kFieldRdPair;
+
+//按顺序匹配, 先列特例再列通用项
+static const DecodeEntry kA32Entries[] = {
+        //cond == 1111
+        {0xFE000000, 0xFA000000, kB | kCall | kPcRel, kTargetA32Blx, 0, 0},
+        {0xFF7FF000, 0xF55FF000, kPcRel, kTargetA32Literal12, 0, 0},  //pld literal
+        {0xFF7FF000, 0xF45FF000, kPcRel, kTargetA32Literal12, 0, 0},  //pli literal
+        {0xFF30F000, 0xF510F000, 0, kTargetNone, kRn, 0},
+        {0xFF70F000, 0xF450F000, 0, kTargetNone, kRn, 0},
+        {0xFF30F010, 0xF710F000, 0, kTargetNone, kRn | kRm, 0},
+        {0xFF70F010, 0xF650F000, 0, kTargetNone, kRn | kRm, 0},
+        {0xFE50FFFF, 0xF8100A00, kB, kTargetNone, kRn, 0},            //rfe
+        {0xFF100000, 0xF4000000, 0, kTargetNone, kRn, 0},             //vld/vst元素和结构
+        {0xFFE00000, 0xFC400000, 0, kTargetNone, kRd | kRn, kRd | kRn},
+        {0xFE000000, 0xFC000000, 0, kTargetNone, kRn, 0},
+        {0xFF10F010, 0xFE10F010, 0, kTargetNone, 0, 0},               //mrc2 APSR_nzcv
+        {0xFF000010, 0xFE000010, 0, kTargetNone, kRd, kRd},
+        {0xF0000000, 0xF0000000, 0, kTargetNone, 0, 0},
+        //跳转
+        {0x0F000000, 0x0A000000, kB | kPcRel, kTargetA32Branch, 0, 0},
+        {0x0F000000, 0x0B000000, kB | kCall | kPcRel, kTargetA32Branch, 0, 0},
+        {0xFFF000F0, 0xE7F000F0, 0, kTargetNone, 0, 0},               //udf
+        {0x0FFFFFF0, 0x012FFF10, kB, kTargetNone, kRm, 0},            //bx
+        {0x0FFFFFF0, 0x012FFF20, kB, kTargetNone, kRm, 0},            //bxj
+        {0x0FFFFFF0, 0x012FFF30, kB | kCall, kTargetNone, kRm, 0},    //blx
+        {0x0FFFFFFF, 0x0160006E, kB, kTargetNone, 0, 0},              //eret
+        //杂项, 乘法和同步
+        {0x0FB000F0, 0x01000000, 0, kTargetNone, 0, kRd},             //mrs
+        {0x0FB000F0, 0x01200000, 0, kTargetNone, kRm, 0},             //msr
+        {0x0FF000F0, 0x01600010, 0, kTargetNone, kRm, kRd},           //clz
+        {0x0F9000F0, 0x01000050, 0, kTargetNone, kRn | kRm, kRd},     //qadd
+        {0x0F9000F0, 0x01000070, 0, kTargetNone, 0, 0},               //bkpt, hvc, smc
+        {0x0F9000F0, 0x01000040, 0, kTargetNone, kRn | kRm, kRd},     //crc32
+        {0x0F900090, 0x01000080, 0, kTargetNone, kRm | kRs | kRd | kRn, kRn},
+        {0x0F900080, 0x01000000, 0, kTargetNone, 0, 0},
+        {0x0F0000F0, 0x00000090, 0, kTargetNone, kRm | kRs | kRd | kRn, kRd | kRn},
+        {0x0FF000F0, 0x01B00090, 0, kTargetNone, kRn, kRd | kPair},   //ldrexd
+        {0x0F9000F0, 0x01900090, 0, kTargetNone, kRn, kRd},           //ldrex, lda
+        {0x0F90FFF0, 0x0180FC90, 0, kTargetNone, kRn | kRm, 0},       //stl
+        {0x0FF000F0, 0x01A00090, 0, kTargetNone, kRn | kRm | kFieldRmPair, kRd},  //strexd
+        {0x0F9000F0, 0x01800090, 0, kTargetNone, kRn | kRm, kRd},     //strex
+        {0x0F8000F0, 0x01000090, 0, kTargetNone, kRn | kRm, kRd},     //swp
+        //ldrh/ldrsb/ldrsh/ldrd/strh/strd
+        {0x0F7F0090, 0x015F0090, kPcRel, kTargetA32Literal8, 0, kRd},
+        {0x0F7F00F0, 0x014F00D0, kPcRel, kTargetA32Literal8, 0, kRd | kPair},
+        {0x0E5000F0, 0x000000D0, 0, kTargetNone, kRn | kRm, kRd | kPair},  //ldrd
+        {0x0E5000F0, 0x004000D0, 0, kTargetNone, kRn, kRd | kPair},
+        {0x0E5000F0, 0x000000F0, 0, kTargetNone, kRn | kRm | kRd | kPair, 0},  //strd
+        {0x0E5000F0, 0x004000F0, 0, kTargetNone, kRn | kRd | kPair, 0},
+        {0x0E400090, 0x00000090, 0, kTargetNone, kRn | kRm | kRd, kRd},
+        {0x0E400090, 0x00400090, 0, kTargetNone, kRn | kRd, kRd},
+        //数据处理(寄存器)
+        {0x0F900010, 0x01100000, 0, kTargetNone, kRn | kRm, 0},
+        {0x0F900090, 0x01100010, 0, kTargetNone, kRn | kRm | kRs, 0},
+        {0x0FA00010, 0x01A00000, 0, kTargetNone, kRm, kRd},
+        {0x0FA00090, 0x01A00010, 0, kTargetNone, kRm | kRs, kRd},
+        {0x0E000010, 0x00000000, 0, kTargetNone, kRn | kRm, kRd},
+        {0x0E000090, 0x00000010, 0, kTargetNone, kRn | kRm | kRs, kRd},
+        //数据处理(立即数)
+        {0x0FB00000, 0x03000000, 0, kTargetNone, 0, kRd},             //movw, movt
+        {0x0FB00000, 0x03200000, 0, kTargetNone, 0, 0},               //msr, hint
+        {0x0F900000, 0x03100000, 0, kTargetNone, kRn, 0},
+        {0x0FA00000, 0x03A00000, 0, kTargetNone, 0, kRd},
+        {0x0FFF0000, 0x028F0000, kPcRel, kTargetA32AddPc, 0, kRd},    //adr
+        {0x0FFF0000, 0x024F0000, kPcRel, kTargetA32SubPc, 0, kRd},    //adr
+        {0x0E000000, 0x02000000, 0, kTargetNone, kRn, kRd},
+        //ldr/str
+        {0x0F3F0000, 0x051F0000, kPcRel, kTargetA32Literal12, 0, kRd},
+        {0x0E100000, 0x04100000, 0, kTargetNone, kRn, kRd},
+        {0x0E100000, 0x04000000, 0, kTargetNone, kRn | kRd, 0},
+        //media
+        {0x0F800010, 0x06000010, 0, kTargetNone, kRn | kRm, kRd},
+        {0x0FF000F0, 0x068000B0, 0, kTargetNone, kRn | kRm, kRd},     //sel
+        {0x0FF00030, 0x06800010, 0, kTargetNone, kRn | kRm, kRd},     //pkh
+        //其余的Rn为15表示没有加数(sxtb等), 19:16也可能是饱和位数
+        {0x0F800010, 0x06800010, 0, kTargetNone, kRm, kRd},
+        {0x0FF00010, 0x07400010, 0, kTargetNone, kRs | kRm | kRd | kRn, kRd | kRn},
+        {0x0FF000D0, 0x075000D0, 0, kTargetNone, kRs | kRm | kRd, kRn},   //smmls
+        {0x0F800010, 0x07000010, 0, kTargetNone, kRs | kRm, kRn},
+        {0x0FF000F0, 0x07800010, 0, kTargetNone, kRs | kRm, kRn},     //usad8
+        {0x0FA00070, 0x07A00050, 0, kTargetNone, kRm, kRd},           //sbfx, ubfx
+        {0x0FE00070, 0x07C00010, 0, kTargetNone, 0, kRd},             //bfc, bfi
+        {0x0E000010, 0x06000010, 0, kTargetNone, 0, 0},
+        {0x0E100010, 0x06100000, 0, kTargetNone, kRn | kRm, kRd},
+        {0x0E100010, 0x06000000, 0, kTargetNone, kRn | kRm | kRd, 0},
+        //ldm/stm
+        {0x0E100000, 0x08100000, 0, kTargetNone, kRn, kList},
+        {0x0E100000, 0x08000000, 0, kTargetNone, kRn | kList, 0},
+        //协处理器, vfp
+        {0x0F3F0E00, 0x0D1F0A00, kPcRel, kTargetA32LiteralWords, 0, 0},  //vldr literal
+        {0x0FFFFFFF, 0x0EF1FA10, 0, kTargetNone, 0, 0},               //vmrs APSR_nzcv
+        {0x0FF00FFF, 0x0EF00A10, 0, kTargetNone, 0, kRd},             //vmrs
+        {0x0F000E10, 0x0E000A10, 0, kTargetNone, kRd, kRd},           //vmov和core寄存器
+        {0x0F10F010, 0x0E10F010, 0, kTargetNone, 0, 0},               //mrc APSR_nzcv
+        {0x0FE00000, 0x0C400000, 0, kTargetNone, kRd | kRn, kRd | kRn},
+        {0x0E000000, 0x0C000000, 0, kTargetNone, kRn, 0},
+        {0x0F000010, 0x0E000010, 0, kTargetNone, kRd, kRd},
+        {0x0F000010, 0x0E000000, 0, kTargetNone, 0, 0},
+        {0x0F000000, 0x0F000000, 0, kTargetNone, 0, 0},               //svc
+};
+
+static const DecodeEntry kT16Entries[] = {
+        {0xFF87, 0x4700, kB, kTargetNone, kFieldT16Rm, 0},            //bx
+        {0xFF87, 0x4780, kB | kCall, kTargetNone, kFieldT16Rm, 0},    //blx
+        {0xFF00, 0x4400, 0, kTargetNone, kFieldT16Rm | kFieldT16Rdn, kFieldT16Rdn},
+        {0xFF00, 0x4500, 0, kTargetNone, kFieldT16Rm | kFieldT16Rdn, 0},
+        {0xFF00, 0x4600, 0, kTargetNone, kFieldT16Rm, kFieldT16Rdn},
+        {0xF800, 0x4800, kPcRel, kTargetT16Literal, 0, 0},            //ldr literal
+        {0xF800, 0xA000, kPcRel, kTargetT16Literal, 0, 0},            //adr
+        {0xF500, 0xB100, kB | kCond | kPcRel, kTargetT16Cbz, 0, 0},
+        {0xFF00, 0xBD00, kB, kTargetNone, 0, 0},                      //pop {..., pc}
+        {0xFF00, 0xDE00, 0, kTargetNone, 0, 0},                       //udf
+        {0xFF00, 0xDF00, 0, kTargetNone, 0, 0},                       //svc
+        {0xF000, 0xD000, kB | kCond | kPcRel, kTargetT16Cond, 0, 0},
+        {0xF800, 0xE000, kB | kPcRel, kTargetT16Branch, 0, 0},
+};
+
+//32位T32指令按 第一个半字 << 16 | 第二个半字 匹配
+static const DecodeEntry kT32Entries[] = {
+        //跳转和杂项控制
+        {0xFFFFFF00, 0xF3DE8F00, kB, kTargetNone, 0, 0},              //subs pc, lr
+        {0xFFF0FFFF, 0xF3C08F00, kB, kTargetNone, kRn, 0},            //bxj
+        {0xFFE0D000, 0xF3E08000, 0, kTargetNone, 0, kRs},             //mrs
+        {0xFFE0D000, 0xF3808000, 0, kTargetNone, kRn, 0},             //msr
+        {0xFB80D000, 0xF3808000, 0, kTargetNone, 0, 0},
+        {0xF800D000, 0xF0008000, kB | kCond | kPcRel, kTargetT32Cond, 0, 0},
+        {0xF800D000, 0xF0009000, kB | kPcRel, kTargetT32Branch, 0, 0},
+        {0xF800D000, 0xF000D000, kB | kCall | kPcRel, kTargetT32Branch, 0, 0},
+        {0xF800D000, 0xF000C000, kB | kCall | kPcRel, kTargetT32Blx, 0, 0},
+        //数据处理(立即数)
+        {0xFBFF8000, 0xF20F0000, kPcRel, kTargetT32AddPc, 0, kRs},    //adr
+        {0xFBFF8000, 0xF2AF0000, kPcRel, kTargetT32SubPc, 0, kRs},    //adr
+        {0xFB708000, 0xF2400000, 0, kTargetNone, 0, kRs},             //movw, movt
+        {0xFBFF8020, 0xF36F0000, 0, kTargetNone, 0, kRs},             //bfc
+        {0xFB008000, 0xF3000000, 0, kTargetNone, kRn, kRs},
+        {0xFA008000, 0xF2000000, 0, kTargetNone, kRn, kRs},
+        //modified immediate: Rn为15的orr/orn是mov/mvn, Rd为15且S为1是比较
+        {0xFBCF8000, 0xF04F0000, 0, kTargetNone, 0, kRs},
+        {0xFBF08F00, 0xF0100F00, 0, kTargetNone, kRn, 0},             //tst
+        {0xFBF08F00, 0xF0900F00, 0, kTargetNone, kRn, 0},             //teq
+        {0xFBF08F00, 0xF1100F00, 0, kTargetNone, kRn, 0},             //cmn
+        {0xFBF08F00, 0xF1B00F00, 0, kTargetNone, kRn, 0},             //cmp
+        {0xFA008000, 0xF0000000, 0, kTargetNone, kRn, kRs},
+        //ldm/stm, srs/rfe
+        {0xFFDFFFE0, 0xE80DC000, 0, kTargetNone, 0, 0},
+        {0xFFDFFFE0, 0xE98DC000, 0, kTargetNone, 0, 0},
+        {0xFFD0FFFF, 0xE810C000, kB, kTargetNone, kRn, 0},
+        {0xFFD0FFFF, 0xE990C000, kB, kTargetNone, kRn, 0},
+        {0xFE500000, 0xE8100000, 0, kTargetNone, kRn, kList},
+        {0xFE500000, 0xE8000000, 0, kTargetNone, kRn | kList, 0},
+        //ldrd/strd, 独占访问, tbb/tbh
+        {0xFFF0FFE0, 0xE8D0F000, kB, kTargetNone, kRn | kRm, 0},
+        {0xFF7F0000, 0xE95F0000, kPcRel, kTargetT32LiteralWords, 0, kRd | kRs},
+        {0xFFF00000, 0xE8400000, 0, kTargetNone, kRn | kRd, kRs},     //strex
+        {0xFFF00000, 0xE8500000, 0, kTargetNone, kRn, kRd},           //ldrex
+        {0xFFF00070, 0xE8C00070, 0, kTargetNone, kRn | kRd | kRs, kRm},  //strexd, stlexd
+        {0xFFF000C0, 0xE8C00080, 0, kTargetNone, kRn | kRd, 0},       //stl
+        {0xFFF00000, 0xE8C00000, 0, kTargetNone, kRn | kRd, kRm},
+        {0xFFF00070, 0xE8D00070, 0, kTargetNone, kRn, kRd | kRs},
+        {0xFFF00000, 0xE8D00000, 0, kTargetNone, kRn, kRd},
+        {0xFE500000, 0xE8500000, 0, kTargetNone, kRn, kRd | kRs},
+        {0xFE500000, 0xE8400000, 0, kTargetNone, kRn | kRd | kRs, 0},
+        //数据处理(移位寄存器), Rn为15的orr/orn是mov/mvn, Rd为15且S为1是比较
+        {0xFFCF0000, 0xEA4F0000, 0, kTargetNone, kRm, kRs},
+        {0xFFF08F00, 0xEA100F00, 0, kTargetNone, kRn | kRm, 0},
+        {0xFFF08F00, 0xEA900F00, 0, kTargetNone, kRn | kRm, 0},
+        {0xFFF08F00, 0xEB100F00, 0, kTargetNone, kRn | kRm, 0},
+        {0xFFF08F00, 0xEBB00F00, 0, kTargetNone, kRn | kRm, 0},
+        {0xFE000000, 0xEA000000, 0, kTargetNone, kRn | kRm, kRs},
+        //协处理器, vfp, neon
+        {0xFF3F0E00, 0xED1F0A00, kPcRel, kTargetT32LiteralWords, 0, 0},  //vldr literal
+        {0xFFFFFFFF, 0xEEF1FA10, 0, kTargetNone, 0, 0},
+        {0xFFF00FFF, 0xEEF00A10, 0, kTargetNone, 0, kRd},
+        {0xEF000E10, 0xEE000A10, 0, kTargetNone, kRd, kRd},
+        {0xEF10F010, 0xEE10F010, 0, kTargetNone, 0, 0},
+        {0xEFE00000, 0xEC400000, 0, kTargetNone, kRd | kRn, kRd | kRn},
+        {0xEE000000, 0xEC000000, 0, kTargetNone, kRn, 0},
+        {0xEF000010, 0xEE000010, 0, kTargetNone, kRd, kRd},
+        {0xEF000010, 0xEE000000, 0, kTargetNone, 0, 0},
+        {0xEF000000, 0xEF000000, 0, kTargetNone, 0, 0},
+        //ldr/str, Rt为15且没有写回的字节/半字加载是pld/pli
+        {0xFF100000, 0xF9000000, 0, kTargetNone, kRn, 0},
+        {0xFE5FF000, 0xF81FF000, kPcRel, kTargetT32Literal12, 0, 0},
+        {0xFE1F0000, 0xF81F0000, kPcRel, kTargetT32Literal12, 0, kRd},
+        {0xFED0F000, 0xF890F000, 0, kTargetNone, kRn, 0},
+        {0xFE50FF00, 0xF810FC00, 0, kTargetNone, kRn, 0},
+        {0xFE50FFC0, 0xF810F000, 0, kTargetNone, kRn | kRm, 0},
+        {0xFE900FC0, 0xF8100000, 0, kTargetNone, kRn | kRm, kRd},
+        {0xFE900FC0, 0xF8000000, 0, kTargetNone, kRn | kRm | kRd, 0},
+        {0xFE700000, 0xF8500000, 0, kTargetNone, kRn, kRd},
+        {0xFE500000, 0xF8100000, 0, kTargetNone, kRn, kRd},
+        {0xFE100000, 0xF8000000, 0, kTargetNone, kRn | kRd, 0},
+        //数据处理(寄存器), Rn为15的扩展指令没有加数
+        {0xFF8FF080, 0xFA0FF080, 0, kTargetNone, kRm, kRs},
+        {0xFF000000, 0xFA000000, 0, kTargetNone, kRn | kRm, kRs},
+        //乘法, 除了mls和smmls, Ra为15表示不累加
+        {0xFFD0F0F0, 0xFB90F0F0, 0, kTargetNone, kRn | kRm, kRs},     //sdiv, udiv
+        {0xFF800000, 0xFB800000, 0, kTargetNone, kRn | kRm | kRd | kRs, kRd | kRs},
+        {0xFFF000F0, 0xFB000010, 0, kTargetNone, kRn | kRm | kRd, kRs},
+        {0xFFF00000, 0xFB600000, 0, kTargetNone, kRn | kRm | kRd, kRs},
+        {0xFF80F000, 0xFB00F000, 0, kTargetNone, kRn | kRm, kRs},
+        {0xFF800000, 0xFB000000, 0, kTargetNone, kRn | kRm | kRd, kRs},
+};
+
+static const DecodeEntry kA64Entries[] = {
+        {0xFC000000, 0x14000000, kB | kPcRel, kTargetA64Imm26, 0, 0},
+        {0xFC000000, 0x94000000, kB | kCall | kPcRel, kTargetA64Imm26, 0, 0},
+        {0xFF000010, 0x54000000, kB | kCond | kPcRel, kTargetA64Imm19, 0, 0},
+        {0x7E000000, 0x34000000, kB | kCond | kPcRel, kTargetA64Imm19, 0, 0},  //cbz, cbnz
+        {0x7E000000, 0x36000000, kB | kCond | kPcRel, kTargetA64Imm14, 0, 0},  //tbz, tbnz
+        {0xFEE00000, 0xD6200000, kB | kCall, kTargetNone, 0, 0},      //blr, blraa
+        {0xFE000000, 0xD6000000, kB, kTargetNone, 0, 0},              //br, ret, eret
+        {0x9F000000, 0x10000000, kPcRel, kTargetA64Adr, 0, 0},
+        {0x9F000000, 0x90000000, kPcRel, kTargetA64Adrp, 0, 0},
+        {0x3B000000, 0x18000000, kPcRel, kTargetA64Imm19, 0, 0},      //ldr literal
+};
+
+/**
+ * 按指令高位分桶, 每个桶只保留可能匹配的表项(保持原顺序), 查找时只扫一个桶
+ */
+class DecodeTable {
+public:
+    DecodeTable(const DecodeEntry *entries, size_t count, unsigned keyShift, unsigned keyBits)
+            : keyShift_(keyShift), buckets_((1u << keyBits) + 1) {
+        uint32_t keyMask = ((1u << keyBits) - 1) << keyShift;
+        for (uint32_t key = 0; key < (1u << keyBits); ++key) {
+            buckets_[key] = (uint32_t) index_.size();
+            for (size_t i = 0; i < count; ++i) {
+                if (((entries[i].value ^ (key << keyShift)) & entries[i].mask & keyMask) == 0) {
+                    index_.push_back(&entries[i]);
+                }
+            }
+        }
+        buckets_[1u << keyBits] = (uint32_t) index_.size();
+    }
+
+    const DecodeEntry &Find(uint32_t instruction) const {
+        uint32_t key = instruction >> keyShift_;
+        for (uint32_t i = buckets_[key]; i < buckets_[key + 1]; ++i) {
+            if ((instruction & index_[i]->mask) == index_[i]->value) {
+                return *index_[i];
+            }
+        }
+        return kUnmatched;
+    }
+
+private:
+    static const DecodeEntry kUnmatched;
+
+    unsigned keyShift_;
+    std::vector<uint32_t> buckets_;
+    std::vector<const DecodeEntry *> index_;
+};
+
+const DecodeEntry DecodeTable::kUnmatched = {0, 0, 0, kTargetNone, 0, 0};
+
+#define ARRAY_COUNT(array) (sizeof(array) / sizeof((array)[0]))
+
+static const DecodeTable &A32Table() {
+    static DecodeTable table(kA32Entries, ARRAY_COUNT(kA32Entries), 24, 8);
+    return table;
+}
+
+static const DecodeTable &T16Table() {
+    static DecodeTable table(kT16Entries, ARRAY_COUNT(kT16Entries), 8, 8);
+    return table;
+}
+
+static const DecodeTable &T32Table() {
+    static DecodeTable table(kT32Entries, ARRAY_COUNT(kT32Entries), 20, 12);
+    return table;
+}
+
+static const DecodeTable &A64Table() {
+    static DecodeTable table(kA64Entries, ARRAY_COUNT(kA64Entries), 24, 8);
+    return table;
+}
+
+static inline bool HasPcField(uint32_t insn, uint16_t fields) {
+    if (fields == 0) {
+        return false;
+    }
+    return ((fields & kFieldRm) && (insn & 0xf) == 0xf) ||
+           ((fields & kFieldRs) && ((insn >> 8) & 0xf) == 0xf) ||
+           ((fields & kFieldRd) && ((insn >> 12) & 0xf) == 0xf) ||
+           ((fields & kFieldRn) && ((insn >> 16) & 0xf) == 0xf) ||
+           ((fields & kFieldList) && (insn & 0x8000) != 0) ||
+           ((fields & kFieldT16Rm) && ((insn >> 3) & 0xf) == 0xf) ||
+           ((fields & kFieldT16Rdn) && (((insn >> 4) & 8) | (insn & 7)) == 0xf) ||
+           ((fields & kFieldRdPair) && ((insn >> 12) & 0xf) == 0xe) ||
+           ((fields & kFieldRmPair) && (insn & 0xf) == 0xe);
+}
+
+static inline int32_t SignExtend(uint32_t value, unsigned bits) {
+    return (int32_t) (value << (32 - bits)) >> (32 - bits);
+}
+
+static inline uint32_t Bits(uint32_t value, unsigned high, unsigned low) {
+    return (value >> low) & ((2u << (high - low)) - 1);
+}
+
+static inline uint32_t A32ExpandImm(uint32_t imm12) {
+    uint32_t value = imm12 & 0xff;
+    unsigned rotate = (imm12 >> 8) * 2;
+    return rotate == 0 ? value : (value >> rotate) | (value << (32 - rotate));
+}
+
+static inline intptr_t Signed(uint32_t magnitude, bool add) {
+    return add ? (intptr_t) magnitude : -(intptr_t) magnitude;
+}
+
+//T32的imm24跳转: S:I1:I2:imm10:imm11:0, I1 = NOT(J1 XOR S)
+static inline int32_t T32BranchOffset(uint32_t insn) {
+    uint32_t s = Bits(insn, 26, 26);
+    uint32_t i1 = ~(Bits(insn, 13, 13) ^ s) & 1;
+    uint32_t i2 = ~(Bits(insn, 11, 11) ^ s) & 1;
+    return SignExtend((s << 24) | (i1 << 23) | (i2 << 22) | (Bits(insn, 25, 16) << 12) |
+                      (Bits(insn, 10, 0) << 1), 25);
+}
+
+static uintptr_t ComputeTarget(uint8_t kind, uint32_t insn, uintptr_t pc) {
+    uintptr_t a32Base = (pc + 8) & ~(uintptr_t) 3;
+    uintptr_t t32Base = (pc + 4) & ~(uintptr_t) 3;
+    switch (kind) {
+        case kTargetA32Branch:
+            return pc + 8 + SignExtend(Bits(insn, 23, 0) << 2, 26);
+        case kTargetA32Blx:
+            return (pc + 8 + SignExtend((Bits(insn, 23, 0) << 2) | (Bits(insn, 24, 24) << 1), 26)) |
+                   1;
+        case kTargetA32AddPc:
+            return a32Base + A32ExpandImm(Bits(insn, 11, 0));
+        case kTargetA32SubPc:
+            return a32Base - A32ExpandImm(Bits(insn, 11, 0));
+        case kTargetA32Literal12:
+            return a32Base + Signed(Bits(insn, 11, 0), Bits(insn, 23, 23));
+        case kTargetA32Literal8:
+            return a32Base + Signed((Bits(insn, 11, 8) << 4) | Bits(insn, 3, 0), Bits(insn, 23, 23));
+        case kTargetA32LiteralWords:
+            return a32Base + Signed(Bits(insn, 7, 0) << 2, Bits(insn, 23, 23));
+        case kTargetT16Cond:
+            return (pc + 4 + SignExtend(Bits(insn, 7, 0) << 1, 9)) | 1;
+        case kTargetT16Branch:
+            return (pc + 4 + SignExtend(Bits(insn, 10, 0) << 1, 12)) | 1;
+        case kTargetT16Cbz:
+            return (pc + 4 + ((Bits(insn, 9, 9) << 6) | (Bits(insn, 7, 3) << 1))) | 1;
+        case kTargetT16Literal:
+            return t32Base + (Bits(insn, 7, 0) << 2);
+        case kTargetT32Cond:
+            return (pc + 4 + SignExtend((Bits(insn, 26, 26) << 20) | (Bits(insn, 11, 11) << 19) |
+                                        (Bits(insn, 13, 13) << 18) | (Bits(insn, 21, 16) << 12) |
+                                        (Bits(insn, 10, 0) << 1), 21)) | 1;
+        case kTargetT32Branch:
+            return (pc + 4 + T32BranchOffset(insn)) | 1;
+        case kTargetT32Blx:
+            return t32Base + T32BranchOffset(insn);
+        case kTargetT32AddPc:
+            return t32Base + ((Bits(insn, 26, 26) << 11) | (Bits(insn, 14, 12) << 8) |
+                              Bits(insn, 7, 0));
+        case kTargetT32SubPc:
+            return t32Base - ((Bits(insn, 26, 26) << 11) | (Bits(insn, 14, 12) << 8) |
+                              Bits(insn, 7, 0));
+        case kTargetT32Literal12:
+            return t32Base + Signed(Bits(insn, 11, 0), Bits(insn, 23, 23));
+        case kTargetT32LiteralWords:
+            return t32Base + Signed(Bits(insn, 7, 0) << 2, Bits(insn, 23, 23));
+        case kTargetA64Imm26:
+            return pc + (intptr_t) SignExtend(Bits(insn, 25, 0), 26) * 4;
+        case kTargetA64Imm19:
+            return pc + (intptr_t) SignExtend(Bits(insn, 23, 5), 19) * 4;
+        case kTargetA64Imm14:
+            return pc + (intptr_t) SignExtend(Bits(insn, 18, 5), 14) * 4;
+        case kTargetA64Adr:
+            return pc + SignExtend((Bits(insn, 23, 5) << 2) | Bits(insn, 30, 29), 21);
+        case kTargetA64Adrp:
+            return (pc & ~(uintptr_t) 0xfff) +
+                   (intptr_t) SignExtend((Bits(insn, 23, 5) << 2) | Bits(insn, 30, 29), 21) * 4096;
+        default:
+            return 0;
+    }
+}
+
+static inline InstructionClass Classify(const DecodeEntry &entry, uint32_t insn, uintptr_t pc,
+                                        uint32_t size) {
+    InstructionClass result;
+    result.size = size;
+    result.flags = entry.flags;
+    result.target = 0;
+    if (HasPcField(insn, entry.reads)) {
+        result.flags |= kInstructionPcRelative;
+    }
+    if (HasPcField(insn, entry.writes)) {
+        result.flags |= kInstructionBranch;
+    }
+    if (entry.target != kTargetNone) {
+        result.flags |= kInstructionHasTarget;
+        result.target = ComputeTarget(entry.target, insn, pc);
+    }
+    return result;
+}
+
+InstructionClass ClassifyA32(uint32_t instruction, uintptr_t pc) {
+    InstructionClass result = Classify(A32Table().Find(instruction), instruction, pc, 4);
+    //除了AL和无条件空间, 写pc的指令都是条件跳转
+    if ((result.flags & kInstructionBranch) && (instruction >> 28) < 0xE) {
+        result.flags |= kInstructionConditional;
+    }
+    return result;
+}
+
+InstructionClass ClassifyT32(const uint16_t *code, uintptr_t pc) {
+    if (T32InstructionSize(code[0]) == 2) {
+        return Classify(T16Table().Find(code[0]), code[0], pc, 2);
+    }
+    uint32_t instruction = ((uint32_t) code[0] << 16) | code[1];
+    return Classify(T32Table().Find(instruction), instruction, pc, 4);
+}
+
+InstructionClass ClassifyA64(uint32_t instruction, uintptr_t pc) {
+    return Classify(A64Table().Find(instruction), instruction, pc, 4);
+}
+
+//code不保证对齐, 按字节读
+static inline uint32_t LoadWord(const uint8_t *code) {
+    uint32_t value;
+    memcpy(&value, code, sizeof(value));
+    return value;
+}
+
+static inline size_t ClassifyNext(InstructionSetType isa, const uint8_t *code, size_t remaining,
+                                  uintptr_t pc, InstructionClass *out) {
+    if (isa == InstructionSetType::kT32) {
+        uint16_t halfwords[2] = {0, 0};
+        if (remaining < 2) {
+            return 0;
+        }
+        memcpy(&halfwords[0], code, 2);
+        if (T32InstructionSize(halfwords[0]) == 4) {
+            if (remaining < 4) {
+                return 0;
+            }
+            memcpy(&halfwords[1], code + 2, 2);
+        }
+        *out = ClassifyT32(halfwords, pc);
+        return out->size;
+    }
+    if (remaining < 4) {
+        return 0;
+    }
+    *out = isa == InstructionSetType::kA32 ? ClassifyA32(LoadWord(code), pc)
+                                           : ClassifyA64(LoadWord(code), pc);
+    return 4;
+}
+
+size_t ClassifyInstructions(InstructionSetType isa, const void *code, size_t size, uintptr_t pc,
+                            InstructionClass *out, size_t maxCount) {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(code);
+    size_t offset = 0;
+    size_t count = 0;
+    while (count < maxCount) {
+        size_t length = ClassifyNext(isa, bytes + offset, size - offset, pc + offset, &out[count]);
+        if (length == 0) {
+            break;
+        }
+        offset += length;
+        ++count;
+    }
+    return count;
+}
+
+size_t RelocatablePrefix(InstructionSetType isa, const void *code, size_t size, uintptr_t pc,
+                         InstructionClass *stop) {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(code);
+    size_t offset = 0;
+    InstructionClass current;
+    while (true) {
+        size_t length = ClassifyNext(isa, bytes + offset, size - offset, pc + offset, &current);
+        if (length == 0) {
+            current.size = 0;
+            current.flags = 0;
+            current.target = 0;
+            break;
+        }
+        if (!current.IsRelocatable()) {
+            break;
+        }
+        offset += length;
+    }
+    if (stop != nullptr) {
+        *stop = current;
+    }
+    return offset;
+}
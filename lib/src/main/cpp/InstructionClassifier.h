@@ -0,0 +1,85 @@
+#ifndef PROFILER_INSTRUCTIONCLASSIFIER_H
+#define PROFILER_INSTRUCTIONCLASSIFIER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * 给patch用的指令分类: 只回答长度, 是否依赖pc, 是否改变控制流以及能直接算出的目标地址,
+ * 不生成反汇编文本. 基于掩码表查找, 每条指令是一次分桶和几次掩码比较.
+ *
+ * 分类是无状态的, 不跟踪IT块. 对未分配或unpredictable的编码, 只要寄存器字段出现pc就按
+ * 依赖pc处理, 偏保守.
+ *
+ * libdodo只改写ArtMethod的入口字段, 不改指令, 所以这里没有编进libdodo, 只和测试一起编译;
+ * 做inline hook时再加回dodo的源文件列表.
+ */
+enum class InstructionSetType {
+    kA32,
+    kT32,
+    kA64,
+};
+
+enum InstructionFlags {
+    //读取pc: literal load, adr, 直接跳转, 以及把pc当作普通操作数
+    kInstructionPcRelative = 1 << 0,
+    //改变控制流: 跳转, 返回, 以及写pc的指令(pop {pc}, ldr pc, mov pc等)
+    kInstructionBranch = 1 << 1,
+    //bl/blx, 会写lr
+    kInstructionCall = 1 << 2,
+    //条件跳转
+    kInstructionConditional = 1 << 3,
+    //target有效
+    kInstructionHasTarget = 1 << 4,
+};
+
+struct InstructionClass {
+    //指令字节数: A32/A64为4, T32为2或4
+    uint32_t size;
+    uint32_t flags;
+    //按pc算出的地址: 跳转目标, adr的结果或literal的地址; 目标是thumb代码时最低位为1
+    uintptr_t target;
+
+    bool Is(uint32_t flag) const {
+        return (flags & flag) != 0;
+    }
+
+    //不读pc也不改变控制流的指令可以原样拷到别处执行
+    bool IsRelocatable() const {
+        return (flags & (kInstructionPcRelative | kInstructionBranch)) == 0;
+    }
+};
+
+/**
+ * @param pc 指令所在的地址
+ */
+InstructionClass ClassifyA32(uint32_t instruction, uintptr_t pc);
+
+/**
+ * @param code 指向第一个半字, 32位指令会读两个半字
+ * @param pc 指令所在的地址, 不带thumb位
+ */
+InstructionClass ClassifyT32(const uint16_t *code, uintptr_t pc);
+
+InstructionClass ClassifyA64(uint32_t instruction, uintptr_t pc);
+
+static inline size_t T32InstructionSize(uint16_t first) {
+    return (first >> 11) >= 0x1d ? 4 : 2;
+}
+
+/**
+ * 从code(位于pc)开始依次分类, 直到用完size字节或填满out; 末尾不完整的T32指令不计入
+ *
+ * @return 分类的指令条数
+ */
+size_t ClassifyInstructions(InstructionSetType isa, const void *code, size_t size, uintptr_t pc,
+                            InstructionClass *out, size_t maxCount);
+
+/**
+ * @return code开始可以原样搬移的字节数, 遇到第一条不能搬移的指令或用完size时停下;
+ *         stop非空时写入停下的那条指令的分类(用完size时size为0)
+ */
+size_t RelocatablePrefix(InstructionSetType isa, const void *code, size_t size, uintptr_t pc,
+                         InstructionClass *stop);
+
+#endif //PROFILER_INSTRUCTIONCLASSIFIER_H
@@ -0,0 +1,314 @@
+#include "InstructionClassifier.h"
+#include "InstructionEncoding.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <sstream>
+
+#include "aarch32/disasm-aarch32.h"
+#include "aarch64/decoder-aarch64.h"
+
+namespace a32 = vixl::aarch32;
+namespace a64 = vixl::aarch64;
+
+namespace {
+
+// vixl反汇编一条A32/T32指令时看到的东西
+struct A32Reference {
+    bool skip = false;
+    bool hasLabel = false;
+    bool mentionsPc = false;
+    uint32_t label = 0;
+    a32::InstructionType type = a32::kUndefInstructionType;
+    std::string text;
+};
+
+class ReferenceStream : public a32::Disassembler::DisassemblerStream {
+public:
+    ReferenceStream(std::ostream &os, A32Reference *reference)
+            : DisassemblerStream(os), reference_(reference) {}
+
+    DisassemblerStream &operator<<(a32::Register reg) override {
+        reference_->mentionsPc |= reg.IsPC();
+        return DisassemblerStream::operator<<(reg);
+    }
+
+    DisassemblerStream &operator<<(const a32::RegisterList &list) override {
+        reference_->mentionsPc |= list.Includes(a32::pc);
+        return DisassemblerStream::operator<<(list);
+    }
+
+    DisassemblerStream &operator<<(const a32::Disassembler::PrintLabel &label) override {
+        reference_->hasLabel = true;
+        reference_->label = (uint32_t) label.GetLocation();
+        return DisassemblerStream::operator<<(label);
+    }
+
+private:
+    A32Reference *reference_;
+};
+
+class ReferenceDisassembler : public a32::Disassembler {
+public:
+    ReferenceDisassembler(DisassemblerStream *os, A32Reference *reference, uint32_t pc)
+            : Disassembler(os, pc), reference_(reference) {}
+
+    void UnallocatedT32(uint32_t instruction) override {
+        reference_->skip = true;
+        Disassembler::UnallocatedT32(instruction);
+    }
+
+    void UnallocatedA32(uint32_t instruction) override {
+        reference_->skip = true;
+        Disassembler::UnallocatedA32(instruction);
+    }
+
+    void UnimplementedT32_16(const char *name, uint32_t instruction) override {
+        reference_->skip = true;
+        Disassembler::UnimplementedT32_16(name, instruction);
+    }
+
+    void UnimplementedT32_32(const char *name, uint32_t instruction) override {
+        reference_->skip = true;
+        Disassembler::UnimplementedT32_32(name, instruction);
+    }
+
+    void UnimplementedA32(const char *name, uint32_t instruction) override {
+        reference_->skip = true;
+        Disassembler::UnimplementedA32(name, instruction);
+    }
+
+    void Unpredictable() override {
+        reference_->skip = true;
+        Disassembler::Unpredictable();
+    }
+
+private:
+    A32Reference *reference_;
+};
+
+A32Reference DisassembleReference(bool thumb, uint32_t instruction, uint32_t pc) {
+    A32Reference reference;
+    std::ostringstream text;
+    ReferenceStream stream(text, &reference);
+    ReferenceDisassembler disassembler(&stream, &reference, pc);
+    if (thumb) {
+        disassembler.DecodeT32(instruction);
+    } else {
+        disassembler.DecodeA32(instruction);
+    }
+    reference.type = stream.GetCurrentInstructionType();
+    reference.text = text.str();
+    return reference;
+}
+
+bool IsBranchType(a32::InstructionType type) {
+    switch (type) {
+        case a32::kB:
+        case a32::kBl:
+        case a32::kBlx:
+        case a32::kBx:
+        case a32::kBxj:
+        case a32::kCbnz:
+        case a32::kCbz:
+        case a32::kTbb:
+        case a32::kTbh:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// 同一条指令上分类结果与vixl的对照, 不一致时返回说明
+std::string CompareWithReference(const InstructionClass &actual, const A32Reference &reference) {
+    if (reference.skip) {
+        return "";
+    }
+    // U为0的#0偏移vixl打印成[pc, #-0]或"pc, #0"而不是地址, 这时有没有target都算对
+    bool zeroOffset = reference.text.find("[pc, #-0]") != std::string::npos ||
+                      reference.text.find(", pc, #0") != std::string::npos;
+    if (!zeroOffset && actual.Is(kInstructionHasTarget) != reference.hasLabel) {
+        return "target presence";
+    }
+    if (reference.hasLabel && ((uint32_t) actual.target & ~1u) != (reference.label & ~1u)) {
+        return "target value";
+    }
+    if (IsBranchType(reference.type) && !actual.Is(kInstructionBranch)) {
+        return "branch";
+    }
+    bool relocatable = !reference.mentionsPc && !reference.hasLabel &&
+                       !IsBranchType(reference.type);
+    if (actual.IsRelocatable() != relocatable) {
+        return "pc dependence";
+    }
+    return "";
+}
+
+class A64Reference : public a64::DecoderVisitor {
+public:
+#define DECLARE(A) \
+    void Visit##A(const a64::Instruction *) override { visitor = #A; }
+    VISITOR_LIST(DECLARE)
+#undef DECLARE
+
+    std::string visitor;
+};
+
+const int kFuzzIterations = 1 << 20;
+
+}  // namespace
+
+TEST(InstructionClassifier, A32Examples) {
+    // b .+16
+    InstructionClass b = ClassifyA32(A32Encoder::B(8), 0x1000);
+    EXPECT_EQ(kInstructionBranch | kInstructionPcRelative | kInstructionHasTarget, b.flags);
+    EXPECT_EQ(0x1010u, b.target);
+    EXPECT_TRUE(ClassifyA32(A32Encoder::Push(0x4010), 0).IsRelocatable());
+    EXPECT_TRUE(ClassifyA32(A32Encoder::Pop(0x8010), 0).Is(kInstructionBranch));
+    EXPECT_TRUE(ClassifyA32(A32Encoder::Pop(0x4010), 0).IsRelocatable());
+    EXPECT_TRUE(ClassifyA32(A32Encoder::Blx(4), 0).Is(kInstructionCall));
+    // ldr r3, [pc, #0x44]
+    InstructionClass literal = ClassifyA32(A32Encoder::LdrLiteral(3, 0x44), 0x100);
+    EXPECT_EQ(kInstructionPcRelative | kInstructionHasTarget, literal.flags);
+    EXPECT_EQ(0x14cu, literal.target);
+    // movne pc, lr
+    EXPECT_EQ(kInstructionBranch | kInstructionConditional,
+              ClassifyA32(0x11A0F00Eu, 0).flags);
+    // mov r0, pc
+    EXPECT_EQ(kInstructionPcRelative, ClassifyA32(A32Encoder::Mov(0, A32Encoder::kPc), 0).flags);
+}
+
+TEST(InstructionClassifier, T32Examples) {
+    // push {r4, lr}; ldr r0, [pc, #4] (pc未按4对齐)
+    const uint16_t code[] = {0xB510, 0x4801};
+    EXPECT_TRUE(ClassifyT32(&code[0], 0x1000).IsRelocatable());
+    InstructionClass literal = ClassifyT32(&code[1], 0x1002);
+    EXPECT_EQ(2u, literal.size);
+    EXPECT_EQ(0x1008u, literal.target);
+    // bl .+0x12344
+    uint32_t bl = T32Encoder::Bl(0x12340);
+    const uint16_t call[] = {T32Encoder::First(bl), T32Encoder::Second(bl)};
+    InstructionClass callClass = ClassifyT32(call, 0x2000);
+    EXPECT_EQ(4u, callClass.size);
+    EXPECT_TRUE(callClass.Is(kInstructionCall));
+    EXPECT_EQ(0x14345u, callClass.target);
+    // pop {r4, pc}
+    const uint16_t ret = 0xBD10;
+    EXPECT_TRUE(ClassifyT32(&ret, 0).Is(kInstructionBranch));
+}
+
+TEST(InstructionClassifier, A64Examples) {
+    InstructionClass bl = ClassifyA64(A64Encoder::Bl(-8), 0x10000);
+    EXPECT_TRUE(bl.Is(kInstructionCall));
+    EXPECT_EQ(0xfff8u, bl.target);
+    InstructionClass literal = ClassifyA64(A64Encoder::LdrLiteral(17, 8), 0x10000);
+    EXPECT_EQ(kInstructionPcRelative | kInstructionHasTarget, literal.flags);
+    EXPECT_EQ(0x10008u, literal.target);
+    EXPECT_TRUE(ClassifyA64(A64Encoder::Ret(), 0).Is(kInstructionBranch));
+    EXPECT_TRUE(ClassifyA64(A64Encoder::StpPreIndex(29, 30, A64Encoder::kSp, -16), 0)
+                        .IsRelocatable());
+}
+
+TEST(InstructionClassifier, RelocatablePrefix) {
+    // stp x29, x30, [sp, #-16]!; mov x29, sp; adrp x0, ...; ret
+    const uint32_t code[] = {
+            A64Encoder::StpPreIndex(29, 30, A64Encoder::kSp, -16),
+            A64Encoder::MovSp(29, A64Encoder::kSp),
+            0x90000000u,
+            A64Encoder::Ret(),
+    };
+    InstructionClass stop;
+    EXPECT_EQ(8u, RelocatablePrefix(InstructionSetType::kA64, code, sizeof(code), 0x4000, &stop));
+    EXPECT_TRUE(stop.Is(kInstructionPcRelative));
+    EXPECT_EQ(0x4000u, stop.target);
+
+    InstructionClass classes[8];
+    EXPECT_EQ(4u, ClassifyInstructions(InstructionSetType::kA64, code, sizeof(code), 0x4000,
+                                       classes, 8));
+    // 末尾半条T32指令不计入
+    const uint16_t thumb[] = {0xB510, 0xF000};
+    EXPECT_EQ(1u, ClassifyInstructions(InstructionSetType::kT32, thumb, sizeof(thumb), 0,
+                                       classes, 8));
+}
+
+TEST(InstructionClassifier, FuzzA32AgainstVixl) {
+    std::mt19937 random(0x1d1f);
+    int failures = 0;
+    for (int i = 0; i < kFuzzIterations && failures < 20; ++i) {
+        uint32_t instruction = random();
+        uint32_t pc = random() & 0x7ffffffc;
+        A32Reference reference = DisassembleReference(false, instruction, pc);
+        std::string mismatch = CompareWithReference(ClassifyA32(instruction, pc), reference);
+        if (!mismatch.empty()) {
+            ADD_FAILURE() << mismatch << ": " << std::hex << instruction << " " << reference.text;
+            ++failures;
+        }
+    }
+}
+
+TEST(InstructionClassifier, FuzzT32AgainstVixl) {
+    std::mt19937 random(0x7e32);
+    int failures = 0;
+    for (int i = 0; i < kFuzzIterations && failures < 20; ++i) {
+        uint16_t code[2] = {(uint16_t) (random() >> 16), (uint16_t) random()};
+        //一半的样本落在32位编码
+        if (i & 1) {
+            code[0] |= 0xE800;
+        }
+        uint32_t pc = random() & 0x7ffffffe;
+        InstructionClass actual = ClassifyT32(code, pc);
+        uint32_t instruction = ((uint32_t) code[0] << 16) | code[1];
+        a32::Disassembler sizer(std::cout);
+        ASSERT_EQ((uint32_t) sizer.T32Size(instruction), actual.size) << std::hex << instruction;
+        if (actual.size == 2) {
+            instruction &= 0xffff0000u;
+        }
+        A32Reference reference = DisassembleReference(true, instruction, pc);
+        std::string mismatch = CompareWithReference(actual, reference);
+        if (!mismatch.empty()) {
+            ADD_FAILURE() << mismatch << ": " << std::hex << instruction << " " << reference.text;
+            ++failures;
+        }
+    }
+}
+
+TEST(InstructionClassifier, FuzzA64AgainstVixl) {
+    std::mt19937 random(0xa64);
+    a64::Decoder decoder;
+    A64Reference reference;
+    decoder.AppendVisitor(&reference);
+    int failures = 0;
+    for (int i = 0; i < kFuzzIterations && failures < 20; ++i) {
+        uint32_t word = random();
+        const a64::Instruction *instruction = reinterpret_cast<const a64::Instruction *>(&word);
+        decoder.Decode(instruction);
+        if (reference.visitor == "Unallocated" || reference.visitor == "Unimplemented") {
+            continue;
+        }
+        InstructionClass actual = ClassifyA64(word, reinterpret_cast<uintptr_t>(instruction));
+        bool branch = reference.visitor == "UnconditionalBranch" ||
+                      reference.visitor == "ConditionalBranch" ||
+                      reference.visitor == "CompareBranch" ||
+                      reference.visitor == "TestBranch" ||
+                      reference.visitor == "UnconditionalBranchToRegister";
+        bool literal = instruction->IsLoadLiteral();
+        bool immediate = instruction->IsPCRelAddressing() || instruction->IsCondBranchImm() ||
+                         instruction->IsUncondBranchImm() || instruction->IsCompareBranch() ||
+                         instruction->IsTestBranch();
+        bool mismatch = actual.Is(kInstructionBranch) != branch ||
+                        actual.Is(kInstructionHasTarget) != (immediate || literal) ||
+                        actual.IsRelocatable() == (branch || immediate || literal);
+        if (!mismatch && immediate) {
+            mismatch = actual.target !=
+                       reinterpret_cast<uintptr_t>(instruction->GetImmPCOffsetTarget());
+        }
+        if (!mismatch && literal) {
+            mismatch = actual.target != instruction->GetLiteralAddress<uintptr_t>();
+        }
+        if (mismatch) {
+            ADD_FAILURE() << std::hex << word << " " << reference.visitor;
+            ++failures;
+        }
+    }
+}
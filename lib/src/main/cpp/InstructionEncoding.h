@@ -0,0 +1,330 @@
+#ifndef PROFILER_INSTRUCTIONENCODING_H
+#define PROFILER_INSTRUCTIONENCODING_H
+
+#include <stdint.h>
+
+#include <stdexcept>
+
+/**
+ * 跳板里用到的少量固定指令的constexpr编码, 覆盖A32, T32和A64.
+ *
+ * 固定的跳板可以直接写成编译期的静态数组, hook时不需要vixl; 编码结果在
+ * InstructionEncoding_test.cc里与vixl的Assembler逐条比对.
+ *
+ * 寄存器用编号表示; 偏移都是字节偏移, pc相关的偏移按各指令集读到的pc计算
+ * (A32为当前指令+8, T32为当前指令+4并按4对齐, A64为当前指令).
+ * 参数超出编码范围时: 在常量表达式里直接编译失败, 运行时抛std::out_of_range.
+ */
+struct EncodingCheck {
+    static constexpr uint32_t Require(bool ok, uint32_t value) {
+        return ok ? value : throw std::out_of_range("instruction operand out of range");
+    }
+
+    static constexpr bool IsUint(int64_t value, unsigned bits) {
+        return value >= 0 && value < (int64_t(1) << bits);
+    }
+
+    static constexpr bool IsInt(int64_t value, unsigned bits) {
+        return value >= -(int64_t(1) << (bits - 1)) && value < (int64_t(1) << (bits - 1));
+    }
+
+    static constexpr bool IsAligned(int64_t value, unsigned alignment) {
+        return (value & (alignment - 1)) == 0;
+    }
+};
+
+struct A32Encoder {
+    static constexpr unsigned kSp = 13;
+    static constexpr unsigned kLr = 14;
+    static constexpr unsigned kPc = 15;
+    static constexpr uint32_t kAl = 0xE0000000u;
+
+    static constexpr uint32_t RotateLeft(uint32_t value, unsigned shift) {
+        return shift == 0 ? value : (value << shift) | (value >> (32 - shift));
+    }
+
+    // imm12 = rotate:imm8, 表示 imm8 循环右移 2*rotate
+    static constexpr uint32_t ModifiedImmediate(uint32_t value, unsigned rotate = 0) {
+        return rotate == 16 ? EncodingCheck::Require(false, 0)
+                            : RotateLeft(value, rotate * 2) <= 0xff
+                              ? (rotate << 8) | RotateLeft(value, rotate * 2)
+                              : ModifiedImmediate(value, rotate + 1);
+    }
+
+    // push {list}  (stmdb sp!, {list})
+    static constexpr uint32_t Push(uint16_t list) {
+        return kAl | 0x092D0000u | list;
+    }
+
+    // pop {list}  (ldmia sp!, {list})
+    static constexpr uint32_t Pop(uint16_t list) {
+        return kAl | 0x08BD0000u | list;
+    }
+
+    // ldr/str rt, [rn, #+/-imm12]
+    static constexpr uint32_t LoadStoreOffset(uint32_t opcode, unsigned rt, unsigned rn,
+                                              int32_t offset) {
+        return EncodingCheck::Require(offset > -4096 && offset < 4096,
+                                      kAl | opcode | (offset >= 0 ? 0x00800000u : 0) |
+                                      (rn << 16) | (rt << 12) |
+                                      (uint32_t) (offset >= 0 ? offset : -offset));
+    }
+
+    static constexpr uint32_t Ldr(unsigned rt, unsigned rn, int32_t offset) {
+        return LoadStoreOffset(0x05100000u, rt, rn, offset);
+    }
+
+    static constexpr uint32_t Str(unsigned rt, unsigned rn, int32_t offset) {
+        return LoadStoreOffset(0x05000000u, rt, rn, offset);
+    }
+
+    // ldr rt, [rn], #imm12
+    static constexpr uint32_t LdrPostIndex(unsigned rt, unsigned rn, uint32_t offset) {
+        return EncodingCheck::Require(offset < 4096,
+                                      kAl | 0x04900000u | (rn << 16) | (rt << 12) | offset);
+    }
+
+    // ldr rt, [pc, #offset], offset = 目标 - (当前指令 + 8)
+    static constexpr uint32_t LdrLiteral(unsigned rt, int32_t offset) {
+        return Ldr(rt, kPc, offset);
+    }
+
+    static constexpr uint32_t AddImmediate(unsigned rd, unsigned rn, uint32_t imm) {
+        return kAl | 0x02800000u | (rn << 16) | (rd << 12) | ModifiedImmediate(imm);
+    }
+
+    static constexpr uint32_t SubImmediate(unsigned rd, unsigned rn, uint32_t imm) {
+        return kAl | 0x02400000u | (rn << 16) | (rd << 12) | ModifiedImmediate(imm);
+    }
+
+    static constexpr uint32_t Mov(unsigned rd, unsigned rm) {
+        return kAl | 0x01A00000u | (rd << 12) | rm;
+    }
+
+    static constexpr uint32_t Movw(unsigned rd, uint16_t imm) {
+        return kAl | 0x03000000u | ((uint32_t) (imm >> 12) << 16) | (rd << 12) | (imm & 0xfffu);
+    }
+
+    static constexpr uint32_t Movt(unsigned rd, uint16_t imm) {
+        return kAl | 0x03400000u | ((uint32_t) (imm >> 12) << 16) | (rd << 12) | (imm & 0xfffu);
+    }
+
+    static constexpr uint32_t Bx(unsigned rm) {
+        return kAl | 0x012FFF10u | rm;
+    }
+
+    static constexpr uint32_t Blx(unsigned rm) {
+        return kAl | 0x012FFF30u | rm;
+    }
+
+    // b/bl label, offset = 目标 - (当前指令 + 8)
+    static constexpr uint32_t Branch(uint32_t opcode, int32_t offset) {
+        return EncodingCheck::Require(EncodingCheck::IsAligned(offset, 4) &&
+                                      EncodingCheck::IsInt(offset, 26),
+                                      kAl | opcode | (((uint32_t) offset >> 2) & 0x00ffffffu));
+    }
+
+    static constexpr uint32_t B(int32_t offset) {
+        return Branch(0x0A000000u, offset);
+    }
+
+    static constexpr uint32_t Bl(int32_t offset) {
+        return Branch(0x0B000000u, offset);
+    }
+};
+
+/**
+ * 32位的T32指令返回值高16位是第一个半字, 写内存时先写高半字, 见First/Second
+ */
+struct T32Encoder {
+    static constexpr unsigned kSp = 13;
+    static constexpr unsigned kLr = 14;
+    static constexpr unsigned kPc = 15;
+
+    static constexpr uint16_t First(uint32_t instruction) {
+        return (uint16_t) (instruction >> 16);
+    }
+
+    static constexpr uint16_t Second(uint32_t instruction) {
+        return (uint16_t) instruction;
+    }
+
+    // push.w {list}  (stmdb sp!, {list}), 不能包含sp和pc
+    static constexpr uint32_t PushW(uint16_t list) {
+        return EncodingCheck::Require((list & 0xA000u) == 0, 0xE92D0000u | list);
+    }
+
+    // pop.w {list}  (ldmia sp!, {list}), 不能包含sp, lr和pc不能同时出现
+    static constexpr uint32_t PopW(uint16_t list) {
+        return EncodingCheck::Require((list & 0x2000u) == 0 && (list & 0xC000u) != 0xC000u,
+                                      0xE8BD0000u | list);
+    }
+
+    // ldr.w/str.w rt, [rn, #imm12]
+    static constexpr uint32_t LdrW(unsigned rt, unsigned rn, uint32_t offset) {
+        return EncodingCheck::Require(offset < 4096 && rn != kPc,
+                                      0xF8D00000u | (rn << 16) | (rt << 12) | offset);
+    }
+
+    static constexpr uint32_t StrW(unsigned rt, unsigned rn, uint32_t offset) {
+        return EncodingCheck::Require(offset < 4096 && rn != kPc,
+                                      0xF8C00000u | (rn << 16) | (rt << 12) | offset);
+    }
+
+    // ldr.w rt, [pc, #+/-imm12], offset = 目标 - Align(当前指令 + 4, 4)
+    static constexpr uint32_t LdrLiteralW(unsigned rt, int32_t offset) {
+        return EncodingCheck::Require(offset > -4096 && offset < 4096,
+                                      0xF85F0000u | (offset >= 0 ? 0x00800000u : 0) | (rt << 12) |
+                                      (uint32_t) (offset >= 0 ? offset : -offset));
+    }
+
+    // mov rd, rm (16位, 可用高寄存器)
+    static constexpr uint16_t Mov(unsigned rd, unsigned rm) {
+        return (uint16_t) (0x4600u | ((rd & 8u) << 4) | (rm << 3) | (rd & 7u));
+    }
+
+    static constexpr uint16_t Bx(unsigned rm) {
+        return (uint16_t) (0x4700u | (rm << 3));
+    }
+
+    static constexpr uint16_t Blx(unsigned rm) {
+        return (uint16_t) (0x4780u | (rm << 3));
+    }
+
+    static constexpr uint16_t Nop() {
+        return 0xBF00u;
+    }
+
+    // b.w/bl label, offset = 目标 - (当前指令 + 4)
+    static constexpr uint32_t Branch(uint32_t opcode, int32_t offset) {
+        return EncodingCheck::Require(
+                EncodingCheck::IsAligned(offset, 2) && EncodingCheck::IsInt(offset, 25),
+                opcode |
+                (offset < 0 ? 0x04000000u : 0) |
+                ((((uint32_t) offset >> 12) & 0x3ffu) << 16) |
+                // J1 = NOT(I1) XOR S, J2 = NOT(I2) XOR S
+                (((((uint32_t) offset >> 23) & 1u) ^ (offset < 0 ? 0u : 1u)) << 13) |
+                (((((uint32_t) offset >> 22) & 1u) ^ (offset < 0 ? 0u : 1u)) << 11) |
+                (((uint32_t) offset >> 1) & 0x7ffu));
+    }
+
+    static constexpr uint32_t BW(int32_t offset) {
+        return Branch(0xF0009000u, offset);
+    }
+
+    static constexpr uint32_t Bl(int32_t offset) {
+        return Branch(0xF000D000u, offset);
+    }
+};
+
+struct A64Encoder {
+    static constexpr unsigned kLr = 30;
+    static constexpr unsigned kSp = 31;   // 用作基址/ADD/SUB时
+    static constexpr unsigned kXzr = 31;  // 用作数据寄存器时
+
+    // ldr xt, label, offset = 目标 - 当前指令
+    static constexpr uint32_t LdrLiteral(unsigned rt, int32_t offset) {
+        return EncodingCheck::Require(EncodingCheck::IsAligned(offset, 4) &&
+                                      EncodingCheck::IsInt(offset, 21),
+                                      0x58000000u | ((((uint32_t) offset >> 2) & 0x7ffffu) << 5) |
+                                      rt);
+    }
+
+    // ldr/str xt, [xn, #imm], imm为8的倍数
+    static constexpr uint32_t LdrUnsignedOffset(unsigned rt, unsigned rn, uint32_t offset) {
+        return EncodingCheck::Require(EncodingCheck::IsAligned(offset, 8) && offset / 8 < 4096,
+                                      0xF9400000u | ((offset / 8) << 10) | (rn << 5) | rt);
+    }
+
+    static constexpr uint32_t StrUnsignedOffset(unsigned rt, unsigned rn, uint32_t offset) {
+        return EncodingCheck::Require(EncodingCheck::IsAligned(offset, 8) && offset / 8 < 4096,
+                                      0xF9000000u | ((offset / 8) << 10) | (rn << 5) | rt);
+    }
+
+    static constexpr uint32_t Pair(uint32_t opcode, unsigned rt, unsigned rt2, unsigned rn,
+                                   int32_t offset) {
+        return EncodingCheck::Require(EncodingCheck::IsAligned(offset, 8) &&
+                                      EncodingCheck::IsInt(offset / 8, 7),
+                                      opcode | (((uint32_t) (offset / 8) & 0x7fu) << 15) |
+                                      (rt2 << 10) | (rn << 5) | rt);
+    }
+
+    // stp xt, xt2, [xn, #offset]!
+    static constexpr uint32_t StpPreIndex(unsigned rt, unsigned rt2, unsigned rn, int32_t offset) {
+        return Pair(0xA9800000u, rt, rt2, rn, offset);
+    }
+
+    // ldp xt, xt2, [xn], #offset
+    static constexpr uint32_t LdpPostIndex(unsigned rt, unsigned rt2, unsigned rn, int32_t offset) {
+        return Pair(0xA8C00000u, rt, rt2, rn, offset);
+    }
+
+    // stp/ldp xt, xt2, [xn, #offset]
+    static constexpr uint32_t Stp(unsigned rt, unsigned rt2, unsigned rn, int32_t offset) {
+        return Pair(0xA9000000u, rt, rt2, rn, offset);
+    }
+
+    static constexpr uint32_t Ldp(unsigned rt, unsigned rt2, unsigned rn, int32_t offset) {
+        return Pair(0xA9400000u, rt, rt2, rn, offset);
+    }
+
+    // add/sub xd|sp, xn|sp, #imm12
+    static constexpr uint32_t AddImmediate(unsigned rd, unsigned rn, uint32_t imm) {
+        return EncodingCheck::Require(imm < 4096, 0x91000000u | (imm << 10) | (rn << 5) | rd);
+    }
+
+    static constexpr uint32_t SubImmediate(unsigned rd, unsigned rn, uint32_t imm) {
+        return EncodingCheck::Require(imm < 4096, 0xD1000000u | (imm << 10) | (rn << 5) | rd);
+    }
+
+    // mov xd, xm (orr xd, xzr, xm), 不能用于sp
+    static constexpr uint32_t Mov(unsigned rd, unsigned rm) {
+        return 0xAA0003E0u | (rm << 16) | rd;
+    }
+
+    // mov xd|sp, xn|sp (add xd, xn, #0)
+    static constexpr uint32_t MovSp(unsigned rd, unsigned rn) {
+        return AddImmediate(rd, rn, 0);
+    }
+
+    static constexpr uint32_t Movz(unsigned rd, uint16_t imm, unsigned shift) {
+        return EncodingCheck::Require(shift % 16 == 0 && shift < 64,
+                                      0xD2800000u | ((shift / 16) << 21) | ((uint32_t) imm << 5) |
+                                      rd);
+    }
+
+    static constexpr uint32_t Movk(unsigned rd, uint16_t imm, unsigned shift) {
+        return EncodingCheck::Require(shift % 16 == 0 && shift < 64,
+                                      0xF2800000u | ((shift / 16) << 21) | ((uint32_t) imm << 5) |
+                                      rd);
+    }
+
+    static constexpr uint32_t Br(unsigned rn) {
+        return 0xD61F0000u | (rn << 5);
+    }
+
+    static constexpr uint32_t Blr(unsigned rn) {
+        return 0xD63F0000u | (rn << 5);
+    }
+
+    static constexpr uint32_t Ret(unsigned rn = kLr) {
+        return 0xD65F0000u | (rn << 5);
+    }
+
+    // b/bl label, offset = 目标 - 当前指令
+    static constexpr uint32_t Branch(uint32_t opcode, int32_t offset) {
+        return EncodingCheck::Require(EncodingCheck::IsAligned(offset, 4) &&
+                                      EncodingCheck::IsInt(offset, 28),
+                                      opcode | (((uint32_t) offset >> 2) & 0x03ffffffu));
+    }
+
+    static constexpr uint32_t B(int32_t offset) {
+        return Branch(0x14000000u, offset);
+    }
+
+    static constexpr uint32_t Bl(int32_t offset) {
+        return Branch(0x94000000u, offset);
+    }
+};
+
+#endif //PROFILER_INSTRUCTIONENCODING_H
@@ -0,0 +1,282 @@
+#include "InstructionEncoding.h"
+
+#include <gtest/gtest.h>
+
+#include "aarch32/assembler-aarch32.h"
+#include "aarch32/operands-aarch32.h"
+#include "aarch64/assembler-aarch64.h"
+
+namespace a32 = vixl::aarch32;
+namespace a64 = vixl::aarch64;
+
+// 编码结果必须是编译期常量
+static constexpr uint32_t kCompileTimeStub[] = {
+        A32Encoder::Push(0x4010),
+        A32Encoder::LdrLiteral(4, 0),
+        A32Encoder::Blx(4),
+        A32Encoder::Pop(0x8010),
+};
+static_assert(kCompileTimeStub[0] == 0xE92D4010u, "push {r4, lr}");
+
+namespace {
+
+uint32_t AssembleA32(void (*emit)(a32::Assembler *)) {
+    a32::Assembler assm(a32::A32);
+    emit(&assm);
+    assm.FinalizeCode();
+    EXPECT_EQ(4u, assm.GetSizeOfCodeGenerated());
+    return *assm.GetBuffer()->GetStartAddress<uint32_t *>();
+}
+
+// 32位T32指令按First/Second的约定拼成一个字
+uint32_t AssembleT32(void (*emit)(a32::Assembler *)) {
+    a32::Assembler assm(a32::T32);
+    emit(&assm);
+    assm.FinalizeCode();
+    const uint16_t *halfwords = assm.GetBuffer()->GetStartAddress<uint16_t *>();
+    if (assm.GetSizeOfCodeGenerated() == 2) {
+        return halfwords[0];
+    }
+    EXPECT_EQ(4u, assm.GetSizeOfCodeGenerated());
+    return ((uint32_t) halfwords[0] << 16) | halfwords[1];
+}
+
+uint32_t AssembleA64(void (*emit)(a64::Assembler *)) {
+    a64::Assembler assm;
+    emit(&assm);
+    assm.FinalizeCode();
+    EXPECT_EQ(4u, assm.GetSizeOfCodeGenerated());
+    return *assm.GetBuffer()->GetStartAddress<uint32_t *>();
+}
+
+}  // namespace
+
+TEST(InstructionEncoding, A32PushPop) {
+    EXPECT_EQ(AssembleA32([](a32::Assembler *assm) {
+        assm->push(a32::RegisterList(a32::r4, a32::r5, a32::r6, a32::lr));
+    }), A32Encoder::Push(0x4070));
+    EXPECT_EQ(AssembleA32([](a32::Assembler *assm) {
+        assm->pop(a32::RegisterList(a32::r4, a32::r5, a32::r6, a32::pc));
+    }), A32Encoder::Pop(0x8070));
+}
+
+TEST(InstructionEncoding, A32LoadStore) {
+    EXPECT_EQ(AssembleA32([](a32::Assembler *assm) {
+        assm->str(a32::lr, a32::MemOperand(a32::sp, 13 * 4));
+    }), A32Encoder::Str(A32Encoder::kLr, A32Encoder::kSp, 13 * 4));
+    EXPECT_EQ(AssembleA32([](a32::Assembler *assm) {
+        assm->ldr(a32::r0, a32::MemOperand(a32::r6, 12));
+    }), A32Encoder::Ldr(0, 6, 12));
+    EXPECT_EQ(AssembleA32([](a32::Assembler *assm) {
+        assm->ldr(a32::r1, a32::MemOperand(a32::r2, -8));
+    }), A32Encoder::Ldr(1, 2, -8));
+    EXPECT_EQ(AssembleA32([](a32::Assembler *assm) {
+        assm->ldr(a32::r1, a32::MemOperand(a32::sp, 4, a32::PostIndex));
+    }), A32Encoder::LdrPostIndex(1, A32Encoder::kSp, 4));
+    EXPECT_EQ(AssembleA32([](a32::Assembler *assm) {
+        assm->ldr(a32::r3, a32::MemOperand(a32::pc, 0x44));
+    }), A32Encoder::LdrLiteral(3, 0x44));
+}
+
+TEST(InstructionEncoding, A32DataProcessing) {
+    EXPECT_EQ(AssembleA32([](a32::Assembler *assm) {
+        assm->sub(a32::sp, a32::sp, 56);
+    }), A32Encoder::SubImmediate(A32Encoder::kSp, A32Encoder::kSp, 56));
+    EXPECT_EQ(AssembleA32([](a32::Assembler *assm) {
+        assm->add(a32::sp, a32::sp, 0x3F0);
+    }), A32Encoder::AddImmediate(A32Encoder::kSp, A32Encoder::kSp, 0x3F0));
+    EXPECT_EQ(AssembleA32([](a32::Assembler *assm) {
+        assm->add(a32::r0, a32::r1, 0xFF000000);
+    }), A32Encoder::AddImmediate(0, 1, 0xFF000000));
+    EXPECT_EQ(AssembleA32([](a32::Assembler *assm) {
+        assm->mov(a32::r2, a32::sp);
+    }), A32Encoder::Mov(2, A32Encoder::kSp));
+    EXPECT_EQ(AssembleA32([](a32::Assembler *assm) {
+        assm->movw(a32::r3, 0xBEEF);
+    }), A32Encoder::Movw(3, 0xBEEF));
+    EXPECT_EQ(AssembleA32([](a32::Assembler *assm) {
+        assm->movt(a32::r3, 0xDEAD);
+    }), A32Encoder::Movt(3, 0xDEAD));
+}
+
+TEST(InstructionEncoding, A32Branches) {
+    EXPECT_EQ(AssembleA32([](a32::Assembler *assm) {
+        assm->bx(a32::lr);
+    }), A32Encoder::Bx(A32Encoder::kLr));
+    EXPECT_EQ(AssembleA32([](a32::Assembler *assm) {
+        assm->blx(a32::r4);
+    }), A32Encoder::Blx(4));
+
+    // 向后跳: label绑定在前面; 向前跳: label在后面的nop之后
+    for (int32_t nops : {0, 1, 64}) {
+        a32::Assembler backward(a32::A32);
+        a32::Label head;
+        backward.bind(&head);
+        for (int32_t i = 0; i < nops; ++i) backward.nop();
+        backward.b(&head);
+        backward.bl(&head);
+        backward.FinalizeCode();
+        const uint32_t *code = backward.GetBuffer()->GetStartAddress<uint32_t *>();
+        EXPECT_EQ(code[nops], A32Encoder::B(-nops * 4 - 8)) << nops;
+        EXPECT_EQ(code[nops + 1], A32Encoder::Bl(-nops * 4 - 12)) << nops;
+
+        a32::Assembler forward(a32::A32);
+        a32::Label tail;
+        forward.b(&tail);
+        forward.bl(&tail);
+        for (int32_t i = 0; i < nops; ++i) forward.nop();
+        forward.bind(&tail);
+        forward.FinalizeCode();
+        code = forward.GetBuffer()->GetStartAddress<uint32_t *>();
+        EXPECT_EQ(code[0], A32Encoder::B(nops * 4)) << nops;
+        EXPECT_EQ(code[1], A32Encoder::Bl(nops * 4 - 4)) << nops;
+    }
+    // 范围两端
+    EXPECT_EQ(0xEA800000u, A32Encoder::B(-0x2000000));
+    EXPECT_EQ(0xEB7FFFFFu, A32Encoder::Bl(0x1fffffc));
+}
+
+TEST(InstructionEncoding, A32ModifiedImmediateRange) {
+    EXPECT_THROW(A32Encoder::ModifiedImmediate(0x101), std::out_of_range);
+    EXPECT_THROW(A32Encoder::Ldr(0, 1, 4096), std::out_of_range);
+    EXPECT_THROW(A32Encoder::B(2), std::out_of_range);
+}
+
+TEST(InstructionEncoding, T32) {
+    EXPECT_EQ(AssembleT32([](a32::Assembler *assm) {
+        assm->push(a32::Wide, a32::RegisterList(a32::r4, a32::r5, a32::lr));
+    }), T32Encoder::PushW(0x4030));
+    EXPECT_EQ(AssembleT32([](a32::Assembler *assm) {
+        assm->pop(a32::Wide, a32::RegisterList(a32::r4, a32::r5, a32::pc));
+    }), T32Encoder::PopW(0x8030));
+    EXPECT_EQ(AssembleT32([](a32::Assembler *assm) {
+        assm->ldr(a32::Wide, a32::r0, a32::MemOperand(a32::r1, 8));
+    }), T32Encoder::LdrW(0, 1, 8));
+    EXPECT_EQ(AssembleT32([](a32::Assembler *assm) {
+        assm->str(a32::Wide, a32::r12, a32::MemOperand(a32::sp, 0x100));
+    }), T32Encoder::StrW(12, T32Encoder::kSp, 0x100));
+    EXPECT_EQ(AssembleT32([](a32::Assembler *assm) {
+        assm->ldr(a32::Wide, a32::pc, a32::MemOperand(a32::pc, 0));
+    }), T32Encoder::LdrLiteralW(T32Encoder::kPc, 0));
+    EXPECT_EQ(AssembleT32([](a32::Assembler *assm) {
+        assm->ldr(a32::Wide, a32::r2, a32::MemOperand(a32::pc, -12));
+    }), T32Encoder::LdrLiteralW(2, -12));
+    EXPECT_EQ(AssembleT32([](a32::Assembler *assm) {
+        assm->mov(a32::Narrow, a32::r8, a32::r1);
+    }), T32Encoder::Mov(8, 1));
+    EXPECT_EQ(AssembleT32([](a32::Assembler *assm) {
+        assm->bx(a32::lr);
+    }), T32Encoder::Bx(T32Encoder::kLr));
+    EXPECT_EQ(AssembleT32([](a32::Assembler *assm) {
+        assm->blx(a32::r3);
+    }), T32Encoder::Blx(3));
+    EXPECT_EQ(AssembleT32([](a32::Assembler *assm) {
+        assm->nop(a32::Narrow);
+    }), T32Encoder::Nop());
+}
+
+TEST(InstructionEncoding, T32Branches) {
+    for (int32_t nops : {0, 1, 3, 100}) {
+        a32::Assembler backward(a32::T32);
+        a32::Label head;
+        backward.bind(&head);
+        for (int32_t i = 0; i < nops; ++i) backward.nop();
+        backward.b(a32::Wide, &head);
+        backward.bl(&head);
+        backward.FinalizeCode();
+        const uint16_t *code = backward.GetBuffer()->GetStartAddress<uint16_t *>() + nops;
+        uint32_t b = T32Encoder::BW(-nops * 2 - 4);
+        uint32_t bl = T32Encoder::Bl(-nops * 2 - 8);
+        EXPECT_EQ(code[0], T32Encoder::First(b)) << nops;
+        EXPECT_EQ(code[1], T32Encoder::Second(b)) << nops;
+        EXPECT_EQ(code[2], T32Encoder::First(bl)) << nops;
+        EXPECT_EQ(code[3], T32Encoder::Second(bl)) << nops;
+
+        a32::Assembler forward(a32::T32);
+        a32::Label tail;
+        forward.b(a32::Wide, &tail);
+        forward.bl(&tail);
+        for (int32_t i = 0; i < nops; ++i) forward.nop();
+        forward.bind(&tail);
+        forward.FinalizeCode();
+        code = forward.GetBuffer()->GetStartAddress<uint16_t *>();
+        b = T32Encoder::BW(nops * 2 + 4);
+        bl = T32Encoder::Bl(nops * 2);
+        EXPECT_EQ(code[0], T32Encoder::First(b)) << nops;
+        EXPECT_EQ(code[1], T32Encoder::Second(b)) << nops;
+        EXPECT_EQ(code[2], T32Encoder::First(bl)) << nops;
+        EXPECT_EQ(code[3], T32Encoder::Second(bl)) << nops;
+    }
+    // 范围两端, 对照ARM ARM的编码
+    EXPECT_EQ(0xF4009000u, T32Encoder::BW(-0x1000000));
+    EXPECT_EQ(0xF3FF97FFu, T32Encoder::BW(0xfffffe));
+    EXPECT_THROW(T32Encoder::BW(1), std::out_of_range);
+}
+
+TEST(InstructionEncoding, A64LoadStore) {
+    EXPECT_EQ(AssembleA64([](a64::Assembler *assm) {
+        assm->ldr(a64::x17, 2);
+    }), A64Encoder::LdrLiteral(17, 8));
+    EXPECT_EQ(AssembleA64([](a64::Assembler *assm) {
+        assm->ldr(a64::x16, -3);
+    }), A64Encoder::LdrLiteral(16, -12));
+    EXPECT_EQ(AssembleA64([](a64::Assembler *assm) {
+        assm->ldr(a64::x0, a64::MemOperand(a64::x1, 16));
+    }), A64Encoder::LdrUnsignedOffset(0, 1, 16));
+    EXPECT_EQ(AssembleA64([](a64::Assembler *assm) {
+        assm->str(a64::x30, a64::MemOperand(a64::sp, 0x7ff8));
+    }), A64Encoder::StrUnsignedOffset(30, A64Encoder::kSp, 0x7ff8));
+    EXPECT_EQ(AssembleA64([](a64::Assembler *assm) {
+        assm->stp(a64::x29, a64::x30, a64::MemOperand(a64::sp, -16, a64::PreIndex));
+    }), A64Encoder::StpPreIndex(29, 30, A64Encoder::kSp, -16));
+    EXPECT_EQ(AssembleA64([](a64::Assembler *assm) {
+        assm->ldp(a64::x29, a64::x30, a64::MemOperand(a64::sp, 16, a64::PostIndex));
+    }), A64Encoder::LdpPostIndex(29, 30, A64Encoder::kSp, 16));
+    EXPECT_EQ(AssembleA64([](a64::Assembler *assm) {
+        assm->stp(a64::x0, a64::x1, a64::MemOperand(a64::sp, 0x1f8));
+    }), A64Encoder::Stp(0, 1, A64Encoder::kSp, 0x1f8));
+    EXPECT_EQ(AssembleA64([](a64::Assembler *assm) {
+        assm->ldp(a64::x2, a64::x3, a64::MemOperand(a64::x4, -512));
+    }), A64Encoder::Ldp(2, 3, 4, -512));
+}
+
+TEST(InstructionEncoding, A64DataProcessing) {
+    EXPECT_EQ(AssembleA64([](a64::Assembler *assm) {
+        assm->sub(a64::sp, a64::sp, 0x150);
+    }), A64Encoder::SubImmediate(A64Encoder::kSp, A64Encoder::kSp, 0x150));
+    EXPECT_EQ(AssembleA64([](a64::Assembler *assm) {
+        assm->add(a64::sp, a64::sp, 0xfff);
+    }), A64Encoder::AddImmediate(A64Encoder::kSp, A64Encoder::kSp, 0xfff));
+    EXPECT_EQ(AssembleA64([](a64::Assembler *assm) {
+        assm->mov(a64::x2, a64::sp);
+    }), A64Encoder::MovSp(2, A64Encoder::kSp));
+    EXPECT_EQ(AssembleA64([](a64::Assembler *assm) {
+        assm->mov(a64::x1, a64::x19);
+    }), A64Encoder::Mov(1, 19));
+    EXPECT_EQ(AssembleA64([](a64::Assembler *assm) {
+        assm->movz(a64::x3, 0xbeef, 16);
+    }), A64Encoder::Movz(3, 0xbeef, 16));
+    EXPECT_EQ(AssembleA64([](a64::Assembler *assm) {
+        assm->movk(a64::x3, 0xdead, 48);
+    }), A64Encoder::Movk(3, 0xdead, 48));
+}
+
+TEST(InstructionEncoding, A64Branches) {
+    EXPECT_EQ(AssembleA64([](a64::Assembler *assm) {
+        assm->br(a64::x17);
+    }), A64Encoder::Br(17));
+    EXPECT_EQ(AssembleA64([](a64::Assembler *assm) {
+        assm->blr(a64::x16);
+    }), A64Encoder::Blr(16));
+    EXPECT_EQ(AssembleA64([](a64::Assembler *assm) {
+        assm->ret();
+    }), A64Encoder::Ret());
+    EXPECT_EQ(AssembleA64([](a64::Assembler *assm) {
+        assm->b(-0x2000000);
+    }), A64Encoder::B(-0x8000000));
+    EXPECT_EQ(AssembleA64([](a64::Assembler *assm) {
+        assm->bl(0x1ffffff);
+    }), A64Encoder::Bl(0x7fffffc));
+    EXPECT_THROW(A64Encoder::B(0x8000000), std::out_of_range);
+    EXPECT_THROW(A64Encoder::LdrLiteral(0, 2), std::out_of_range);
+}
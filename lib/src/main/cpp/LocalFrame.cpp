@@ -0,0 +1,31 @@
+#include "LocalFrame.h"
+
+#include <string.h>
+
+const jint LocalFrame::kCallbackLocalRefs;
+
+jint LocalFrame::CapacityForShorty(const char *shorty) {
+    if (shorty == nullptr) {
+        return kCallbackLocalRefs;
+    }
+    return kCallbackLocalRefs + (jint) strlen(shorty);
+}
+
+LocalFrame::LocalFrame(JNIEnv *env, jint capacity)
+        : env_(env),
+          pushed_(env->PushLocalFrame(capacity) == JNI_OK) {
+}
+
+LocalFrame::~LocalFrame() {
+    if (pushed_) {
+        env_->PopLocalFrame(nullptr);
+    }
+}
+
+jobject LocalFrame::Pop(jobject result) {
+    if (!pushed_) {
+        return result;
+    }
+    pushed_ = false;
+    return env_->PopLocalFrame(result);
+}
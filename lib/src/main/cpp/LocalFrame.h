@@ -0,0 +1,62 @@
+#ifndef PROFILER_LOCALFRAME_H
+#define PROFILER_LOCALFRAME_H
+
+#include <jni.h>
+
+/**
+ * hook回调的局部引用帧. 被hook的方法入口直接换成了跳板, 回调不经过ART的JNI方法入口,
+ * 没有自己的局部引用帧, 回调里创建的局部引用都留在调用者的帧上; native代码循环调用被hook的方法时,
+ * 局部引用表会一直增长直到溢出. 回调开头放一个LocalFrame, 每次调用用掉的局部引用就是常数.
+ *
+ * 与fbjni的JniLocalScope不同, 这里不抛C++异常(回调的调用栈上是ART的帧):
+ * PushLocalFrame失败时OutOfMemoryError留在env上, 带着挂起的异常不能再调用JNI,
+ * 回调必须直接返回零值, 让异常抛回Java. Run()把这一步包好了.
+ */
+class LocalFrame {
+public:
+    // 回调自己最多创建的局部引用, 比如参数数组/返回值字符串
+    static const jint kCallbackLocalRefs = 4;
+
+    /**
+     * @return 帧的大小: 返回值和每个参数各一个(装箱或复制引用), 再加kCallbackLocalRefs.
+     *         shorty为空时只有kCallbackLocalRefs
+     */
+    static jint CapacityForShorty(const char *shorty);
+
+    /**
+     * 在新帧里执行body, body返回的引用(可以为空)转成外层帧的局部引用.
+     * PushLocalFrame失败时body不执行, 返回nullptr, OutOfMemoryError留在env上
+     */
+    template<typename Body>
+    static jobject Run(JNIEnv *env, jint capacity, Body body) {
+        LocalFrame frame(env, capacity);
+        if (!frame.IsPushed()) {
+            return nullptr;
+        }
+        return frame.Pop(body());
+    }
+
+    LocalFrame(JNIEnv *env, jint capacity);
+
+    ~LocalFrame();
+
+    /**
+     * 提前结束这个帧, result(可以为空)转成外层帧的局部引用返回, 析构时不再Pop.
+     * 回调要返回的引用必须经过这里, 否则返回的是已经释放的引用
+     */
+    jobject Pop(jobject result);
+
+    bool IsPushed() const {
+        return pushed_;
+    }
+
+private:
+    LocalFrame(const LocalFrame &);
+
+    LocalFrame &operator=(const LocalFrame &);
+
+    JNIEnv *env_;
+    bool pushed_;
+};
+
+#endif //PROFILER_LOCALFRAME_H
@@ -0,0 +1,143 @@
+#include "LocalFrame.h"
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+namespace {
+
+// 只实现PushLocalFrame/PopLocalFrame的JNIEnv, 记录帧的深度
+struct FakeEnv {
+    JNINativeInterface functions;
+    JNIEnv env;
+    int depth = 0;
+    int pushes = 0;
+    jint lastCapacity = 0;
+    jobject lastPopResult = nullptr;
+    bool failPush = false;
+    bool exceptionPending = false;
+
+    FakeEnv() {
+        memset(&functions, 0, sizeof(functions));
+        functions.PushLocalFrame = Push;
+        functions.PopLocalFrame = PopFrame;
+        env.functions = &functions;
+    }
+
+    static FakeEnv *From(JNIEnv *env) {
+        return reinterpret_cast<FakeEnv *>(reinterpret_cast<char *>(env) -
+                                           offsetof(FakeEnv, env));
+    }
+
+    static jint Push(JNIEnv *env, jint capacity) {
+        FakeEnv *fake = From(env);
+        fake->lastCapacity = capacity;
+        if (fake->failPush) {
+            //真实的PushLocalFrame失败时会挂一个OutOfMemoryError
+            fake->exceptionPending = true;
+            return JNI_ERR;
+        }
+        fake->depth++;
+        fake->pushes++;
+        return JNI_OK;
+    }
+
+    // 外层帧里的引用用result的地址+1表示
+    static jobject PopFrame(JNIEnv *env, jobject result) {
+        FakeEnv *fake = From(env);
+        fake->depth--;
+        fake->lastPopResult = result;
+        return result == nullptr ? nullptr
+                                 : reinterpret_cast<jobject>(
+                                         reinterpret_cast<char *>(result) + 1);
+    }
+};
+
+}  // namespace
+
+TEST(LocalFrameTest, CapacityCountsReturnAndParameters) {
+    EXPECT_EQ(LocalFrame::kCallbackLocalRefs, LocalFrame::CapacityForShorty(nullptr));
+    EXPECT_EQ(LocalFrame::kCallbackLocalRefs, LocalFrame::CapacityForShorty(""));
+    EXPECT_EQ(LocalFrame::kCallbackLocalRefs + 1, LocalFrame::CapacityForShorty("V"));
+    EXPECT_EQ(LocalFrame::kCallbackLocalRefs + 4, LocalFrame::CapacityForShorty("LJLD"));
+}
+
+TEST(LocalFrameTest, PopsOnScopeExit) {
+    FakeEnv fake;
+    {
+        LocalFrame frame(&fake.env, 7);
+        EXPECT_TRUE(frame.IsPushed());
+        EXPECT_EQ(1, fake.depth);
+        EXPECT_EQ(7, fake.lastCapacity);
+    }
+    EXPECT_EQ(0, fake.depth);
+    EXPECT_EQ(nullptr, fake.lastPopResult);
+}
+
+TEST(LocalFrameTest, PopHandsResultToOuterFrameOnce) {
+    FakeEnv fake;
+    char object;
+    jobject local = reinterpret_cast<jobject>(&object);
+    {
+        LocalFrame frame(&fake.env, 4);
+        jobject outer = frame.Pop(local);
+        EXPECT_EQ(reinterpret_cast<jobject>(&object + 1), outer);
+        EXPECT_FALSE(frame.IsPushed());
+        EXPECT_EQ(0, fake.depth);
+    }
+    EXPECT_EQ(0, fake.depth);
+}
+
+TEST(LocalFrameTest, FailedPushLeavesReferencesAlone) {
+    FakeEnv fake;
+    fake.failPush = true;
+    char object;
+    jobject local = reinterpret_cast<jobject>(&object);
+    {
+        LocalFrame frame(&fake.env, 4);
+        EXPECT_FALSE(frame.IsPushed());
+        EXPECT_EQ(local, frame.Pop(local));
+    }
+    EXPECT_EQ(0, fake.depth);
+    EXPECT_EQ(nullptr, fake.lastPopResult);
+}
+
+TEST(LocalFrameTest, RepeatedCallbacksKeepDepthConstant) {
+    FakeEnv fake;
+    for (int i = 0; i < 1000; ++i) {
+        LocalFrame frame(&fake.env, LocalFrame::CapacityForShorty("VL"));
+        EXPECT_EQ(1, fake.depth);
+    }
+    EXPECT_EQ(0, fake.depth);
+    EXPECT_EQ(1000, fake.pushes);
+}
+
+TEST(LocalFrameTest, RunHandsBodyResultToOuterFrame) {
+    FakeEnv fake;
+    char object;
+    int calls = 0;
+    jobject outer = LocalFrame::Run(&fake.env, 4, [&]() -> jobject {
+        calls++;
+        EXPECT_EQ(1, fake.depth);
+        return reinterpret_cast<jobject>(&object);
+    });
+    EXPECT_EQ(1, calls);
+    EXPECT_EQ(reinterpret_cast<jobject>(&object + 1), outer);
+    EXPECT_EQ(0, fake.depth);
+}
+
+TEST(LocalFrameTest, RunSkipsBodyWhenPushFails) {
+    FakeEnv fake;
+    fake.failPush = true;
+    int calls = 0;
+    jobject outer = LocalFrame::Run(&fake.env, 4, [&]() -> jobject {
+        calls++;
+        return nullptr;
+    });
+    //异常挂着的时候body里的JNI调用都是非法的, 不能执行
+    EXPECT_EQ(0, calls);
+    EXPECT_EQ(nullptr, outer);
+    EXPECT_TRUE(fake.exceptionPending);
+    EXPECT_EQ(0, fake.depth);
+    EXPECT_EQ(nullptr, fake.lastPopResult);
+}
@@ -0,0 +1,203 @@
+#include "PagePool.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+
+constexpr size_t PagePool::kMaxCachedPages;
+
+static void *mapPages(size_t size) {
+    void *space = mmap(0, size, PROT_READ | PROT_WRITE | PROT_EXEC,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return space == MAP_FAILED ? nullptr : space;
+}
+
+PagePool &PagePool::Get() {
+    static PagePool *pool = new PagePool();
+    return *pool;
+}
+
+PagePool::PagePool() : pageSize_((size_t) sysconf(_SC_PAGESIZE)) {
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+size_t PagePool::ClassIndex(size_t size) {
+    size_t index = 0;
+    while (ClassSize(index) < size) {
+        index++;
+    }
+    return index;
+}
+
+PagePool::Page *PagePool::TakePage(size_t classIndex) {
+    if (emptyPages_.empty()) {
+        size_t chunkSize = kPagesPerChunk * pageSize_;
+        uintptr_t chunk = (uintptr_t) mapPages(chunkSize);
+        stats_.mmapCalls++;
+        if (chunk == 0) {
+            return nullptr;
+        }
+        stats_.mappedBytes += chunkSize;
+        for (size_t i = kPagesPerChunk; i > 0; --i) {
+            emptyPages_.push_back(chunk + (i - 1) * pageSize_);
+        }
+        stats_.cachedPages += kPagesPerChunk;
+    }
+    uintptr_t base = emptyPages_.back();
+    emptyPages_.pop_back();
+    stats_.cachedPages--;
+
+    Page &page = pages_[base];
+    page.base = base;
+    page.classIndex = (uint32_t) classIndex;
+    page.used = 0;
+    page.freeList = nullptr;
+    page.bumpOffset = 0;
+    page.live.assign(pageSize_ / ClassSize(classIndex), false);
+    partial_[classIndex].push_back(&page);
+    return &page;
+}
+
+void *PagePool::Allocate(size_t size) {
+    if (size == 0) {
+        return nullptr;
+    }
+    if (size > kMaxClassSize) {
+        return AllocateLarge(size);
+    }
+    size_t classIndex = ClassIndex(size);
+    size_t blockSize = ClassSize(classIndex);
+
+    std::lock_guard<std::mutex> guard(lock_);
+    std::vector<Page *> &partial = partial_[classIndex];
+    Page *page = partial.empty() ? TakePage(classIndex) : partial.back();
+    if (page == nullptr) {
+        return nullptr;
+    }
+
+    void *block;
+    if (page->freeList != nullptr) {
+        block = page->freeList;
+        page->freeList = *reinterpret_cast<void **>(block);
+    } else {
+        block = reinterpret_cast<void *>(page->base + page->bumpOffset);
+        page->bumpOffset += blockSize;
+    }
+    page->used++;
+    page->live[((uintptr_t) block - page->base) / blockSize] = true;
+    if (page->freeList == nullptr && page->bumpOffset + blockSize > pageSize_) {
+        partial.pop_back();
+    }
+
+    stats_.allocations++;
+    stats_.usedBytes += blockSize;
+    stats_.requestedBytes += size;
+    stats_.classBlocks[classIndex]++;
+    //复用的块可能残留旧数据, 与mmap的语义保持一致
+    memset(block, 0, blockSize);
+    return block;
+}
+
+bool PagePool::Free(void *address, size_t size) {
+    if (address == nullptr || size == 0) {
+        return false;
+    }
+    if (size > kMaxClassSize) {
+        return FreeLarge(address, size);
+    }
+    size_t classIndex = ClassIndex(size);
+    size_t blockSize = ClassSize(classIndex);
+    uintptr_t base = (uintptr_t) address & ~(uintptr_t) (pageSize_ - 1);
+
+    std::lock_guard<std::mutex> guard(lock_);
+    auto it = pages_.find(base);
+    if (it == pages_.end() || it->second.classIndex != classIndex
+        || ((uintptr_t) address - base) % blockSize != 0) {
+        return false;
+    }
+    Page *page = &it->second;
+    size_t blockIndex = ((uintptr_t) address - base) / blockSize;
+    //重复释放会把同一个块两次放进freeList, 之后两次Allocate拿到同一块内存
+    if (!page->live[blockIndex]) {
+        return false;
+    }
+    page->live[blockIndex] = false;
+    std::vector<Page *> &partial = partial_[classIndex];
+    bool wasFull = page->freeList == nullptr && page->bumpOffset + blockSize > pageSize_;
+
+    *reinterpret_cast<void **>(address) = page->freeList;
+    page->freeList = address;
+    page->used--;
+
+    stats_.frees++;
+    stats_.usedBytes -= blockSize;
+    stats_.requestedBytes -= std::min(stats_.requestedBytes, size);
+    stats_.classBlocks[classIndex]--;
+
+    if (page->used == 0) {
+        if (!wasFull) {
+            partial.erase(std::find(partial.begin(), partial.end(), page));
+        }
+        pages_.erase(it);
+        ReleasePage(base);
+    } else if (wasFull) {
+        partial.push_back(page);
+    }
+    return true;
+}
+
+void PagePool::ReleasePage(uintptr_t base) {
+    if (emptyPages_.size() < kMaxCachedPages) {
+        emptyPages_.push_back(base);
+        stats_.cachedPages++;
+        return;
+    }
+    //chunk里的单页也可以单独munmap
+    if (munmap((void *) base, pageSize_) == 0) {
+        stats_.mappedBytes -= pageSize_;
+    }
+    stats_.munmapCalls++;
+}
+
+void *PagePool::AllocateLarge(size_t size) {
+    size_t mapped = (size + pageSize_ - 1) & ~(pageSize_ - 1);
+    void *space = mapPages(mapped);
+
+    std::lock_guard<std::mutex> guard(lock_);
+    stats_.mmapCalls++;
+    if (space == nullptr) {
+        return nullptr;
+    }
+    large_[(uintptr_t) space] = mapped;
+    stats_.mappedBytes += mapped;
+    stats_.allocations++;
+    stats_.usedBytes += mapped;
+    stats_.requestedBytes += size;
+    return space;
+}
+
+bool PagePool::FreeLarge(void *address, size_t size) {
+    size_t mapped;
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        auto it = large_.find((uintptr_t) address);
+        if (it == large_.end()) {
+            return false;
+        }
+        mapped = it->second;
+        large_.erase(it);
+        stats_.mappedBytes -= mapped;
+        stats_.frees++;
+        stats_.usedBytes -= mapped;
+        stats_.requestedBytes -= std::min(stats_.requestedBytes, size);
+        stats_.munmapCalls++;
+    }
+    return munmap(address, mapped) == 0;
+}
+
+PagePool::Stats PagePool::GetStats() {
+    std::lock_guard<std::mutex> guard(lock_);
+    return stats_;
+}
@@ -0,0 +1,88 @@
+#ifndef PROFILER_PAGEPOOL_H
+#define PROFILER_PAGEPOOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * RWX内存池, 替代InnerHooker.map/unmap每次一次mmap/munmap的做法.
+ *
+ * 小于等于kMaxClassSize的请求按2的幂取整到size class, 同一个class的块共享页,
+ * 页从一次mmap出来的chunk里切; 页上的块全部释放后页回到空页缓存, 可以被任意
+ * size class复用, 缓存超过kMaxCachedPages的空页直接munmap. 更大的请求直接mmap, 只做统计.
+ */
+class PagePool {
+public:
+    static constexpr size_t kMinClassSize = 16;
+    static constexpr size_t kMaxClassSize = 2048;
+    static constexpr size_t kClassCount = 8;  // 16 .. 2048
+    static constexpr size_t kPagesPerChunk = 16;
+    static constexpr size_t kMaxCachedPages = 2 * kPagesPerChunk;
+
+    struct Stats {
+        size_t mappedBytes;     // 通过mmap拿到且尚未munmap的字节数
+        size_t usedBytes;       // 已分配给调用方的字节数(按size class取整后)
+        size_t requestedBytes;  // 调用方请求的字节数
+        size_t allocations;
+        size_t frees;
+        size_t mmapCalls;
+        size_t munmapCalls;
+        size_t cachedPages;     // 空闲, 可被任意size class复用的页
+        size_t classBlocks[kClassCount];  // 各size class正在使用的块数
+    };
+
+    static PagePool &Get();
+
+    /**
+     * @return 清零的RWX内存, 失败返回nullptr
+     */
+    void *Allocate(size_t size);
+
+    /**
+     * @param size 必须与Allocate时的size一致
+     * @return address不是本池分配的内存, 或者已经释放过时返回false
+     */
+    bool Free(void *address, size_t size);
+
+    Stats GetStats();
+
+private:
+    struct Page {
+        uintptr_t base;
+        uint32_t classIndex;
+        uint32_t used;
+        void *freeList;
+        uint32_t bumpOffset;  // 尚未切分过的部分从这里开始
+        std::vector<bool> live;  // 每个块是否已分配, 用来发现重复释放
+    };
+
+    PagePool();
+
+    static size_t ClassIndex(size_t size);
+
+    static size_t ClassSize(size_t index) {
+        return kMinClassSize << index;
+    }
+
+    Page *TakePage(size_t classIndex);
+
+    void ReleasePage(uintptr_t base);
+
+    void *AllocateLarge(size_t size);
+
+    bool FreeLarge(void *address, size_t size);
+
+    std::mutex lock_;
+    size_t pageSize_;
+    std::unordered_map<uintptr_t, Page> pages_;
+    std::vector<Page *> partial_[kClassCount];  // 还有空闲块的页
+    std::vector<uintptr_t> emptyPages_;
+    std::unordered_map<uintptr_t, size_t> large_;
+    Stats stats_;
+};
+
+#endif //PROFILER_PAGEPOOL_H
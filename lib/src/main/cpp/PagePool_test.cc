@@ -0,0 +1,53 @@
+#include "PagePool.h"
+
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <set>
+#include <vector>
+
+TEST(PagePoolTest, DoubleFreeIsRejected) {
+    PagePool &pool = PagePool::Get();
+    void *block = pool.Allocate(64);
+    ASSERT_NE(nullptr, block);
+    EXPECT_TRUE(pool.Free(block, 64));
+    EXPECT_FALSE(pool.Free(block, 64));
+
+    //只入过一次freeList, 两次分配不会拿到同一块
+    void *first = pool.Allocate(64);
+    void *second = pool.Allocate(64);
+    EXPECT_NE(first, second);
+    EXPECT_TRUE(pool.Free(first, 64));
+    EXPECT_TRUE(pool.Free(second, 64));
+}
+
+TEST(PagePoolTest, FreeOfUnallocatedBlockIsRejected) {
+    PagePool &pool = PagePool::Get();
+    uint8_t *block = static_cast<uint8_t *>(pool.Allocate(32));
+    ASSERT_NE(nullptr, block);
+    //同一页上还没切出去的块
+    EXPECT_FALSE(pool.Free(block + 32 * 4, 32));
+    EXPECT_TRUE(pool.Free(block, 32));
+}
+
+TEST(PagePoolTest, EmptyPageCacheIsCapped) {
+    PagePool &pool = PagePool::Get();
+    std::vector<void *> blocks;
+    std::set<uintptr_t> pages;
+    size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+    //每块独占一页, 释放后空页数远超上限
+    while (pages.size() < 4 * PagePool::kMaxCachedPages) {
+        void *block = pool.Allocate(PagePool::kMaxClassSize);
+        ASSERT_NE(nullptr, block);
+        blocks.push_back(block);
+        pages.insert((uintptr_t) block & ~(uintptr_t) (pageSize - 1));
+    }
+    size_t munmapsBefore = pool.GetStats().munmapCalls;
+    for (void *block : blocks) {
+        EXPECT_TRUE(pool.Free(block, PagePool::kMaxClassSize));
+    }
+    PagePool::Stats stats = pool.GetStats();
+    EXPECT_LE(stats.cachedPages, PagePool::kMaxCachedPages);
+    EXPECT_GT(stats.munmapCalls, munmapsBefore);
+}
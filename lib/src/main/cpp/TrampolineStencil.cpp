@@ -0,0 +1,189 @@
+#include "TrampolineStencil.h"
+#include "ICacheBatch.h"
+#include "PagePool.h"
+
+#include <string.h>
+
+static const size_t kNotFound = static_cast<size_t>(-1);
+
+TrampolineArena &TrampolineArena::Get() {
+    //跳板不还给PagePool, 进程退出时也不析构
+    static TrampolineArena *arena = new TrampolineArena();
+    return *arena;
+}
+
+TrampolineArena::TrampolineArena() {
+    block_.base = nullptr;
+    block_.codeEnd = 0;
+    block_.islandStart = 0;
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+bool TrampolineArena::NewBlock() {
+    uint8_t *base = reinterpret_cast<uint8_t *>(PagePool::Get().Allocate(kBlockSize));
+    if (base == nullptr) {
+        return false;
+    }
+    //旧块剩下的空间直接放弃, 旧块上的跳板继续用旧块的常量岛
+    block_.base = base;
+    block_.codeEnd = 0;
+    block_.islandStart = kBlockSize;
+    block_.shared.clear();
+    stats_.blocks++;
+    return true;
+}
+
+size_t TrampolineArena::FindShared(uintptr_t value) const {
+    for (const auto &entry : block_.shared) {
+        if (entry.first == value) {
+            return entry.second;
+        }
+    }
+    return kNotFound;
+}
+
+bool TrampolineArena::PatchLiteralLoad(uint8_t *insn, size_t size,
+                                       TrampolineStencil::LiteralLoad kind,
+                                       const uint8_t *literal) {
+    switch (kind) {
+        case TrampolineStencil::kA32LdrLiteral: {
+            //A32读pc得到的是当前指令地址+8
+            intptr_t delta = literal - (insn + 8);
+            intptr_t magnitude = delta >= 0 ? delta : -delta;
+            if (size != 4 || magnitude > 4095) {
+                return false;
+            }
+            uint32_t word;
+            memcpy(&word, insn, sizeof(word));
+            word &= ~(0x00800000u | 0xFFFu);
+            word |= (delta >= 0 ? 0x00800000u : 0) | (uint32_t) magnitude;
+            memcpy(insn, &word, sizeof(word));
+            return true;
+        }
+        case TrampolineStencil::kX64RipRelative: {
+            //rip是下一条指令的地址, disp32是指令的最后4个字节
+            intptr_t delta = literal - (insn + size);
+            if (size < 4 || delta != (int32_t) delta) {
+                return false;
+            }
+            int32_t disp = (int32_t) delta;
+            memcpy(insn + size - sizeof(disp), &disp, sizeof(disp));
+            return true;
+        }
+    }
+    return false;
+}
+
+uint8_t *TrampolineArena::LiteralAddress(uint8_t *insn, size_t size,
+                                        TrampolineStencil::LiteralLoad kind) {
+    switch (kind) {
+        case TrampolineStencil::kA32LdrLiteral: {
+            uint32_t word;
+            memcpy(&word, insn, sizeof(word));
+            intptr_t magnitude = word & 0xFFFu;
+            return insn + 8 + ((word & 0x00800000u) ? magnitude : -magnitude);
+        }
+        case TrampolineStencil::kX64RipRelative: {
+            int32_t disp;
+            memcpy(&disp, insn + size - sizeof(disp), sizeof(disp));
+            return insn + size + disp;
+        }
+    }
+    return nullptr;
+}
+
+uintptr_t TrampolineArena::Instantiate(const TrampolineStencil &stencil, void *data,
+                                       void *handler) {
+    if (!stencil.IsReady()) {
+        return 0;
+    }
+    size_t size = stencil.code.size();
+    uintptr_t handlerValue = (uintptr_t) handler;
+
+    std::lock_guard<std::mutex> lock(lock_);
+    for (size_t i = free_.size(); i-- > 0;) {
+        if (free_[i].stencil != &stencil || free_[i].handler != handlerValue) {
+            continue;
+        }
+        uintptr_t entry = free_[i].entry;
+        free_.erase(free_.begin() + i);
+        uint8_t *code = reinterpret_cast<uint8_t *>(entry);
+        memcpy(LiteralAddress(code + stencil.dataLoadOffset, stencil.dataLoadSize,
+                              stencil.literalLoad), &data, sizeof(data));
+        stats_.trampolines++;
+        return entry;
+    }
+
+    size_t codeOffset = 0;
+    size_t handlerSlot = kNotFound;
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        if (block_.base != nullptr) {
+            codeOffset = (block_.codeEnd + kCodeAlignment - 1) & ~(kCodeAlignment - 1);
+            handlerSlot = FindShared(handlerValue);
+            size_t island = sizeof(void *) * (handlerSlot == kNotFound ? 2 : 1);
+            if (codeOffset + size + island <= block_.islandStart) {
+                break;
+            }
+        }
+        if (attempt == 1 || size + 2 * sizeof(void *) > kBlockSize || !NewBlock()) {
+            return 0;
+        }
+    }
+
+    uint8_t *base = block_.base;
+    if (handlerSlot == kNotFound) {
+        block_.islandStart -= sizeof(void *);
+        handlerSlot = block_.islandStart;
+        memcpy(base + handlerSlot, &handler, sizeof(handler));
+        block_.shared.push_back(std::make_pair(handlerValue, handlerSlot));
+        stats_.constantBytes += sizeof(void *);
+    } else {
+        stats_.sharedConstantHits++;
+    }
+    block_.islandStart -= sizeof(void *);
+    size_t dataSlot = block_.islandStart;
+    memcpy(base + dataSlot, &data, sizeof(data));
+    stats_.constantBytes += sizeof(void *);
+
+    uint8_t *code = base + codeOffset;
+    memcpy(code, stencil.code.data(), size);
+    if (!PatchLiteralLoad(code + stencil.dataLoadOffset, stencil.dataLoadSize,
+                          stencil.literalLoad, base + dataSlot) ||
+        !PatchLiteralLoad(code + stencil.handlerLoadOffset, stencil.handlerLoadSize,
+                          stencil.literalLoad, base + handlerSlot)) {
+        //块不超过4KB时不会发生, 模板本身有问题
+        return 0;
+    }
+    stats_.codeBytes += codeOffset + size - block_.codeEnd;
+    stats_.trampolines++;
+    block_.codeEnd = codeOffset + size;
+    //常量岛是数据, 只需要刷新代码部分
+    ICacheBatch::Invalidate(code, size);
+    return (uintptr_t) code;
+}
+
+void TrampolineArena::Release(const TrampolineStencil &stencil, uintptr_t entry) {
+    if (entry == 0) {
+        return;
+    }
+    uint8_t *code = reinterpret_cast<uint8_t *>(entry);
+    uintptr_t handler;
+    memcpy(&handler, LiteralAddress(code + stencil.handlerLoadOffset, stencil.handlerLoadSize,
+                                    stencil.literalLoad), sizeof(handler));
+    std::lock_guard<std::mutex> lock(lock_);
+    free_.push_back(FreeTrampoline{&stencil, entry, handler});
+    stats_.trampolines--;
+}
+
+TrampolineArena::Stats TrampolineArena::GetStats() {
+    std::lock_guard<std::mutex> lock(lock_);
+    return stats_;
+}
+
+uintptr_t InstantiateTrampoline(const TrampolineStencil &stencil, void *data, void *handler) {
+    return TrampolineArena::Get().Instantiate(stencil, data, handler);
+}
+
+void ReleaseTrampoline(const TrampolineStencil &stencil, uintptr_t entry) {
+    TrampolineArena::Get().Release(stencil, entry);
+}
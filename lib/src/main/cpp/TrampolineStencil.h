@@ -0,0 +1,125 @@
+#ifndef PROFILER_TRAMPOLINESTENCIL_H
+#define PROFILER_TRAMPOLINESTENCIL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/**
+ * 跳板模板. 所有跳板除了hookInfo和hookMethod两个常量外完全相同,
+ * 所以代码只在初始化时生成一次; 模板里不带常量, 只记下两条PC相对加载指令的偏移.
+ * 之后每个hook只是memcpy一份, 再把这两条加载指令指向TrampolineArena里的常量岛.
+ */
+struct TrampolineStencil {
+    enum LiteralLoad {
+        kA32LdrLiteral,   // ldr rt, [pc, #+/-imm12]
+        kX64RipRelative,  // mov reg, [rip + disp32], disp32在指令最后4字节
+    };
+
+    std::vector<uint8_t> code;
+    LiteralLoad literalLoad;
+    size_t dataLoadOffset;      // 加载hookInfo的指令在code中的偏移
+    size_t dataLoadSize;        // 该指令的长度
+    size_t handlerLoadOffset;   // 加载hookMethod的指令在code中的偏移
+    size_t handlerLoadSize;
+
+    TrampolineStencil()
+            : literalLoad(kA32LdrLiteral),
+              dataLoadOffset(0),
+              dataLoadSize(0),
+              handlerLoadOffset(0),
+              handlerLoadSize(0) {}
+
+    bool IsReady() const {
+        return !code.empty();
+    }
+};
+
+/**
+ * 跳板的代码区. 从PagePool按kBlockSize整块拿内存, 跳板从块头往后排,
+ * 常量从块尾往前排成一个常量岛; 块内所有跳板共用的常量(hookMethod等)只存一份.
+ * 块不超过4KB, A32的ldr literal(±4095)和x64的rip相对寻址都能覆盖整块.
+ *
+ * 跳板不还给PagePool. Release的跳板进空闲表, 之后同一模板同一handler的跳板直接复用,
+ * 只改写它的data常量, 代码不变也不用再刷新指令缓存.
+ */
+class TrampolineArena {
+public:
+    static constexpr size_t kBlockSize = 4096;
+    static constexpr size_t kCodeAlignment = 2 * sizeof(void *);
+
+    struct Stats {
+        size_t blocks;
+        size_t trampolines;     // 在用的跳板, Release之后不算
+        size_t codeBytes;       // 跳板代码, 含对齐填充
+        size_t constantBytes;   // 常量岛
+        size_t sharedConstantHits;  // 复用了块内已有常量的加载
+    };
+
+    static TrampolineArena &Get();
+
+    /**
+     * @param data 每个跳板自己的常量
+     * @param handler 块内去重的共享常量
+     * @return 跳板入口地址, 模板未初始化或内存不足时返回0
+     */
+    uintptr_t Instantiate(const TrampolineStencil &stencil, void *data, void *handler);
+
+    /**
+     * 回收Instantiate返回的跳板. 只能回收还没有发布出去的跳板, 比如批量hook中途失败时
+     */
+    void Release(const TrampolineStencil &stencil, uintptr_t entry);
+
+    Stats GetStats();
+
+private:
+    struct Block {
+        uint8_t *base;
+        size_t codeEnd;      // 下一个跳板从这里开始
+        size_t islandStart;  // 常量岛从这里到块尾
+        std::vector<std::pair<uintptr_t, size_t> > shared;  // 常量值 -> 块内偏移
+    };
+
+    TrampolineArena();
+
+    bool NewBlock();
+
+    size_t FindShared(uintptr_t value) const;
+
+    struct FreeTrampoline {
+        const TrampolineStencil *stencil;
+        uintptr_t entry;
+        uintptr_t handler;
+    };
+
+    static bool PatchLiteralLoad(uint8_t *insn, size_t size, TrampolineStencil::LiteralLoad kind,
+                                 const uint8_t *literal);
+
+    /**
+     * PatchLiteralLoad的逆过程: 加载指令读的常量地址
+     */
+    static uint8_t *LiteralAddress(uint8_t *insn, size_t size, TrampolineStencil::LiteralLoad kind);
+
+    std::mutex lock_;
+    Block block_;
+    std::vector<FreeTrampoline> free_;
+    Stats stats_;
+};
+
+/**
+ * 在TrampolineArena里实例化一个跳板, data/handler放进块的常量岛.
+ * 在ICacheBatch里调用时, 要等批次结束后才能跳到返回的地址.
+ *
+ * @return 跳板入口地址, 模板未初始化或内存不足时返回0
+ */
+uintptr_t InstantiateTrampoline(const TrampolineStencil &stencil, void *data, void *handler);
+
+/**
+ * 见TrampolineArena::Release
+ */
+void ReleaseTrampoline(const TrampolineStencil &stencil, uintptr_t entry);
+
+#endif //PROFILER_TRAMPOLINESTENCIL_H
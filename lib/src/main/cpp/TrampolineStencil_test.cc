@@ -0,0 +1,152 @@
+#include "TrampolineStencil.h"
+#include "ICacheBatch.h"
+#include "InstructionEncoding.h"
+#include "TrampolineX64.h"
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+namespace {
+
+// ldr rt, [pc, #+/-imm12] 实际读的地址
+uintptr_t A32LiteralAddress(uintptr_t insn) {
+    uint32_t word;
+    memcpy(&word, reinterpret_cast<const void *>(insn), sizeof(word));
+    uint32_t imm = word & 0xFFFu;
+    return (word & 0x00800000u) ? insn + 8 + imm : insn + 8 - imm;
+}
+
+uintptr_t LoadWord(uintptr_t address) {
+    uintptr_t value;
+    memcpy(&value, reinterpret_cast<const void *>(address), sizeof(value));
+    return value;
+}
+
+TrampolineStencil MakeA32Stencil() {
+    static const uint32_t kCode[] = {
+            A32Encoder::Push(0x4010),
+            A32Encoder::LdrLiteral(3, 0),
+            A32Encoder::LdrLiteral(4, 0),
+            A32Encoder::Blx(4),
+            A32Encoder::Pop(0x8010),
+    };
+    TrampolineStencil stencil;
+    const uint8_t *code = reinterpret_cast<const uint8_t *>(kCode);
+    stencil.code.assign(code, code + sizeof(kCode));
+    stencil.literalLoad = TrampolineStencil::kA32LdrLiteral;
+    stencil.dataLoadOffset = 4;
+    stencil.dataLoadSize = 4;
+    stencil.handlerLoadOffset = 8;
+    stencil.handlerLoadSize = 4;
+    return stencil;
+}
+
+}  // namespace
+
+TEST(TrampolineArenaTest, EmptyStencilIsRejected) {
+    TrampolineStencil stencil;
+    EXPECT_EQ(InstantiateTrampoline(stencil, nullptr, nullptr), 0u);
+}
+
+TEST(TrampolineArenaTest, A32LoadsReachTheIsland) {
+    TrampolineStencil stencil = MakeA32Stencil();
+    void *handler = reinterpret_cast<void *>(0x12345678);
+    TrampolineArena::Stats before = TrampolineArena::Get().GetStats();
+    for (uintptr_t i = 1; i <= 300; ++i) {
+        void *data = reinterpret_cast<void *>(i);
+        uintptr_t entry = InstantiateTrampoline(stencil, data, handler);
+        ASSERT_NE(entry, 0u);
+        ASSERT_EQ(entry % TrampolineArena::kCodeAlignment, 0u);
+        EXPECT_EQ(LoadWord(A32LiteralAddress(entry + 4)), i);
+        EXPECT_EQ(LoadWord(A32LiteralAddress(entry + 8)), (uintptr_t) handler);
+        // 其余指令原样拷贝
+        EXPECT_EQ(memcmp(reinterpret_cast<void *>(entry), stencil.code.data(), 4), 0);
+        EXPECT_EQ(memcmp(reinterpret_cast<void *>(entry + 12), stencil.code.data() + 12, 8), 0);
+    }
+    TrampolineArena::Stats after = TrampolineArena::Get().GetStats();
+    EXPECT_EQ(after.trampolines - before.trampolines, 300u);
+    // 跨越多个块, 每个块只存一份handler
+    size_t blocks = after.blocks - before.blocks;
+    EXPECT_GE(blocks, 2u);
+    EXPECT_EQ(after.constantBytes - before.constantBytes, (300 + blocks) * sizeof(void *));
+    EXPECT_EQ(after.sharedConstantHits - before.sharedConstantHits, 300 - blocks);
+}
+
+TEST(TrampolineArenaTest, DistinctHandlersGetDistinctSlots) {
+    TrampolineStencil stencil = MakeA32Stencil();
+    uintptr_t first = InstantiateTrampoline(stencil, nullptr, reinterpret_cast<void *>(0x1000));
+    uintptr_t second = InstantiateTrampoline(stencil, nullptr, reinterpret_cast<void *>(0x2000));
+    uintptr_t third = InstantiateTrampoline(stencil, nullptr, reinterpret_cast<void *>(0x1000));
+    ASSERT_TRUE(first != 0 && second != 0 && third != 0);
+    EXPECT_EQ(LoadWord(A32LiteralAddress(first + 8)), 0x1000u);
+    EXPECT_EQ(LoadWord(A32LiteralAddress(second + 8)), 0x2000u);
+    EXPECT_EQ(LoadWord(A32LiteralAddress(third + 8)), 0x1000u);
+    if (third - first < TrampolineArena::kBlockSize) {
+        EXPECT_EQ(A32LiteralAddress(first + 8), A32LiteralAddress(third + 8));
+    }
+}
+
+TEST(TrampolineArenaTest, ReleasedTrampolinesAreReused) {
+    TrampolineStencil stencil = MakeA32Stencil();
+    void *handler = reinterpret_cast<void *>(0x3000);
+    uintptr_t entry = InstantiateTrampoline(stencil, reinterpret_cast<void *>(1), handler);
+    ASSERT_NE(entry, 0u);
+    size_t trampolines = TrampolineArena::Get().GetStats().trampolines;
+    ReleaseTrampoline(stencil, entry);
+    EXPECT_EQ(TrampolineArena::Get().GetStats().trampolines, trampolines - 1);
+
+    // handler不同时不能复用
+    uintptr_t other = InstantiateTrampoline(stencil, reinterpret_cast<void *>(2),
+                                            reinterpret_cast<void *>(0x4000));
+    EXPECT_NE(other, entry);
+    size_t codeBytes = TrampolineArena::Get().GetStats().codeBytes;
+    uintptr_t reused = InstantiateTrampoline(stencil, reinterpret_cast<void *>(3), handler);
+    EXPECT_EQ(reused, entry);
+    EXPECT_EQ(LoadWord(A32LiteralAddress(reused + 4)), 3u);
+    EXPECT_EQ(LoadWord(A32LiteralAddress(reused + 8)), (uintptr_t) handler);
+    EXPECT_EQ(TrampolineArena::Get().GetStats().codeBytes, codeBytes);
+}
+
+#if defined(__x86_64__)
+
+static uint64_t Handler(uint64_t env, uint64_t obj, RegisterContextX64 *context, uint64_t data) {
+    EXPECT_EQ(context->general.regs.rdi, env);
+    EXPECT_EQ(context->general.regs.rsi, obj);
+    return env * 1000 + obj * 10 + data;
+}
+
+static void CheckX64Variant(TrampolineVariant variant) {
+    TrampolineStencil stencil;
+    BuildTrampolineStencilX64(&stencil, variant);
+    ASSERT_EQ(stencil.literalLoad, TrampolineStencil::kX64RipRelative);
+
+    typedef uint64_t (*Function)(uint64_t, uint64_t);
+    Function functions[200];
+    size_t flushes = ICacheBatch::GetStats().flushes;
+    size_t blocks = TrampolineArena::Get().GetStats().blocks;
+    {
+        ICacheBatch batch;
+        for (uintptr_t i = 0; i < 200; ++i) {
+            uintptr_t entry = InstantiateTrampoline(stencil, reinterpret_cast<void *>(i % 10),
+                                                    reinterpret_cast<void *>(&Handler));
+            ASSERT_NE(entry, 0u);
+            functions[i] = reinterpret_cast<Function>(entry);
+        }
+    }
+    // 块内的跳板首尾相接, 每个块最多刷新一次
+    EXPECT_LE(ICacheBatch::GetStats().flushes - flushes,
+              TrampolineArena::Get().GetStats().blocks - blocks + 1);
+    for (uint64_t i = 0; i < 200; ++i) {
+        EXPECT_EQ(functions[i](i, 3), i * 1000 + 30 + i % 10);
+    }
+}
+
+TEST(TrampolineArenaTest, X64TrampolinesCallTheSharedHandler) {
+    CheckX64Variant(kTrampolineX64Sse);
+    if (CpuFeatures::Get().Has(CpuFeatures::kAvx)) {
+        CheckX64Variant(kTrampolineX64Avx);
+    }
+}
+
+#endif
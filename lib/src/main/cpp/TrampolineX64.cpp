@@ -0,0 +1,137 @@
+#include "TrampolineX64.h"
+
+static const uint8_t kRexW = 0x48;
+static const uint8_t kRexR = 0x04;
+static const uint8_t kRexB = 0x01;
+
+void X64Assembler::Emit32(uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        Emit8((uint8_t) (value >> (i * 8)));
+    }
+}
+
+void X64Assembler::SubRsp(int32_t imm) {
+    // REX.W 81 /5 id
+    Emit8(kRexW);
+    Emit8(0x81);
+    Emit8(0xEC);
+    Emit32((uint32_t) imm);
+}
+
+void X64Assembler::AddRsp(int32_t imm) {
+    // REX.W 81 /0 id
+    Emit8(kRexW);
+    Emit8(0x81);
+    Emit8(0xC4);
+    Emit32((uint32_t) imm);
+}
+
+void X64Assembler::StoreToStack(Register reg, int32_t disp) {
+    // REX.W 89 /r, [rsp + disp32] 需要SIB
+    Emit8(kRexW | (reg >= r8 ? kRexR : 0));
+    Emit8(0x89);
+    Emit8((uint8_t) (0x80 | ((reg & 7) << 3) | 0x04));
+    Emit8(0x24);
+    Emit32((uint32_t) disp);
+}
+
+void X64Assembler::StoreXmmToStack(int xmm, int32_t disp) {
+    // 66 0F D6 /r  movq xmm/m64, xmm
+    Emit8(0x66);
+    if (xmm >= 8) {
+        Emit8(0x40 | kRexR);
+    }
+    Emit8(0x0F);
+    Emit8(0xD6);
+    Emit8((uint8_t) (0x80 | ((xmm & 7) << 3) | 0x04));
+    Emit8(0x24);
+    Emit32((uint32_t) disp);
+}
+
+void X64Assembler::VexStoreXmmToStack(int xmm, int32_t disp) {
+    // VEX.128.66.0F.WIG D6 /r  vmovq xmm/m64, xmm; 两字节VEX, R和vvvv取反存放
+    Emit8(0xC5);
+    Emit8((uint8_t) ((xmm >= 8 ? 0x00 : 0x80) | 0x79));
+    Emit8(0xD6);
+    Emit8((uint8_t) (0x80 | ((xmm & 7) << 3) | 0x04));
+    Emit8(0x24);
+    Emit32((uint32_t) disp);
+}
+
+void X64Assembler::MovFromRsp(Register dst) {
+    // REX.W 89 /r, mod=11 reg=rsp
+    Emit8(kRexW | (dst >= r8 ? kRexB : 0));
+    Emit8(0x89);
+    Emit8((uint8_t) (0xC0 | (rsp << 3) | (dst & 7)));
+}
+
+size_t X64Assembler::MovRipRelative(Register dst, int32_t disp) {
+    // REX.W 8B /r, mod=00 rm=101 即[rip + disp32]
+    size_t offset = buffer_.size();
+    Emit8(kRexW | (dst >= r8 ? kRexR : 0));
+    Emit8(0x8B);
+    Emit8((uint8_t) (0x05 | ((dst & 7) << 3)));
+    Emit32((uint32_t) disp);
+    return offset;
+}
+
+void X64Assembler::Call(Register target) {
+    // FF /2
+    if (target >= r8) {
+        Emit8(0x40 | kRexB);
+    }
+    Emit8(0xFF);
+    Emit8((uint8_t) (0xD0 | (target & 7)));
+}
+
+void X64Assembler::Ret() {
+    Emit8(0xC3);
+}
+
+static const X64Assembler::Register kSavedRegisters[] = {
+        X64Assembler::rdi, X64Assembler::rsi, X64Assembler::rdx, X64Assembler::rcx,
+        X64Assembler::r8, X64Assembler::r9, X64Assembler::rax, X64Assembler::rbx,
+        X64Assembler::rbp, X64Assembler::r10, X64Assembler::r11, X64Assembler::r12,
+        X64Assembler::r13, X64Assembler::r14, X64Assembler::r15,
+};
+
+static void generatorJumpMethodX64(TrampolineStencil *stencil, X64Assembler *masm,
+                                   TrampolineVariant variant) {
+    //返回地址已经在栈上, 作为RegisterContextX64的最后一个字段;
+    //入口处rsp % 16 == 8, 减去其余字段的大小后刚好16字节对齐
+    const int32_t frameSize = sizeof(RegisterContextX64) - sizeof(uint64_t);
+    static_assert((sizeof(RegisterContextX64) - sizeof(uint64_t)) % 16 == 8,
+                  "call site must be 16-byte aligned");
+
+    masm->SubRsp(frameSize);
+    int32_t offset = 0;
+    for (X64Assembler::Register reg : kSavedRegisters) {
+        masm->StoreToStack(reg, offset);
+        offset += sizeof(uint64_t);
+    }
+    for (int xmm = 0; xmm < 8; ++xmm) {
+        if (variant == kTrampolineX64Avx) {
+            masm->VexStoreXmmToStack(xmm, offset);
+        } else {
+            masm->StoreXmmToStack(xmm, offset);
+        }
+        offset += sizeof(uint64_t);
+    }
+    //rdi=>env rsi=>class or obj 保持不变, rdx=>RegisterContext rcx=>hook info
+    masm->MovFromRsp(X64Assembler::rdx);
+    stencil->literalLoad = TrampolineStencil::kX64RipRelative;
+    stencil->dataLoadOffset = masm->MovRipRelative(X64Assembler::rcx, 0);
+    stencil->dataLoadSize = X64Assembler::kMovRipRelativeSize;
+    stencil->handlerLoadOffset = masm->MovRipRelative(X64Assembler::rax, 0);
+    stencil->handlerLoadSize = X64Assembler::kMovRipRelativeSize;
+    masm->Call(X64Assembler::rax);
+    masm->AddRsp(frameSize);
+    masm->Ret();
+}
+
+void BuildTrampolineStencilX64(TrampolineStencil *stencil, TrampolineVariant variant) {
+    X64Assembler masm;
+    generatorJumpMethodX64(stencil, &masm, variant);
+    stencil->code.assign(masm.GetStartAddress(),
+                         masm.GetStartAddress() + masm.GetSizeOfCodeGenerated());
+}
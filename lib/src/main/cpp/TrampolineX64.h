@@ -0,0 +1,93 @@
+#ifndef PROFILER_TRAMPOLINEX64_H
+#define PROFILER_TRAMPOLINEX64_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "CpuFeatures.h"
+#include "TrampolineStencil.h"
+
+/**
+ * x86-64 (System V)下的寄存器现场, 与ARM版本的RegisterContext语义一致:
+ * 跳板把入口时的寄存器依次存到栈上, 把这块栈作为RegisterContext*传给hookMethod.
+ * 最后一个字段就是call压栈的返回地址, 对应ARM的lr.
+ */
+typedef struct _RegisterContextX64 {
+    union {
+        uint64_t r[15];
+        struct {
+            uint64_t rdi, rsi, rdx, rcx, r8, r9, rax, rbx, rbp, r10, r11, r12, r13, r14, r15;
+        } regs;
+    } general;
+
+    // xmm0 - xmm7 的低64位, 浮点参数在这里
+    uint64_t xmm[8];
+
+    uint64_t ret;
+} RegisterContextX64;
+
+/**
+ * 极简的x86-64编码器, 只覆盖跳板用到的几条指令
+ */
+class X64Assembler {
+public:
+    enum Register {
+        rax = 0, rcx, rdx, rbx, rsp, rbp, rsi, rdi,
+        r8, r9, r10, r11, r12, r13, r14, r15
+    };
+
+    void SubRsp(int32_t imm);
+
+    void AddRsp(int32_t imm);
+
+    // mov [rsp + disp], reg
+    void StoreToStack(Register reg, int32_t disp);
+
+    // movq [rsp + disp], xmm
+    void StoreXmmToStack(int xmm, int32_t disp);
+
+    // vmovq [rsp + disp], xmm, VEX编码
+    void VexStoreXmmToStack(int xmm, int32_t disp);
+
+    // mov dst, rsp
+    void MovFromRsp(Register dst);
+
+    // mov dst, [rip + disp32], 返回指令在代码中的偏移, 指令长度为kMovRipRelativeSize
+    static const size_t kMovRipRelativeSize = 7;
+
+    size_t MovRipRelative(Register dst, int32_t disp);
+
+    // call reg
+    void Call(Register target);
+
+    void Ret();
+
+    const uint8_t *GetStartAddress() const {
+        return buffer_.data();
+    }
+
+    size_t GetSizeOfCodeGenerated() const {
+        return buffer_.size();
+    }
+
+private:
+    void Emit8(uint8_t value) {
+        buffer_.push_back(value);
+    }
+
+    void Emit32(uint32_t value);
+
+    std::vector<uint8_t> buffer_;
+};
+
+/**
+ * 生成跳板模板: 保存寄存器现场后调用 handler(arg0, arg1, RegisterContextX64*, data),
+ * handler的返回值原样返回给调用方. data/handler从常量岛rip相对加载, 由InstantiateTrampoline修正偏移.
+ *
+ * @param variant kTrampolineX64Sse或kTrampolineX64Avx, 只影响保存xmm的指令编码
+ */
+void BuildTrampolineStencilX64(TrampolineStencil *stencil, TrampolineVariant variant);
+
+#endif //PROFILER_TRAMPOLINEX64_H
@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <sstream>
+#include <string>
+
+#include "ICacheBatch.h"
+#include "aarch32/disasm-aarch32.h"
+#include "aarch32/macro-assembler-aarch32.h"
+
+using namespace vixl;
+using namespace vixl::aarch32;
+
+// 原先Ding.cpp里的testVixl: 生成一段A32小函数, 反汇编, 在ARM上执行
+
+namespace {
+
+#define __ masm->
+
+void GenerateDemo(MacroAssembler *masm) {
+    __ Ldr(r1, 1);
+    __ Add(r0, r0, r1);
+    __ Bx(lr);
+}
+
+#undef __
+
+}  // namespace
+
+TEST(VixlDemo, AssemblesAndDisassembles) {
+    MacroAssembler masm(A32);
+    Label demo;
+    masm.Bind(&demo);
+    GenerateDemo(&masm);
+    masm.FinalizeCode();
+    ASSERT_GT(masm.GetSizeOfCodeGenerated(), 0u);
+
+    std::ostringstream out;
+    PrintDisassembler disassembler(out);
+    disassembler.DisassembleA32Buffer(masm.GetBuffer()->GetOffsetAddress<uint32_t *>(0),
+                                      masm.GetBuffer()->GetSizeInBytes());
+    std::string text = out.str();
+    EXPECT_NE(std::string::npos, text.find("ldr r1")) << text;
+    EXPECT_NE(std::string::npos, text.find("add r0, r1")) << text;
+    EXPECT_NE(std::string::npos, text.find("bx lr")) << text;
+
+#if defined(__arm__)
+    size_t size = masm.GetSizeOfCodeGenerated();
+    void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE | PROT_EXEC,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERT_NE(MAP_FAILED, memory);
+    memcpy(memory, masm.GetBuffer()->GetStartAddress<byte *>(), size);
+    ICacheBatch::Invalidate(memory, size);
+    uint32_t (*function)(uint32_t);
+    uintptr_t entry = reinterpret_cast<uintptr_t>(memory) + demo.GetLocation();
+    memcpy(&function, &entry, sizeof(function));
+    EXPECT_EQ(3u, function(2));
+    munmap(memory, size);
+#endif
+}
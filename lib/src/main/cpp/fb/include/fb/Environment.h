@@ -23,7 +23,9 @@ namespace internal {
 
 // Keeps a thread-local reference to the current thread's JNIEnv.
 struct Environment {
-  // May be null if this thread isn't attached to the JVM
+  // May be null if this thread isn't attached to the JVM. Inside a ThreadScope
+  // that knows the env (every registered native method has one), this is a
+  // single thread_local load.
   FBEXPORT static JNIEnv* current();
   static void initialize(JavaVM* vm);
 
@@ -81,8 +83,10 @@ class FBEXPORT ThreadScope {
   friend struct Environment;
   ThreadScope* previous_;
   // If the JNIEnv* is set, it is guaranteed to be valid at least through the
-  // lifetime of this ThreadScope. The only case where that guarantee can be
-  // made is when there is a java frame in the stack below this.
+  // lifetime of this ThreadScope. That guarantee can only be made when there
+  // is a java frame in the stack below this, or when this scope attached the
+  // thread itself. The innermost scope's env_ is mirrored in a thread_local
+  // for Environment::current().
   JNIEnv* env_;
   bool attachedWithThisScope_;
 };
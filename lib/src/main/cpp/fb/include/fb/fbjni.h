@@ -19,6 +19,7 @@
 #include <fb/fbjni/References.h>
 #include <fb/fbjni/Meta.h>
 #include <fb/fbjni/CoreClasses.h>
+#include <fb/fbjni/IdCache.h>
 #include <fb/fbjni/Iterator.h>
 #include <fb/fbjni/Hybrid.h>
 #include <fb/fbjni/Registration.h>
@@ -39,7 +39,12 @@ class JObject;
 /// The most common use case for this is storing the result
 /// in a "static auto" variable, or a static global.
 ///
-/// @return Returns a leaked global reference to the class
+/// The reference is a weak global reference owned by IdCache, so every lookup
+/// of the same name shares it, and later lookups do not call FindClass again.
+/// It stays valid for as long as the class is loaded. Only once the cache is
+/// full does each lookup leak a global reference of its own.
+///
+/// @return Returns a reference to the class that outlives the local frame
 FBEXPORT alias_ref<JClass> findClassStatic(const char* name);
 
 /// Lookup a class by name. Note this functions returns a local reference,
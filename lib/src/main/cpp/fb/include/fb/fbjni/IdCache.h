@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2015-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+#include <jni.h>
+
+#include <fb/visibility.h>
+
+namespace facebook {
+namespace jni {
+
+/// Process-wide cache of class references and member IDs.
+///
+/// Entries are keyed by a 64-bit hash of the descriptor strings, which the
+/// FBJNI_CACHED_* macros compute at compile time. An entry is resolved through
+/// JNI the first time it is asked for and is read without taking a lock after
+/// that. The descriptors are still compared on every hit, so a hash collision
+/// can never return the wrong ID.
+///
+/// Cached classes are held through weak global references, so caching a class
+/// doesn't keep it from being unloaded. A lookup that finds its class
+/// collected drops the class and every member of it, and resolves them again.
+/// Like any jclass, a returned class is only usable while it stays loaded.
+///
+/// The table has a fixed size. Once it is full, new descriptors are resolved
+/// through JNI on every lookup, and getClass() returns a local reference.
+///
+/// Lookups that fail return nullptr and leave the Java exception pending, like
+/// the JNI functions they replace, so they are safe to use from code that
+/// must not throw C++ exceptions.
+class FBEXPORT IdCache {
+ public:
+  enum class Kind : uint8_t {
+    Class = 1,
+    Method,
+    StaticMethod,
+    Field,
+    StaticField,
+  };
+
+  /// The cache key for a descriptor. Classes use empty name and signature.
+  static constexpr uint64_t key(Kind kind, const char* cls, const char* name, const char* sig) {
+    return finish(mix(sig, mix(name, mix(cls, (kOffset ^ static_cast<uint8_t>(kind)) * kPrime))));
+  }
+
+  /// Same as key(), for descriptors that are only known at runtime.
+  static uint64_t runtimeKey(Kind kind, const char* cls, const char* name, const char* sig);
+
+  /// @return A weak global reference owned by the cache, or a local reference
+  ///         owned by the caller's frame if the cache is full
+  static jclass getClass(JNIEnv* env, const char* cls, uint64_t key);
+
+  /// @param kind Kind::Method or Kind::StaticMethod
+  static jmethodID getMethod(
+      JNIEnv* env, Kind kind, const char* cls, const char* name, const char* sig, uint64_t key);
+
+  /// @param kind Kind::Field or Kind::StaticField
+  static jfieldID getField(
+      JNIEnv* env, Kind kind, const char* cls, const char* name, const char* sig, uint64_t key);
+
+  /// Drops the class and every member of it, and frees their slots for reuse.
+  /// Later lookups resolve them again. Collected classes are dropped without
+  /// this, so it is only needed to force a new FindClass.
+  static void forgetClass(JNIEnv* env, const char* cls);
+
+  /// Drops everything. Only for JNI_OnUnload, when no other thread can be
+  /// reading the cache.
+  static void clear(JNIEnv* env);
+
+ private:
+  static constexpr uint64_t kOffset = 14695981039346656037ull;
+  static constexpr uint64_t kPrime = 1099511628211ull;
+
+  // FNV-1a. The terminator is mixed in too, so ("ab", "c") and ("a", "bc")
+  // hash differently.
+  static constexpr uint64_t mix(const char* s, uint64_t hash) {
+    return *s == '\0' ? (hash ^ 0xff) * kPrime
+                      : mix(s + 1, (hash ^ static_cast<uint8_t>(*s)) * kPrime);
+  }
+
+  // 0 marks an empty slot and 1 a forgotten one.
+  static constexpr uint64_t finish(uint64_t hash) {
+    return hash < 2 ? hash + 2 : hash;
+  }
+};
+
+}}
+
+#define FBJNI_CACHED_KEY(kind, cls, name, sig)                                      \
+  (std::integral_constant<uint64_t, ::facebook::jni::IdCache::key(                  \
+      ::facebook::jni::IdCache::Kind::kind, cls, name, sig)>::value)
+
+/// jclass for a class name literal, e.g. "java/lang/Thread".
+#define FBJNI_CACHED_CLASS(env, cls)                                                \
+  ::facebook::jni::IdCache::getClass(env, cls, FBJNI_CACHED_KEY(Class, cls, "", ""))
+
+#define FBJNI_CACHED_METHOD(env, cls, name, sig)                                    \
+  ::facebook::jni::IdCache::getMethod(env, ::facebook::jni::IdCache::Kind::Method,  \
+      cls, name, sig, FBJNI_CACHED_KEY(Method, cls, name, sig))
+
+#define FBJNI_CACHED_STATIC_METHOD(env, cls, name, sig)                             \
+  ::facebook::jni::IdCache::getMethod(env,                                          \
+      ::facebook::jni::IdCache::Kind::StaticMethod, cls, name, sig,                 \
+      FBJNI_CACHED_KEY(StaticMethod, cls, name, sig))
+
+#define FBJNI_CACHED_FIELD(env, cls, name, sig)                                     \
+  ::facebook::jni::IdCache::getField(env, ::facebook::jni::IdCache::Kind::Field,    \
+      cls, name, sig, FBJNI_CACHED_KEY(Field, cls, name, sig))
+
+#define FBJNI_CACHED_STATIC_FIELD(env, cls, name, sig)                              \
+  ::facebook::jni::IdCache::getField(env,                                           \
+      ::facebook::jni::IdCache::Kind::StaticField, cls, name, sig,                  \
+      FBJNI_CACHED_KEY(StaticField, cls, name, sig))
@@ -21,12 +21,13 @@ class FBEXPORT StackTraceElement {
   StackTraceElement(InstructionPointer absoluteProgramCounter,
                     InstructionPointer libraryBase,
                     InstructionPointer functionAddress, std::string libraryName,
-                    std::string functionName)
+                    std::string functionName, std::string buildId = "")
       : absoluteProgramCounter_{absoluteProgramCounter},
         libraryBase_{libraryBase},
         functionAddress_{functionAddress},
         libraryName_{std::move(libraryName)},
-        functionName_{std::move(functionName)} {}
+        functionName_{std::move(functionName)},
+        buildId_{std::move(buildId)} {}
 
   InstructionPointer libraryBase() const noexcept { return libraryBase_; }
 
@@ -42,6 +43,12 @@ class FBEXPORT StackTraceElement {
 
   const std::string& functionName() const noexcept { return functionName_; }
 
+  /**
+   * The GNU build id of the library as a hex string, or empty if the library
+   * doesn't have one
+   */
+  const std::string& buildId() const noexcept { return buildId_; }
+
   /**
    * The offset of the program counter to the base of the library (i.e. the
    * address that addr2line takes as input>
@@ -69,6 +76,7 @@ class FBEXPORT StackTraceElement {
   const InstructionPointer functionAddress_;
   const std::string libraryName_;
   const std::string functionName_;
+  const std::string buildId_;
 };
 
 /**
@@ -90,6 +98,76 @@ class FBEXPORT StackTraceElement {
 FBEXPORT void getStackTrace(std::vector<InstructionPointer>& stackTrace,
                             size_t skip = 0);
 
+/**
+ * Populate the array with the current stack trace, walking the frame pointer
+ * chain first
+ *
+ * The frame pointer walk is only used while the chain is intact. If it breaks
+ * (e.g. at a frame compiled without frame pointers) before the limit is
+ * reached, the trace is captured again with the EH unwinder. The first
+ * capture on each thread also looks up the thread's stack bounds. This is
+ * therefore not async-signal-safe; see getStackTraceFramePointers().
+ *
+ * @param frames The array that receives the stack trace, innermost frame
+ * first
+ *
+ * @param limit The size of the array
+ *
+ * @param skip The number of frames to skip before capturing the trace
+ *
+ * @return The number of frames written
+ */
+FBEXPORT size_t getStackTrace(InstructionPointer* frames, size_t limit,
+                              size_t skip = 0);
+
+/**
+ * The end (highest address) of the current thread's stack, or nullptr if it
+ * cannot be determined
+ *
+ * Not async-signal-safe. Look it up once per thread, outside of the signal
+ * handler, and pass it to getStackTraceFramePointers(). This also records
+ * where the thread's stack starts, which lets the walk tell when it runs on a
+ * signal stack.
+ */
+FBEXPORT const void* getStackEnd() noexcept;
+
+/**
+ * Populate the array with the current stack trace by walking the frame
+ * pointer chain only
+ *
+ * This is async-signal-safe and does not allocate, so it can be called from
+ * a sampling signal handler or on every call of a hot hook. Only frame records
+ * between the current frame and stackEnd are read. The walk stops at the
+ * outermost frame or at the first frame record that doesn't look valid, which
+ * is where code without frame pointers breaks the chain.
+ *
+ * In a handler running on an alternate signal stack (SA_ONSTACK), only the
+ * frames on that stack are captured, and the chain is reported as broken:
+ * the frames of the interrupted code are not walked, because where their
+ * stack starts is not known there. A thread running on any other stack
+ * captures nothing once getStackEnd() has been called on it.
+ *
+ * @param frames The array that receives the stack trace, innermost frame
+ * first
+ *
+ * @param limit The size of the array
+ *
+ * @param stackEnd The value of getStackEnd() for this thread. nullptr captures
+ * nothing.
+ *
+ * @param skip The number of frames to skip before capturing the trace
+ *
+ * @param broken If not null, set to whether the walk stopped at a broken
+ * chain before reaching the outermost frame or the limit
+ *
+ * @return The number of frames written
+ */
+FBEXPORT size_t getStackTraceFramePointers(InstructionPointer* frames,
+                                           size_t limit,
+                                           const void* stackEnd,
+                                           size_t skip = 0,
+                                           bool* broken = nullptr) noexcept;
+
 /**
  * Creates a vector and populates it with the current stack trace
  *
@@ -116,6 +194,9 @@ FBEXPORT inline std::vector<InstructionPointer> getStackTrace(
 /**
  * Symbolicates a stack trace into a given vector
  *
+ * Uses the process-wide Symbolizer (see lyra_symbolizer.h). Frames outside of
+ * any loaded library are dropped.
+ *
  * @param symbols The vector to receive the output. The vector is cleared and
  * enough room to keep the frames are reserved.
  *
@@ -0,0 +1,106 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <fb/lyra.h>
+#include <fb/visibility.h>
+
+namespace facebook {
+namespace lyra {
+
+/**
+ * Resolves program counters to library, function and build id
+ *
+ * Each library is read once, the first time one of its addresses is seen: its
+ * address range and build id come from the loaded image, and its function
+ * symbols from the .symtab of the file on disk, or from the loaded .dynsym
+ * when there is no readable file (e.g. libraries mapped straight from an
+ * APK). Resolved addresses are kept in an LRU cache, so the frames that
+ * recur in most traces are looked up once.
+ *
+ * Libraries are remembered until reset(). Call it after a library has been
+ * unloaded, or its old symbols may be reported for whatever is mapped at the
+ * same address.
+ *
+ * All methods are thread-safe.
+ */
+class FBEXPORT Symbolizer {
+ public:
+  static constexpr size_t kDefaultCacheCapacity = 4096;
+
+  struct Stats {
+    size_t lookups;
+    size_t cacheHits;
+    size_t modules;
+    size_t symbols;  // function symbols across all modules
+  };
+
+  explicit Symbolizer(size_t cacheCapacity = kDefaultCacheCapacity);
+  ~Symbolizer();
+
+  Symbolizer(const Symbolizer&) = delete;
+  Symbolizer& operator=(const Symbolizer&) = delete;
+
+  /**
+   * The instance used by getStackTraceSymbols()
+   */
+  static Symbolizer& get();
+
+  /**
+   * Symbolicates one trace, like getStackTraceSymbols()
+   */
+  void symbolize(std::vector<StackTraceElement>& symbols,
+                 const std::vector<InstructionPointer>& trace);
+
+  /**
+   * Symbolicates many traces at once. Every distinct address is resolved once
+   * for the whole batch, under a single lock.
+   *
+   * @param symbols Receives one vector per trace, in the same order
+   */
+  void symbolize(std::vector<std::vector<StackTraceElement>>& symbols,
+                 const std::vector<std::vector<InstructionPointer>>& traces);
+
+  /**
+   * Forgets all libraries and cached addresses
+   */
+  void reset();
+
+  Stats stats();
+
+ private:
+  struct Module;
+
+  struct Resolved {
+    const Module* module;
+    uintptr_t functionAddress;
+    const char* functionName;
+  };
+
+  using LruList = std::list<std::pair<uintptr_t, Resolved>>;
+
+  // The caller holds lock_.
+  Resolved resolve(uintptr_t address);
+  const Module* findModule(uintptr_t address);
+  void append(std::vector<StackTraceElement>& symbols,
+              InstructionPointer address, const Resolved& resolved);
+
+  std::mutex lock_;
+  const size_t cacheCapacity_;
+  // Sorted by start address.
+  std::vector<std::unique_ptr<Module>> modules_;
+  LruList lru_;
+  std::unordered_map<uintptr_t, LruList::iterator> cache_;
+  Stats stats_;
+};
+
+}
+}
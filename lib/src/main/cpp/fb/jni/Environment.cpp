@@ -8,7 +8,6 @@
  */
 
 #include <fb/log.h>
-#include <fb/ThreadLocal.h>
 #include <fb/Environment.h>
 #include <fb/fbjni/CoreClasses.h>
 #include <fb/fbjni/NativeRunnable.h>
@@ -20,14 +19,17 @@ namespace jni {
 
 namespace {
 
-ThreadLocal<ThreadScope>& scopeStorage() {
-  // We don't want the ThreadLocal to delete the ThreadScopes.
-  static ThreadLocal<ThreadScope> scope([] (void*) {});
-  return scope;
-}
+// The innermost ThreadScope on this thread's stack. ThreadScopes live on the
+// stack, so nothing needs to be deleted when the thread exits.
+thread_local ThreadScope* g_scope = nullptr;
+
+// Always g_scope->env_, or null without a scope, so that the hot path in
+// current() is a single TLS load. Only ThreadScope writes it, and a scope only
+// records an env that stays valid until the scope is destroyed.
+thread_local JNIEnv* g_env = nullptr;
 
 ThreadScope* currentScope() {
-  return scopeStorage().get();
+  return g_scope;
 }
 
 JavaVM* g_vm = nullptr;
@@ -63,12 +65,12 @@ void Environment::initialize(JavaVM* vm) {
 
 /* static */
 JNIEnv* Environment::current() {
-  auto scope = currentScope();
-  if (scope && scope->env_) {
-    return scope->env_;
+  JNIEnv* env = g_env;
+  if (env) {
+    return env;
   }
 
-  JNIEnv* env;
+  auto scope = currentScope();
   if (getEnv(&env) != JNI_OK) {
     // If there's a ThreadScope in the stack, we should be attached and able to
     // retrieve a JNIEnv*.
@@ -90,12 +92,12 @@ void Environment::detachCurrentThread() {
 
 /* static */
 JNIEnv* Environment::ensureCurrentThreadIsAttached() {
-  auto scope = currentScope();
-  if (scope && scope->env_) {
-    return scope->env_;
+  JNIEnv* env = g_env;
+  if (env) {
+    return env;
   }
 
-  JNIEnv* env;
+  auto scope = currentScope();
   // We should be able to just get the JNIEnv* by just calling
   // AttachCurrentThread, but the spec is unclear (and using getEnv is probably
   // generally more reliable).
@@ -115,9 +117,8 @@ ThreadScope::ThreadScope() : ThreadScope(nullptr, internal::CacheEnvTag{}) {}
 
 ThreadScope::ThreadScope(JNIEnv* env, internal::CacheEnvTag)
     : previous_(nullptr), env_(nullptr), attachedWithThisScope_(false) {
-  auto& storage = scopeStorage();
-  previous_ = storage.get();
-  storage.reset(this);
+  previous_ = g_scope;
+  g_scope = this;
 
   if (previous_ && previous_->env_) {
     FBASSERT(!env || env == previous_->env_);
@@ -125,6 +126,7 @@ ThreadScope::ThreadScope(JNIEnv* env, internal::CacheEnvTag)
   }
 
   env_ = env;
+  g_env = env;
   if (env_) {
     return;
   }
@@ -140,16 +142,18 @@ ThreadScope::ThreadScope(JNIEnv* env, internal::CacheEnvTag)
 
   // If there's already a ThreadScope on the stack, then the thread should be attached.
   FBASSERT(!previous_);
-  attachCurrentThread();
+  // The env stays valid until this scope detaches the thread again.
+  env_ = attachCurrentThread();
+  g_env = env_;
   attachedWithThisScope_ = true;
 }
 
 ThreadScope::~ThreadScope() {
-  auto& storage = scopeStorage();
   // ThreadScopes should be destroyed in the reverse order they are created
   // (that is, just put them on the stack).
-  FBASSERT(this == storage.get());
-  storage.reset(previous_);
+  FBASSERT(this == g_scope);
+  g_scope = previous_;
+  g_env = previous_ ? previous_->env_ : nullptr;
   if (attachedWithThisScope_) {
     Environment::detachCurrentThread();
   }
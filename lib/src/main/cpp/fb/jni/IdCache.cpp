@@ -0,0 +1,349 @@
+/*
+ * Copyright (c) 2015-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include <fb/fbjni/IdCache.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <mutex>
+#include <vector>
+
+namespace facebook {
+namespace jni {
+
+constexpr uint64_t IdCache::kOffset;
+constexpr uint64_t IdCache::kPrime;
+
+namespace {
+
+constexpr uint64_t kEmpty = 0;
+constexpr uint64_t kForgotten = 1;
+
+// Power of two. At most kMaxOccupied slots are ever non-empty, so every probe
+// chain ends at an empty slot and a miss never walks the whole table. Once
+// that many are taken, new descriptors are resolved on every lookup instead
+// of being cached, until a forgotten slot can be reused.
+constexpr size_t kCapacity = 1024;
+constexpr size_t kMaxOccupied = kCapacity / 4 * 3;
+
+// The payload is written before |key| is published with release semantics.
+// A forgotten slot can be reused while a reader that loaded its old key is
+// still comparing descriptors, so the payload is atomic too, and the strings
+// and weak references it replaces are only freed by clear().
+struct Entry {
+  std::atomic<uint64_t> key;
+  std::atomic<IdCache::Kind> kind;
+  std::atomic<char*> cls;
+  std::atomic<char*> name;
+  std::atomic<char*> sig;
+  std::atomic<void*> value;
+  // The weak reference to the class the entry belongs to. Its members are
+  // only valid while it hasn't been collected.
+  std::atomic<jweak> owner;
+};
+
+Entry table[kCapacity];
+
+// Serializes writers. Readers never take it, and JNI calls that can run Java
+// code are never made while holding it, since resolving a class can call
+// back into the cache.
+std::mutex writeMutex;
+
+// Slots that are not kEmpty, forgotten ones included.
+size_t occupied;
+
+// What forgotten or replaced slots used to hold, freed by clear().
+std::vector<char*> retiredStrings;
+std::vector<jweak> retiredClasses;
+
+bool matches(const Entry& entry, IdCache::Kind kind, const char* cls,
+             const char* name, const char* sig) {
+  return entry.kind.load(std::memory_order_acquire) == kind &&
+      strcmp(entry.cls.load(std::memory_order_acquire), cls) == 0 &&
+      strcmp(entry.name.load(std::memory_order_acquire), name) == 0 &&
+      strcmp(entry.sig.load(std::memory_order_acquire), sig) == 0;
+}
+
+const Entry* lookup(uint64_t key, IdCache::Kind kind, const char* cls, const char* name,
+                    const char* sig) {
+  size_t index = key & (kCapacity - 1);
+  for (size_t probe = 0; probe < kCapacity; ++probe) {
+    const Entry& entry = table[index];
+    uint64_t current = entry.key.load(std::memory_order_acquire);
+    if (current == kEmpty) {
+      return nullptr;
+    }
+    if (current == key && matches(entry, kind, cls, name, sig)) {
+      return &entry;
+    }
+    index = (index + 1) & (kCapacity - 1);
+  }
+  return nullptr;
+}
+
+// The cached value, or nullptr if there is none or its class was collected.
+void* liveValue(JNIEnv* env, const Entry* entry) {
+  if (entry == nullptr) {
+    return nullptr;
+  }
+  if (env->IsSameObject(entry->owner.load(std::memory_order_acquire), nullptr)) {
+    return nullptr;
+  }
+  return entry->value.load(std::memory_order_acquire);
+}
+
+void retire(char* string) {
+  if (string != nullptr) {
+    retiredStrings.push_back(string);
+  }
+}
+
+// Leaves a string that already equals |value| alone, so a reader comparing
+// it sees no change.
+void assign(std::atomic<char*>& field, const char* value) {
+  char* current = field.load(std::memory_order_relaxed);
+  if (current != nullptr && strcmp(current, value) == 0) {
+    return;
+  }
+  retire(current);
+  field.store(strdup(value), std::memory_order_release);
+}
+
+// Marks every entry of |cls| forgotten. The caller holds writeMutex.
+void forgetLocked(const char* cls) {
+  for (Entry& entry : table) {
+    uint64_t current = entry.key.load(std::memory_order_relaxed);
+    if (current == kEmpty || current == kForgotten ||
+        strcmp(entry.cls.load(std::memory_order_relaxed), cls) != 0) {
+      continue;
+    }
+    // The slot stays in the probe chains of later entries until it is reused.
+    entry.key.store(kForgotten, std::memory_order_release);
+    if (entry.kind.load(std::memory_order_relaxed) == IdCache::Kind::Class) {
+      retiredClasses.push_back(static_cast<jweak>(entry.value.load(std::memory_order_relaxed)));
+    }
+  }
+}
+
+enum class Insert {
+  Added,
+  Existing,  // another thread cached the same descriptor first
+  Full,
+};
+
+// Returns the value that ends up cached, or |value| if the table is full.
+void* insert(uint64_t key, IdCache::Kind kind, const char* cls, const char* name,
+             const char* sig, void* value, jweak owner, Insert* result) {
+  std::lock_guard<std::mutex> lock(writeMutex);
+  Entry* forgotten = nullptr;
+  size_t index = key & (kCapacity - 1);
+  for (size_t probe = 0; probe < kCapacity; ++probe) {
+    Entry& entry = table[index];
+    uint64_t current = entry.key.load(std::memory_order_relaxed);
+    if (current == kEmpty) {
+      Entry* slot = forgotten;
+      if (slot == nullptr) {
+        if (occupied >= kMaxOccupied) {
+          break;
+        }
+        slot = &entry;
+        ++occupied;
+      }
+      slot->kind.store(kind, std::memory_order_release);
+      assign(slot->cls, cls);
+      assign(slot->name, name);
+      assign(slot->sig, sig);
+      slot->value.store(value, std::memory_order_release);
+      slot->owner.store(owner, std::memory_order_release);
+      slot->key.store(key, std::memory_order_release);
+      *result = Insert::Added;
+      return value;
+    }
+    if (current == kForgotten) {
+      if (forgotten == nullptr) {
+        forgotten = &entry;
+      }
+    } else if (current == key && matches(entry, kind, cls, name, sig)) {
+      *result = Insert::Existing;
+      return entry.value.load(std::memory_order_relaxed);
+    }
+    index = (index + 1) & (kCapacity - 1);
+  }
+  *result = Insert::Full;
+  return value;
+}
+
+// Whether insert() would find a slot for |key|. Only a hint, so that no
+// global reference is created for a class that can't be cached.
+bool hasRoom(uint64_t key) {
+  std::lock_guard<std::mutex> lock(writeMutex);
+  if (occupied < kMaxOccupied) {
+    return true;
+  }
+  size_t index = key & (kCapacity - 1);
+  for (size_t probe = 0; probe < kCapacity; ++probe) {
+    uint64_t current = table[index].key.load(std::memory_order_relaxed);
+    if (current == kEmpty) {
+      return false;
+    }
+    if (current == kForgotten) {
+      return true;
+    }
+    index = (index + 1) & (kCapacity - 1);
+  }
+  return false;
+}
+
+// Like IdCache::getClass(), but when the class can't be cached it is
+// returned as a local reference, and |*cached| is false.
+jclass resolveClass(JNIEnv* env, const char* cls, uint64_t key, bool* cached) {
+  *cached = true;
+  const Entry* entry = lookup(key, IdCache::Kind::Class, cls, "", "");
+  void* value = liveValue(env, entry);
+  if (value != nullptr) {
+    return static_cast<jclass>(value);
+  }
+  if (entry != nullptr) {
+    // The class was unloaded. Its member IDs went with it.
+    std::lock_guard<std::mutex> lock(writeMutex);
+    if (entry->key.load(std::memory_order_relaxed) == key) {
+      forgetLocked(cls);
+    }
+  }
+  jclass local = env->FindClass(cls);
+  if (local == nullptr) {
+    return nullptr;
+  }
+  if (!hasRoom(key)) {
+    *cached = false;
+    return local;
+  }
+  jweak weak = env->NewWeakGlobalRef(local);
+  if (weak == nullptr) {
+    env->DeleteLocalRef(local);
+    return nullptr;
+  }
+  Insert result;
+  value = insert(key, IdCache::Kind::Class, cls, "", "", weak, weak, &result);
+  if (result != Insert::Added) {
+    env->DeleteWeakGlobalRef(weak);
+  }
+  if (result == Insert::Full) {
+    *cached = false;
+    return local;
+  }
+  env->DeleteLocalRef(local);
+  return static_cast<jclass>(value);
+}
+
+void* resolveMember(JNIEnv* env, IdCache::Kind kind, jclass clazz, const char* name,
+                    const char* sig) {
+  switch (kind) {
+    case IdCache::Kind::Method:
+      return env->GetMethodID(clazz, name, sig);
+    case IdCache::Kind::StaticMethod:
+      return env->GetStaticMethodID(clazz, name, sig);
+    case IdCache::Kind::Field:
+      return env->GetFieldID(clazz, name, sig);
+    case IdCache::Kind::StaticField:
+      return env->GetStaticFieldID(clazz, name, sig);
+    case IdCache::Kind::Class:
+      break;
+  }
+  return nullptr;
+}
+
+void* getMember(JNIEnv* env, IdCache::Kind kind, const char* cls, const char* name,
+                const char* sig, uint64_t key) {
+  void* value = liveValue(env, lookup(key, kind, cls, name, sig));
+  if (value != nullptr) {
+    return value;
+  }
+  // Also drops the stale members if the class was collected.
+  bool cached;
+  jclass clazz = resolveClass(
+      env, cls, IdCache::runtimeKey(IdCache::Kind::Class, cls, "", ""), &cached);
+  if (clazz == nullptr) {
+    return nullptr;
+  }
+  value = resolveMember(env, kind, clazz, name, sig);
+  if (!cached) {
+    // Without a weak reference there is nothing to tell when the ID dies.
+    env->DeleteLocalRef(clazz);
+    return value;
+  }
+  if (value == nullptr) {
+    return nullptr;
+  }
+  Insert result;
+  return insert(key, kind, cls, name, sig, value, static_cast<jweak>(clazz), &result);
+}
+
+}
+
+uint64_t IdCache::runtimeKey(Kind kind, const char* cls, const char* name, const char* sig) {
+  uint64_t hash = (kOffset ^ static_cast<uint8_t>(kind)) * kPrime;
+  for (const char* s : {cls, name, sig}) {
+    for (; *s != '\0'; ++s) {
+      hash = (hash ^ static_cast<uint8_t>(*s)) * kPrime;
+    }
+    hash = (hash ^ 0xff) * kPrime;
+  }
+  return finish(hash);
+}
+
+jclass IdCache::getClass(JNIEnv* env, const char* cls, uint64_t key) {
+  bool cached;
+  return resolveClass(env, cls, key, &cached);
+}
+
+jmethodID IdCache::getMethod(
+    JNIEnv* env, Kind kind, const char* cls, const char* name, const char* sig, uint64_t key) {
+  return static_cast<jmethodID>(getMember(env, kind, cls, name, sig, key));
+}
+
+jfieldID IdCache::getField(
+    JNIEnv* env, Kind kind, const char* cls, const char* name, const char* sig, uint64_t key) {
+  return static_cast<jfieldID>(getMember(env, kind, cls, name, sig, key));
+}
+
+void IdCache::forgetClass(JNIEnv*, const char* cls) {
+  std::lock_guard<std::mutex> lock(writeMutex);
+  forgetLocked(cls);
+}
+
+void IdCache::clear(JNIEnv* env) {
+  std::lock_guard<std::mutex> lock(writeMutex);
+  for (Entry& entry : table) {
+    uint64_t current = entry.key.load(std::memory_order_relaxed);
+    if (current == kEmpty) {
+      continue;
+    }
+    if (current != kForgotten && entry.kind.load(std::memory_order_relaxed) == Kind::Class) {
+      env->DeleteWeakGlobalRef(static_cast<jweak>(entry.value.load(std::memory_order_relaxed)));
+    }
+    free(entry.cls.exchange(nullptr, std::memory_order_relaxed));
+    free(entry.name.exchange(nullptr, std::memory_order_relaxed));
+    free(entry.sig.exchange(nullptr, std::memory_order_relaxed));
+    entry.key.store(kEmpty, std::memory_order_relaxed);
+  }
+  for (jweak weak : retiredClasses) {
+    env->DeleteWeakGlobalRef(weak);
+  }
+  retiredClasses.clear();
+  for (char* string : retiredStrings) {
+    free(string);
+  }
+  retiredStrings.clear();
+  occupied = 0;
+}
+
+}}
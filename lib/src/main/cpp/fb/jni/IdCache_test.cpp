@@ -0,0 +1,323 @@
+/*
+ * Copyright (c) 2015-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include <fb/fbjni/IdCache.h>
+
+#include <gtest/gtest.h>
+
+#include <stddef.h>
+#include <string.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace facebook::jni;
+
+namespace {
+
+// A loaded class. Reloading a collected class makes a new one.
+struct FakeClass {
+  std::string name;
+  bool collected = false;
+};
+
+struct FakeRef : _jobject {
+  jobjectRefType type;
+  FakeClass* target;
+  bool deleted = false;
+};
+
+// Implements just the JNI functions IdCache calls, and counts them.
+struct FakeEnv {
+  JNINativeInterface functions;
+  JNIEnv env;
+  std::vector<std::unique_ptr<FakeClass>> classes;
+  std::vector<std::unique_ptr<FakeRef>> refs;
+  int finds = 0;
+  int memberLookups = 0;
+  int liveLocals = 0;
+  int liveWeaks = 0;
+  uintptr_t nextId = 0x1000;
+
+  FakeEnv() {
+    memset(&functions, 0, sizeof(functions));
+    functions.FindClass = FindClass;
+    functions.DeleteLocalRef = DeleteLocalRef;
+    functions.IsSameObject = IsSameObject;
+    functions.NewWeakGlobalRef = NewWeakGlobalRef;
+    functions.DeleteWeakGlobalRef = DeleteWeakGlobalRef;
+    functions.GetObjectRefType = GetObjectRefType;
+    functions.GetMethodID = GetMethodID;
+    functions.GetStaticMethodID = GetMethodID;
+    functions.GetFieldID = GetFieldID;
+    functions.GetStaticFieldID = GetFieldID;
+    env.functions = &functions;
+  }
+
+  ~FakeEnv() {
+    IdCache::clear(&env);
+  }
+
+  static FakeEnv* from(JNIEnv* env) {
+    return reinterpret_cast<FakeEnv*>(
+        reinterpret_cast<char*>(env) - offsetof(FakeEnv, env));
+  }
+
+  FakeRef* newRef(jobjectRefType type, FakeClass* target) {
+    refs.emplace_back(new FakeRef());
+    FakeRef* ref = refs.back().get();
+    ref->type = type;
+    ref->target = target;
+    ++(type == JNILocalRefType ? liveLocals : liveWeaks);
+    return ref;
+  }
+
+  FakeClass* loaded(const char* name) {
+    for (auto& cls : classes) {
+      if (cls->name == name && !cls->collected) {
+        return cls.get();
+      }
+    }
+    return nullptr;
+  }
+
+  static FakeClass* targetOf(jobject obj) {
+    auto ref = static_cast<FakeRef*>(obj);
+    if (ref == nullptr || ref->target->collected) {
+      return nullptr;
+    }
+    return ref->target;
+  }
+
+  static jclass FindClass(JNIEnv* env, const char* name) {
+    FakeEnv* fake = from(env);
+    ++fake->finds;
+    FakeClass* cls = fake->loaded(name);
+    if (cls == nullptr) {
+      fake->classes.emplace_back(new FakeClass());
+      cls = fake->classes.back().get();
+      cls->name = name;
+    }
+    return fake->newRef(JNILocalRefType, cls);
+  }
+
+  static void release(JNIEnv* env, jobject obj, jobjectRefType type) {
+    auto ref = static_cast<FakeRef*>(obj);
+    EXPECT_EQ(ref->type, type);
+    EXPECT_FALSE(ref->deleted);
+    ref->deleted = true;
+    --(type == JNILocalRefType ? from(env)->liveLocals : from(env)->liveWeaks);
+  }
+
+  static void DeleteLocalRef(JNIEnv* env, jobject obj) {
+    release(env, obj, JNILocalRefType);
+  }
+
+  static void DeleteWeakGlobalRef(JNIEnv* env, jweak obj) {
+    release(env, obj, JNIWeakGlobalRefType);
+  }
+
+  static jweak NewWeakGlobalRef(JNIEnv* env, jobject obj) {
+    return from(env)->newRef(JNIWeakGlobalRefType, static_cast<FakeRef*>(obj)->target);
+  }
+
+  static jboolean IsSameObject(JNIEnv*, jobject a, jobject b) {
+    return targetOf(a) == targetOf(b);
+  }
+
+  static jobjectRefType GetObjectRefType(JNIEnv*, jobject obj) {
+    return static_cast<FakeRef*>(obj)->type;
+  }
+
+  static jmethodID GetMethodID(JNIEnv* env, jclass, const char*, const char*) {
+    FakeEnv* fake = from(env);
+    ++fake->memberLookups;
+    return reinterpret_cast<jmethodID>(fake->nextId++);
+  }
+
+  static jfieldID GetFieldID(JNIEnv* env, jclass, const char*, const char*) {
+    FakeEnv* fake = from(env);
+    ++fake->memberLookups;
+    return reinterpret_cast<jfieldID>(fake->nextId++);
+  }
+};
+
+FakeClass* classOf(jclass cls) {
+  return static_cast<FakeRef*>(cls)->target;
+}
+
+jobjectRefType typeOf(jclass cls) {
+  return static_cast<FakeRef*>(cls)->type;
+}
+
+// Keys land on slot |key % 1024|, so these fill the table's 768 usable slots
+// from slot 2 on.
+constexpr size_t kUsableSlots = 768;
+constexpr uint64_t kFirstKey = 2;
+
+std::string fillerName(size_t i) {
+  return "test/Filler" + std::to_string(i);
+}
+
+void fillTable(FakeEnv& fake) {
+  for (size_t i = 0; i < kUsableSlots; ++i) {
+    jclass cls = IdCache::getClass(&fake.env, fillerName(i).c_str(), kFirstKey + i);
+    ASSERT_EQ(typeOf(cls), JNIWeakGlobalRefType);
+  }
+}
+
+}  // namespace
+
+TEST(IdCacheTest, HitSkipsJni) {
+  FakeEnv fake;
+  JNIEnv* env = &fake.env;
+
+  jclass cls = FBJNI_CACHED_CLASS(env, "test/Hit");
+  jmethodID method = FBJNI_CACHED_METHOD(env, "test/Hit", "run", "()V");
+  jfieldID field = FBJNI_CACHED_STATIC_FIELD(env, "test/Hit", "count", "I");
+  ASSERT_NE(cls, nullptr);
+  EXPECT_EQ(typeOf(cls), JNIWeakGlobalRefType);
+  EXPECT_EQ(fake.finds, 1);
+  EXPECT_EQ(fake.memberLookups, 2);
+
+  EXPECT_EQ(FBJNI_CACHED_CLASS(env, "test/Hit"), cls);
+  EXPECT_EQ(FBJNI_CACHED_METHOD(env, "test/Hit", "run", "()V"), method);
+  EXPECT_EQ(FBJNI_CACHED_STATIC_FIELD(env, "test/Hit", "count", "I"), field);
+  EXPECT_EQ(fake.finds, 1);
+  EXPECT_EQ(fake.memberLookups, 2);
+  EXPECT_EQ(fake.liveLocals, 0);
+  EXPECT_EQ(fake.liveWeaks, 1);
+}
+
+TEST(IdCacheTest, RuntimeKeyMatchesCompileTimeKey) {
+  EXPECT_EQ(IdCache::runtimeKey(IdCache::Kind::Method, "a/B", "c", "()V"),
+            FBJNI_CACHED_KEY(Method, "a/B", "c", "()V"));
+  EXPECT_NE(IdCache::runtimeKey(IdCache::Kind::Method, "ab", "c", ""),
+            IdCache::runtimeKey(IdCache::Kind::Method, "a", "bc", ""));
+}
+
+TEST(IdCacheTest, CollidingKeysKeepTheirOwnEntries) {
+  FakeEnv fake;
+  JNIEnv* env = &fake.env;
+  const uint64_t key = 12345;
+
+  jclass first = IdCache::getClass(env, "test/First", key);
+  jclass second = IdCache::getClass(env, "test/Second", key);
+  EXPECT_EQ(classOf(first)->name, "test/First");
+  EXPECT_EQ(classOf(second)->name, "test/Second");
+  EXPECT_EQ(fake.finds, 2);
+
+  EXPECT_EQ(IdCache::getClass(env, "test/First", key), first);
+  EXPECT_EQ(IdCache::getClass(env, "test/Second", key), second);
+  EXPECT_EQ(fake.finds, 2);
+}
+
+TEST(IdCacheTest, FullTableFallsBackToLocalReferences) {
+  FakeEnv fake;
+  JNIEnv* env = &fake.env;
+  fillTable(fake);
+  int weaks = fake.liveWeaks;
+  int finds = fake.finds;
+
+  jclass cls = IdCache::getClass(env, "test/Overflow", 5000);
+  EXPECT_EQ(typeOf(cls), JNILocalRefType);
+  EXPECT_EQ(classOf(cls)->name, "test/Overflow");
+  // No weak reference is made for a class that can't be cached.
+  EXPECT_EQ(fake.liveWeaks, weaks);
+  fake.DeleteLocalRef(env, cls);
+
+  cls = IdCache::getClass(env, "test/Overflow", 5000);
+  EXPECT_EQ(typeOf(cls), JNILocalRefType);
+  EXPECT_EQ(fake.finds, finds + 2);
+  fake.DeleteLocalRef(env, cls);
+
+  // Members of an uncached class are resolved every time, without leaking the
+  // class.
+  EXPECT_NE(FBJNI_CACHED_METHOD(env, "test/Overflow", "run", "()V"), nullptr);
+  EXPECT_NE(FBJNI_CACHED_METHOD(env, "test/Overflow", "run", "()V"), nullptr);
+  EXPECT_EQ(fake.memberLookups, 2);
+  EXPECT_EQ(fake.liveLocals, 0);
+
+  // Cached entries still hit.
+  EXPECT_EQ(typeOf(IdCache::getClass(env, fillerName(0).c_str(), kFirstKey)),
+            JNIWeakGlobalRefType);
+  EXPECT_EQ(fake.finds, finds + 4);
+}
+
+TEST(IdCacheTest, ForgottenSlotsAreReused) {
+  FakeEnv fake;
+  JNIEnv* env = &fake.env;
+  fillTable(fake);
+  const size_t forgotten = 100;
+  IdCache::forgetClass(env, fillerName(forgotten).c_str());
+
+  // Probes from the forgotten slot's own index, so it hits that slot first.
+  const uint64_t key = kFirstKey + forgotten + 1024;
+  jclass cls = IdCache::getClass(env, "test/Reuse", key);
+  EXPECT_EQ(typeOf(cls), JNIWeakGlobalRefType);
+  int finds = fake.finds;
+  EXPECT_EQ(IdCache::getClass(env, "test/Reuse", key), cls);
+  EXPECT_EQ(fake.finds, finds);
+
+  // Entries past the reused slot on the same chain are still found.
+  EXPECT_EQ(typeOf(IdCache::getClass(env, fillerName(forgotten + 1).c_str(),
+                                     kFirstKey + forgotten + 1)),
+            JNIWeakGlobalRefType);
+  EXPECT_EQ(fake.finds, finds);
+
+  // The forgotten class is resolved again, and there is no room left for it.
+  cls = IdCache::getClass(env, fillerName(forgotten).c_str(), kFirstKey + forgotten);
+  EXPECT_EQ(typeOf(cls), JNILocalRefType);
+  EXPECT_EQ(fake.finds, finds + 1);
+  fake.DeleteLocalRef(env, cls);
+}
+
+TEST(IdCacheTest, CollectedClassIsResolvedAgain) {
+  FakeEnv fake;
+  JNIEnv* env = &fake.env;
+
+  jclass cls = FBJNI_CACHED_CLASS(env, "test/Unloaded");
+  jmethodID method = FBJNI_CACHED_METHOD(env, "test/Unloaded", "run", "()V");
+  classOf(cls)->collected = true;
+
+  jmethodID reloaded = FBJNI_CACHED_METHOD(env, "test/Unloaded", "run", "()V");
+  EXPECT_NE(reloaded, method);
+  EXPECT_EQ(fake.finds, 2);
+  EXPECT_EQ(fake.memberLookups, 2);
+
+  jclass again = FBJNI_CACHED_CLASS(env, "test/Unloaded");
+  EXPECT_NE(again, cls);
+  EXPECT_FALSE(classOf(again)->collected);
+  EXPECT_EQ(FBJNI_CACHED_METHOD(env, "test/Unloaded", "run", "()V"), reloaded);
+  EXPECT_EQ(fake.finds, 2);
+  EXPECT_EQ(fake.liveLocals, 0);
+}
+
+TEST(IdCacheTest, ClearReleasesEverything) {
+  FakeEnv fake;
+  JNIEnv* env = &fake.env;
+
+  FBJNI_CACHED_METHOD(env, "test/Cleared", "run", "()V");
+  FBJNI_CACHED_CLASS(env, "test/Forgotten");
+  IdCache::forgetClass(env, "test/Forgotten");
+  FBJNI_CACHED_CLASS(env, "test/Forgotten");
+  EXPECT_EQ(fake.liveWeaks, 3);
+
+  IdCache::clear(env);
+  EXPECT_EQ(fake.liveWeaks, 0);
+
+  FBJNI_CACHED_METHOD(env, "test/Cleared", "run", "()V");
+  EXPECT_EQ(fake.finds, 4);
+  EXPECT_EQ(fake.memberLookups, 2);
+
+  // A cleared table has all its slots back.
+  IdCache::clear(env);
+  fillTable(fake);
+}
@@ -60,11 +60,16 @@ alias_ref<JClass> findClassStatic(const char* name) {
   if (!env) {
     throw std::runtime_error("Unable to retrieve JNIEnv*.");
   }
-  local_ref<jclass> cls = adopt_local(env->FindClass(name));
+  auto cls = IdCache::getClass(env, name, IdCache::runtimeKey(IdCache::Kind::Class, name, "", ""));
   FACEBOOK_JNI_THROW_EXCEPTION_IF(!cls);
-  auto leaking_ref = (jclass)env->NewGlobalRef(cls.get());
-  FACEBOOK_JNI_THROW_EXCEPTION_IF(!leaking_ref);
-  return wrap_alias(leaking_ref);
+  if (env->GetObjectRefType(cls) == JNILocalRefType) {
+    // The cache is full, so fall back to leaking a global reference.
+    auto local = cls;
+    cls = static_cast<jclass>(env->NewGlobalRef(local));
+    env->DeleteLocalRef(local);
+    FACEBOOK_JNI_THROW_EXCEPTION_IF(!cls);
+  }
+  return wrap_alias(cls);
 }
 
 local_ref<JClass> findClassLocal(const char* name) {
@@ -1,12 +1,15 @@
 // Copyright 2004-present Facebook. All Rights Reserved.
 
 #include <fb/lyra.h>
+#include <fb/lyra_symbolizer.h>
 
 #include <ios>
 #include <memory>
 #include <vector>
 
-#include <dlfcn.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
 #include <unwind.h>
 
 using namespace std;
@@ -31,9 +34,118 @@ class IosFlagsSaver {
   }
 };
 
+// The frame record that the function prologue pushes and the frame pointer
+// points at: {fp, lr} on arm (r7 in Thumb, r11 in ARM code) and aarch64,
+// {rbp, return address} on x86. Code built with frame pointers links them
+// into a chain from the innermost frame outwards.
+struct FrameRecord {
+  const FrameRecord* next;
+  InstructionPointer returnAddress;
+};
+
+// Return addresses into Thumb code have the low bit set, _Unwind_GetIP()
+// clears it.
+inline InstructionPointer normalizeProgramCounter(uintptr_t pc) {
+#if defined(__arm__)
+  pc &= ~static_cast<uintptr_t>(1);
+#endif
+  return reinterpret_cast<InstructionPointer>(pc);
+}
+
+// How close to the end of the stack the outermost frame record has to be for
+// a null link to be trusted. Thread entry points only have a few hundred bytes
+// above them. A null link further down the stack (e.g. on the main thread,
+// below its arguments and environment) is treated as a broken chain, which
+// costs a fallback but never truncates the trace there.
+constexpr uintptr_t kOutermostFrameSlack = 4 * 1024;
+
+// The start (lowest address) of the calling thread's stack, recorded by
+// getStackEnd(). 0 until then.
+thread_local uintptr_t threadStackStart = 0;
+
+// The end of the stack that |frame| is on. That is |stackEnd|, unless the
+// thread is running a signal handler on an alternate stack (SA_ONSTACK). Then
+// it is the end of that stack, and the walk stops where the handler's chain
+// leaves it, since nothing tells where the interrupted stack starts. Returns
+// 0 if |frame| is on neither stack.
+uintptr_t currentStackEnd(uintptr_t frame, uintptr_t stackEnd,
+                          bool* onSignalStack) noexcept {
+  *onSignalStack = false;
+  // The common case costs no system call.
+  if (threadStackStart != 0 && frame >= threadStackStart && frame < stackEnd) {
+    return stackEnd;
+  }
+  stack_t signalStack;
+  if (sigaltstack(nullptr, &signalStack) == 0 &&
+      (signalStack.ss_flags & SS_ONSTACK) != 0) {
+    *onSignalStack = true;
+    return reinterpret_cast<uintptr_t>(signalStack.ss_sp) +
+        signalStack.ss_size;
+  }
+  // Without the thread's stack start, trust stackEnd as before.
+  return threadStackStart == 0 ? stackEnd : 0;
+}
+
+// Only reads memory between |record| and |stackEnd|, so it is safe to run on
+// a chain that was broken by a frame using the frame pointer register for
+// something else.
+size_t walkFramePointers(const FrameRecord* record, uintptr_t stackEnd,
+                         InstructionPointer* frames, size_t limit, size_t skip,
+                         bool* broken) noexcept {
+  size_t count = 0;
+  *broken = false;
+  auto address = reinterpret_cast<uintptr_t>(record);
+  bool onSignalStack;
+  stackEnd = currentStackEnd(address, stackEnd, &onSignalStack);
+  if (stackEnd == 0) {
+    *broken = true;
+    return 0;
+  }
+  while (count < limit) {
+    if (address % alignof(FrameRecord) != 0 ||
+        address > stackEnd - sizeof(FrameRecord)) {
+      *broken = true;
+      break;
+    }
+    auto pc = reinterpret_cast<uintptr_t>(record->returnAddress);
+    auto next = reinterpret_cast<uintptr_t>(record->next);
+    if (pc != 0) {
+      if (skip > 0) {
+        --skip;
+      } else {
+        frames[count++] = normalizeProgramCounter(pc);
+      }
+    }
+    if (pc == 0 || next == 0) {
+      // A null link ends the chain at the outermost frame, but a caller
+      // without frame pointers may also just have zeroed the register.
+      *broken = stackEnd - address > kOutermostFrameSlack;
+      break;
+    }
+    // The stack grows down, so the chain must move strictly upwards or it
+    // could loop.
+    if (next <= address) {
+      *broken = true;
+      break;
+    }
+    address = next;
+    record = reinterpret_cast<const FrameRecord*>(next);
+  }
+  // A chain on a signal stack never reaches the outermost frame.
+  if (onSignalStack && count < limit) {
+    *broken = true;
+  }
+  return count;
+}
+
 struct BacktraceState {
+  // Frames up to and including this return address belong to lyra itself.
+  InstructionPointer start;
+  bool started;
   size_t skip;
-  vector<InstructionPointer>& stackTrace;
+  InstructionPointer* frames;
+  size_t limit;
+  size_t count;
 };
 
 _Unwind_Reason_Code unwindCallback(struct _Unwind_Context* context, void* arg) {
@@ -41,55 +153,122 @@ _Unwind_Reason_Code unwindCallback(struct _Unwind_Context* context, void* arg) {
   auto absoluteProgramCounter =
       reinterpret_cast<InstructionPointer>(_Unwind_GetIP(context));
 
+  if (!state->started) {
+    state->started = absoluteProgramCounter == state->start;
+    if (!state->started) {
+      return _URC_NO_REASON;
+    }
+  }
+
   if (state->skip > 0) {
     --state->skip;
     return _URC_NO_REASON;
   }
 
-  if (state->stackTrace.size() == state->stackTrace.capacity()) {
+  if (state->count == state->limit) {
     return _URC_END_OF_STACK;
   }
 
-  state->stackTrace.push_back(absoluteProgramCounter);
+  state->frames[state->count++] = absoluteProgramCounter;
 
   return _URC_NO_REASON;
 }
 
-void captureBacktrace(size_t skip, vector<InstructionPointer>& stackTrace) {
+// Writes the frames outside of |start| into |frames|. Returns false if |start|
+// wasn't found on the stack, in which case |frames| is left alone.
+bool captureBacktrace(InstructionPointer start, size_t skip,
+                      InstructionPointer* frames, size_t limit, size_t* count) {
   // Beware of a bug on some platforms, which makes the trace loop until the
   // buffer is full when it reaches a noexcept function. It seems to be fixed in
   // newer versions of gcc. https://gcc.gnu.org/bugzilla/show_bug.cgi?id=56846
   // TODO(t10738439): Investigate workaround for the stack trace bug
-  BacktraceState state = {skip, stackTrace};
+  BacktraceState state = {start, false, skip, frames, limit, 0};
   _Unwind_Backtrace(unwindCallback, &state);
+  *count = state.count;
+  return state.started;
+}
+}
+
+const void* getStackEnd() noexcept {
+  pthread_attr_t attr;
+  if (pthread_getattr_np(pthread_self(), &attr) != 0) {
+    return nullptr;
+  }
+  void* base = nullptr;
+  size_t size = 0;
+  auto result = pthread_attr_getstack(&attr, &base, &size);
+  pthread_attr_destroy(&attr);
+  if (result != 0 || base == nullptr) {
+    return nullptr;
+  }
+  threadStackStart = reinterpret_cast<uintptr_t>(base);
+  return static_cast<const char*>(base) + size;
+}
+
+// noinline so that the frame pointer is this function's own frame record,
+// whose return address is the caller's frame.
+__attribute__((noinline))
+size_t getStackTraceFramePointers(InstructionPointer* frames, size_t limit,
+                                  const void* stackEnd, size_t skip,
+                                  bool* broken) noexcept {
+  bool chainBroken = true;
+  size_t count = 0;
+  if (stackEnd != nullptr) {
+    count = walkFramePointers(
+        static_cast<const FrameRecord*>(__builtin_frame_address(0)),
+        reinterpret_cast<uintptr_t>(stackEnd), frames, limit, skip,
+        &chainBroken);
+  }
+  if (broken != nullptr) {
+    *broken = chainBroken;
+  }
+  return count;
 }
+
+__attribute__((noinline))
+size_t getStackTrace(InstructionPointer* frames, size_t limit, size_t skip) {
+  // Looking up the bounds of the main thread's stack reads /proc/self/maps, so
+  // it's only done once per thread.
+  static thread_local const void* stackEnd = getStackEnd();
+
+  bool broken = true;
+  size_t count = 0;
+  if (stackEnd != nullptr) {
+    count = walkFramePointers(
+        static_cast<const FrameRecord*>(__builtin_frame_address(0)),
+        reinterpret_cast<uintptr_t>(stackEnd), frames, limit, skip, &broken);
+  }
+  if (!broken) {
+    return count;
+  }
+
+  size_t unwound;
+  auto start = normalizeProgramCounter(
+      reinterpret_cast<uintptr_t>(__builtin_return_address(0)));
+  if (!captureBacktrace(start, skip, frames, limit, &unwound)) {
+    // The EH unwinder couldn't find our caller; keep what the walk found.
+    return count;
+  }
+  return unwound;
 }
 
+__attribute__((noinline))
 void getStackTrace(vector<InstructionPointer>& stackTrace, size_t skip) {
+  // The vector never grows, its capacity is the limit.
   stackTrace.clear();
-  captureBacktrace(skip + 1, stackTrace);
+  stackTrace.resize(stackTrace.capacity());
+  auto count = getStackTrace(stackTrace.data(), stackTrace.size(), skip + 1);
+  stackTrace.resize(count);
 }
 
-// TODO(t10737622): Improve on-device symbolification
 void getStackTraceSymbols(vector<StackTraceElement>& symbols,
                           const vector<InstructionPointer>& trace) {
-  symbols.clear();
-  symbols.reserve(trace.size());
-
-  for (size_t i = 0; i < trace.size(); ++i) {
-    Dl_info info;
-    if (dladdr(trace[i], &info)) {
-      symbols.emplace_back(trace[i], info.dli_fbase, info.dli_saddr,
-                           info.dli_fname ? info.dli_fname : "",
-                           info.dli_sname ? info.dli_sname : "");
-    }
-  }
+  Symbolizer::get().symbolize(symbols, trace);
 }
 
 ostream& operator<<(ostream& out, const StackTraceElement& elm) {
   IosFlagsSaver flags{out};
 
-  // TODO(t10748683): Add build id to the output
   out << "{dso=" << elm.libraryName() << " offset=" << hex
       << showbase << elm.libraryOffset();
 
@@ -97,8 +276,13 @@ ostream& operator<<(ostream& out, const StackTraceElement& elm) {
     out << " func=" << elm.functionName() << "()+" << elm.functionOffset();
   }
 
-  out << " build-id=" << hex << setw(8) << 0
-      << "}";
+  out << " build-id=";
+  if (elm.buildId().empty()) {
+    out << hex << setw(8) << 0;
+  } else {
+    out << elm.buildId();
+  }
+  out << "}";
 
   return out;
 }
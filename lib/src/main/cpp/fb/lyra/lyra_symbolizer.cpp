@@ -0,0 +1,508 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <fb/lyra_symbolizer.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include <dlfcn.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <link.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace facebook {
+namespace lyra {
+
+constexpr size_t Symbolizer::kDefaultCacheCapacity;
+
+namespace {
+
+#ifndef NT_GNU_BUILD_ID
+#define NT_GNU_BUILD_ID 3
+#endif
+
+// Function symbols of ARM Thumb code have the low bit set.
+inline uintptr_t symbolAddress(ElfW(Addr) value) {
+#if defined(__arm__)
+  value &= ~static_cast<ElfW(Addr)>(1);
+#endif
+  return value;
+}
+
+inline bool isFunction(const ElfW(Sym)& sym) {
+  // st_info has the same layout in both ELF classes.
+  auto type = ELF32_ST_TYPE(sym.st_info);
+  return (type == STT_FUNC || type == STT_GNU_IFUNC) &&
+      sym.st_shndx != SHN_UNDEF && sym.st_value != 0;
+}
+
+inline size_t alignNote(size_t size) {
+  return (size + 3) & ~static_cast<size_t>(3);
+}
+
+// Returns the hex GNU build id in a run of notes, or an empty string.
+string findBuildId(const uint8_t* notes, size_t size) {
+  static const char kHex[] = "0123456789abcdef";
+  size_t offset = 0;
+  while (offset + sizeof(ElfW(Nhdr)) <= size) {
+    ElfW(Nhdr) note;
+    memcpy(&note, notes + offset, sizeof(note));
+    offset += sizeof(note);
+    auto name = notes + offset;
+    auto descOffset = offset + alignNote(note.n_namesz);
+    auto next = descOffset + alignNote(note.n_descsz);
+    if (next > size) {
+      break;
+    }
+    if (note.n_type == NT_GNU_BUILD_ID && note.n_namesz == 4 &&
+        memcmp(name, "GNU", 4) == 0) {
+      string buildId;
+      buildId.reserve(note.n_descsz * 2);
+      for (size_t i = 0; i < note.n_descsz; ++i) {
+        auto byte = notes[descOffset + i];
+        buildId.push_back(kHex[byte >> 4]);
+        buildId.push_back(kHex[byte & 0xf]);
+      }
+      return buildId;
+    }
+    offset = next;
+  }
+  return string();
+}
+
+// A read-only mapping of a whole file.
+class MappedFile {
+ public:
+  explicit MappedFile(const char* path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      auto data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data != MAP_FAILED) {
+        data_ = static_cast<const uint8_t*>(data);
+        size_ = st.st_size;
+      }
+    }
+    close(fd);
+  }
+
+  ~MappedFile() {
+    if (data_ != nullptr) {
+      munmap(const_cast<uint8_t*>(data_), size_);
+    }
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // The |count| objects at |offset|, or nullptr if they don't fit in the file.
+  template <typename T>
+  const T* at(size_t offset, size_t count = 1) const {
+    if (data_ == nullptr || offset > size_ ||
+        count > (size_ - offset) / sizeof(T)) {
+      return nullptr;
+    }
+    return reinterpret_cast<const T*>(data_ + offset);
+  }
+
+ private:
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+}
+
+struct Symbolizer::Module {
+  struct Symbol {
+    uintptr_t address;  // unbiased
+    uintptr_t size;
+    uint32_t name;  // offset into names
+  };
+
+  uintptr_t start;
+  uintptr_t end;
+  uintptr_t bias;
+  string name;
+  string buildId;
+  vector<Symbol> symbols;
+  string names;
+
+  static unique_ptr<Module> load(uintptr_t address);
+
+  // Returns the function containing |address| and sets |functionAddress|, or
+  // returns nullptr.
+  const char* lookup(uintptr_t address, uintptr_t* functionAddress) const {
+    auto vaddr = address - bias;
+    auto it = upper_bound(
+        symbols.begin(), symbols.end(), vaddr,
+        [](uintptr_t value, const Symbol& sym) { return value < sym.address; });
+    if (it == symbols.begin()) {
+      return nullptr;
+    }
+    --it;
+    // Symbols without a size (mostly hand-written assembly) are taken to
+    // extend to the next symbol, as dladdr() does.
+    if (it->size != 0 && vaddr - it->address >= it->size) {
+      return nullptr;
+    }
+    *functionAddress = it->address + bias;
+    return names.c_str() + it->name;
+  }
+
+ private:
+  void addSymbol(const ElfW(Sym)& sym, const char* strtab, size_t strsz) {
+    if (!isFunction(sym) || sym.st_name >= strsz) {
+      return;
+    }
+    auto name = strtab + sym.st_name;
+    auto length = strnlen(name, strsz - sym.st_name);
+    if (length == 0 || length == strsz - sym.st_name) {
+      return;
+    }
+    symbols.push_back(Symbol{symbolAddress(sym.st_value), sym.st_size,
+                             static_cast<uint32_t>(names.size())});
+    names.append(name, length + 1);
+  }
+
+  bool loadFileSymbols();
+  void loadDynamicSymbols(const ElfW(Phdr)* phdrs, size_t count);
+  void sortSymbols();
+};
+
+unique_ptr<Symbolizer::Module> Symbolizer::Module::load(uintptr_t address) {
+  Dl_info info;
+  if (dladdr(reinterpret_cast<const void*>(address), &info) == 0 ||
+      info.dli_fbase == nullptr) {
+    return nullptr;
+  }
+  auto base = reinterpret_cast<uintptr_t>(info.dli_fbase);
+  auto ehdr = reinterpret_cast<const ElfW(Ehdr)*>(base);
+  if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0) {
+    return nullptr;
+  }
+  auto phdrs = reinterpret_cast<const ElfW(Phdr)*>(base + ehdr->e_phoff);
+
+  unique_ptr<Module> module{new Module()};
+  module->name = info.dli_fname ? info.dli_fname : "";
+
+  uintptr_t minVaddr = UINTPTR_MAX;
+  uintptr_t maxVaddr = 0;
+  for (size_t i = 0; i < ehdr->e_phnum; ++i) {
+    if (phdrs[i].p_type == PT_LOAD) {
+      minVaddr = min<uintptr_t>(minVaddr, phdrs[i].p_vaddr);
+      maxVaddr = max<uintptr_t>(maxVaddr, phdrs[i].p_vaddr + phdrs[i].p_memsz);
+    }
+  }
+  if (minVaddr >= maxVaddr) {
+    return nullptr;
+  }
+  auto pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+  module->bias = base - (minVaddr & ~(pageSize - 1));
+  module->start = base;
+  module->end = module->bias + maxVaddr;
+
+  for (size_t i = 0; i < ehdr->e_phnum && module->buildId.empty(); ++i) {
+    if (phdrs[i].p_type == PT_NOTE) {
+      module->buildId = findBuildId(
+          reinterpret_cast<const uint8_t*>(module->bias + phdrs[i].p_vaddr),
+          phdrs[i].p_memsz);
+    }
+  }
+
+  if (!module->loadFileSymbols()) {
+    module->loadDynamicSymbols(phdrs, ehdr->e_phnum);
+  }
+  module->sortSymbols();
+  return module;
+}
+
+bool Symbolizer::Module::loadFileSymbols() {
+  MappedFile file{name.c_str()};
+  auto ehdr = file.at<ElfW(Ehdr)>(0);
+  auto loaded = reinterpret_cast<const ElfW(Ehdr)*>(start);
+  if (ehdr == nullptr || memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0 ||
+      ehdr->e_ident[EI_CLASS] != loaded->e_ident[EI_CLASS] ||
+      ehdr->e_shentsize != sizeof(ElfW(Shdr))) {
+    return false;
+  }
+  auto shdrs = file.at<ElfW(Shdr)>(ehdr->e_shoff, ehdr->e_shnum);
+  if (shdrs == nullptr) {
+    return false;
+  }
+
+  const ElfW(Shdr)* symtab = nullptr;
+  const ElfW(Shdr)* dynsym = nullptr;
+  string fileBuildId;
+  for (size_t i = 0; i < ehdr->e_shnum; ++i) {
+    const auto& shdr = shdrs[i];
+    if (shdr.sh_type == SHT_SYMTAB) {
+      symtab = &shdr;
+    } else if (shdr.sh_type == SHT_DYNSYM) {
+      dynsym = &shdr;
+    } else if (shdr.sh_type == SHT_NOTE && fileBuildId.empty()) {
+      auto notes = file.at<uint8_t>(shdr.sh_offset, shdr.sh_size);
+      if (notes != nullptr) {
+        fileBuildId = findBuildId(notes, shdr.sh_size);
+      }
+    }
+  }
+  // The file was replaced since it was loaded.
+  if (!buildId.empty() && !fileBuildId.empty() && buildId != fileBuildId) {
+    return false;
+  }
+
+  auto table = symtab != nullptr ? symtab : dynsym;
+  if (table == nullptr || table->sh_link >= ehdr->e_shnum) {
+    return false;
+  }
+  const auto& strtabHeader = shdrs[table->sh_link];
+  auto count = table->sh_size / sizeof(ElfW(Sym));
+  auto syms = file.at<ElfW(Sym)>(table->sh_offset, count);
+  auto strtab = file.at<char>(strtabHeader.sh_offset, strtabHeader.sh_size);
+  if (syms == nullptr || strtab == nullptr) {
+    return false;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    addSymbol(syms[i], strtab, strtabHeader.sh_size);
+  }
+  return true;
+}
+
+void Symbolizer::Module::loadDynamicSymbols(const ElfW(Phdr)* phdrs,
+                                            size_t count) {
+  const ElfW(Dyn)* dynamic = nullptr;
+  for (size_t i = 0; i < count; ++i) {
+    if (phdrs[i].p_type == PT_DYNAMIC) {
+      dynamic = reinterpret_cast<const ElfW(Dyn)*>(bias + phdrs[i].p_vaddr);
+    }
+  }
+  if (dynamic == nullptr) {
+    return;
+  }
+
+  // glibc relocates these entries in place, bionic leaves them unbiased.
+  auto pointer = [this](ElfW(Addr) value) {
+    return value >= start && value < end ? value : value + bias;
+  };
+  const ElfW(Sym)* syms = nullptr;
+  const char* strtab = nullptr;
+  size_t strsz = 0;
+  const uint32_t* hash = nullptr;
+  const uint32_t* gnuHash = nullptr;
+  for (auto dyn = dynamic; dyn->d_tag != DT_NULL; ++dyn) {
+    switch (dyn->d_tag) {
+      case DT_SYMTAB:
+        syms = reinterpret_cast<const ElfW(Sym)*>(pointer(dyn->d_un.d_ptr));
+        break;
+      case DT_STRTAB:
+        strtab = reinterpret_cast<const char*>(pointer(dyn->d_un.d_ptr));
+        break;
+      case DT_STRSZ:
+        strsz = dyn->d_un.d_val;
+        break;
+      case DT_HASH:
+        hash = reinterpret_cast<const uint32_t*>(pointer(dyn->d_un.d_ptr));
+        break;
+      case DT_GNU_HASH:
+        gnuHash = reinterpret_cast<const uint32_t*>(pointer(dyn->d_un.d_ptr));
+        break;
+    }
+  }
+  if (syms == nullptr || strtab == nullptr) {
+    return;
+  }
+
+  // The dynamic section doesn't record the number of symbols, the hash
+  // tables imply it.
+  size_t symbolCount = 0;
+  if (hash != nullptr) {
+    symbolCount = hash[1];
+  } else if (gnuHash != nullptr) {
+    auto bucketCount = gnuHash[0];
+    auto symbolOffset = gnuHash[1];
+    auto bloomSize = gnuHash[2];
+    auto buckets = reinterpret_cast<const uint32_t*>(
+        reinterpret_cast<const ElfW(Addr)*>(gnuHash + 4) + bloomSize);
+    auto chains = buckets + bucketCount;
+    uint32_t last = 0;
+    for (uint32_t i = 0; i < bucketCount; ++i) {
+      last = max(last, buckets[i]);
+    }
+    if (last < symbolOffset) {
+      symbolCount = symbolOffset;
+    } else {
+      while ((chains[last - symbolOffset] & 1) == 0) {
+        ++last;
+      }
+      symbolCount = last + 1;
+    }
+  }
+  for (size_t i = 0; i < symbolCount; ++i) {
+    addSymbol(syms[i], strtab, strsz);
+  }
+}
+
+void Symbolizer::Module::sortSymbols() {
+  // Aliases share an address; keep the one with a size.
+  sort(symbols.begin(), symbols.end(), [](const Symbol& a, const Symbol& b) {
+    return a.address != b.address ? a.address < b.address : a.size > b.size;
+  });
+  symbols.erase(
+      unique(symbols.begin(), symbols.end(),
+             [](const Symbol& a, const Symbol& b) { return a.address == b.address; }),
+      symbols.end());
+  symbols.shrink_to_fit();
+}
+
+Symbolizer::Symbolizer(size_t cacheCapacity)
+    : cacheCapacity_(max<size_t>(cacheCapacity, 1)), stats_() {}
+
+Symbolizer::~Symbolizer() = default;
+
+Symbolizer& Symbolizer::get() {
+  // Never destroyed, traces may be symbolicated while the process exits.
+  static auto symbolizer = new Symbolizer();
+  return *symbolizer;
+}
+
+const Symbolizer::Module* Symbolizer::findModule(uintptr_t address) {
+  auto it = upper_bound(
+      modules_.begin(), modules_.end(), address,
+      [](uintptr_t value, const unique_ptr<Module>& module) {
+        return value < module->start;
+      });
+  if (it != modules_.begin() && address < (*(it - 1))->end) {
+    return (it - 1)->get();
+  }
+  auto module = Module::load(address);
+  if (!module || address < module->start || address >= module->end) {
+    return nullptr;
+  }
+  it = upper_bound(
+      modules_.begin(), modules_.end(), module->start,
+      [](uintptr_t value, const unique_ptr<Module>& other) {
+        return value < other->start;
+      });
+  return modules_.insert(it, std::move(module))->get();
+}
+
+Symbolizer::Resolved Symbolizer::resolve(uintptr_t address) {
+  ++stats_.lookups;
+  auto cached = cache_.find(address);
+  if (cached != cache_.end()) {
+    ++stats_.cacheHits;
+    lru_.splice(lru_.begin(), lru_, cached->second);
+    return cached->second->second;
+  }
+
+  Resolved resolved{findModule(address), 0, nullptr};
+  if (resolved.module != nullptr) {
+    if (!resolved.module->symbols.empty()) {
+      resolved.functionName =
+          resolved.module->lookup(address, &resolved.functionAddress);
+    } else {
+      // Neither a readable file nor a dynamic symbol table.
+      Dl_info info;
+      if (dladdr(reinterpret_cast<const void*>(address), &info) != 0 &&
+          info.dli_sname != nullptr) {
+        resolved.functionName = info.dli_sname;
+        resolved.functionAddress = reinterpret_cast<uintptr_t>(info.dli_saddr);
+      }
+    }
+  }
+
+  lru_.emplace_front(address, resolved);
+  cache_[address] = lru_.begin();
+  if (lru_.size() > cacheCapacity_) {
+    cache_.erase(lru_.back().first);
+    lru_.pop_back();
+  }
+  return resolved;
+}
+
+void Symbolizer::append(vector<StackTraceElement>& symbols,
+                        InstructionPointer address, const Resolved& resolved) {
+  if (resolved.module == nullptr) {
+    return;
+  }
+  symbols.emplace_back(
+      address, reinterpret_cast<InstructionPointer>(resolved.module->start),
+      reinterpret_cast<InstructionPointer>(resolved.functionAddress),
+      resolved.module->name,
+      resolved.functionName ? resolved.functionName : "",
+      resolved.module->buildId);
+}
+
+void Symbolizer::symbolize(vector<StackTraceElement>& symbols,
+                           const vector<InstructionPointer>& trace) {
+  symbols.clear();
+  symbols.reserve(trace.size());
+
+  lock_guard<mutex> guard(lock_);
+  for (auto address : trace) {
+    append(symbols, address, resolve(reinterpret_cast<uintptr_t>(address)));
+  }
+}
+
+void Symbolizer::symbolize(vector<vector<StackTraceElement>>& symbols,
+                           const vector<vector<InstructionPointer>>& traces) {
+  // Traces share most of their frames. Resolve each distinct address once, in
+  // address order so that consecutive lookups hit the same module.
+  vector<uintptr_t> addresses;
+  for (const auto& trace : traces) {
+    for (auto address : trace) {
+      addresses.push_back(reinterpret_cast<uintptr_t>(address));
+    }
+  }
+  sort(addresses.begin(), addresses.end());
+  addresses.erase(unique(addresses.begin(), addresses.end()), addresses.end());
+
+  vector<Resolved> resolved;
+  resolved.reserve(addresses.size());
+  symbols.clear();
+  symbols.resize(traces.size());
+
+  lock_guard<mutex> guard(lock_);
+  for (auto address : addresses) {
+    resolved.push_back(resolve(address));
+  }
+  for (size_t i = 0; i < traces.size(); ++i) {
+    symbols[i].reserve(traces[i].size());
+    for (auto address : traces[i]) {
+      auto index = lower_bound(addresses.begin(), addresses.end(),
+                               reinterpret_cast<uintptr_t>(address)) -
+          addresses.begin();
+      append(symbols[i], address, resolved[index]);
+    }
+  }
+}
+
+void Symbolizer::reset() {
+  lock_guard<mutex> guard(lock_);
+  cache_.clear();
+  lru_.clear();
+  modules_.clear();
+}
+
+Symbolizer::Stats Symbolizer::stats() {
+  lock_guard<mutex> guard(lock_);
+  auto stats = stats_;
+  stats.modules = modules_.size();
+  stats.symbols = 0;
+  for (const auto& module : modules_) {
+    stats.symbols += module->symbols.size();
+  }
+  return stats;
+}
+
+}
+}
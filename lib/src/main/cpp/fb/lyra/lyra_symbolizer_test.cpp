@@ -0,0 +1,177 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+// Needs the fixture library next to the test binary, built with a GNU hash
+// table only and a known build id:
+//
+//   g++ -shared -fPIC -Wl,--hash-style=gnu -Wl,--build-id=0x4c595241fb0a1b2c
+//       -o liblyra_symbolizer_fixture.so lyra_symbolizer_test_lib.cpp
+
+#include <fb/lyra_symbolizer.h>
+
+#include <gtest/gtest.h>
+
+#include <dlfcn.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <string>
+
+using namespace facebook::lyra;
+
+#ifndef LYRA_SYMBOLIZER_FIXTURE
+#define LYRA_SYMBOLIZER_FIXTURE "./liblyra_symbolizer_fixture.so"
+#endif
+
+namespace {
+
+constexpr const char* kBuildId = "4c595241fb0a1b2c";
+
+struct Fixture {
+  void* handle;
+  const char* exported;
+  const char* hidden;
+};
+
+Fixture openFixture(const char* path) {
+  Fixture fixture{dlopen(path, RTLD_NOW | RTLD_LOCAL), nullptr, nullptr};
+  if (fixture.handle != nullptr) {
+    fixture.exported = static_cast<const char*>(
+        dlsym(fixture.handle, "lyraFixtureExported"));
+    auto hiddenAddress = reinterpret_cast<void* (*)()>(
+        dlsym(fixture.handle, "lyraFixtureHiddenAddress"));
+    fixture.hidden = static_cast<const char*>(hiddenAddress());
+  }
+  return fixture;
+}
+
+// A trace made of distinct addresses inside the fixture's functions.
+std::vector<InstructionPointer> trace(const Fixture& fixture, int offset) {
+  return {fixture.exported + offset, fixture.hidden + offset};
+}
+
+}  // namespace
+
+TEST(LyraSymbolizerTest, FileSymbolsAndBuildId) {
+  Fixture fixture = openFixture(LYRA_SYMBOLIZER_FIXTURE);
+  ASSERT_NE(fixture.handle, nullptr) << dlerror();
+  Symbolizer symbolizer;
+
+  std::vector<StackTraceElement> symbols;
+  symbolizer.symbolize(symbols, trace(fixture, 1));
+
+  ASSERT_EQ(symbols.size(), 2u);
+  EXPECT_EQ(symbols[0].functionName(), "lyraFixtureExported");
+  EXPECT_EQ(symbols[0].functionAddress(), fixture.exported);
+  EXPECT_EQ(symbols[0].functionOffset(), 1);
+  // Hidden functions only come from .symtab.
+  EXPECT_EQ(symbols[1].functionName(), "lyraFixtureHidden");
+  EXPECT_EQ(symbols[1].functionAddress(), fixture.hidden);
+  for (const auto& symbol : symbols) {
+    EXPECT_EQ(symbol.buildId(), kBuildId);
+    EXPECT_NE(symbol.libraryName().find("liblyra_symbolizer_fixture.so"),
+              std::string::npos);
+  }
+  Dl_info info;
+  ASSERT_NE(dladdr(fixture.exported, &info), 0);
+  EXPECT_EQ(symbols[0].libraryBase(), info.dli_fbase);
+  EXPECT_EQ(symbolizer.stats().modules, 1u);
+  dlclose(fixture.handle);
+}
+
+TEST(LyraSymbolizerTest, DynamicSymbolsWhenTheFileIsGone) {
+  // A copy that is deleted once loaded, so only the mapped image is left.
+  char path[] = "/tmp/liblyra_symbolizer_fixture.so.XXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  close(fd);
+  {
+    std::ifstream in(LYRA_SYMBOLIZER_FIXTURE, std::ios::binary);
+    ASSERT_TRUE(in.good());
+    std::ofstream out(path, std::ios::binary);
+    out << in.rdbuf();
+  }
+  Fixture fixture = openFixture(path);
+  unlink(path);
+  ASSERT_NE(fixture.handle, nullptr) << dlerror();
+  Symbolizer symbolizer;
+
+  std::vector<StackTraceElement> symbols;
+  symbolizer.symbolize(symbols, trace(fixture, 1));
+
+  // The .dynsym is counted through DT_GNU_HASH; the hidden function isn't in
+  // it.
+  ASSERT_EQ(symbols.size(), 2u);
+  EXPECT_EQ(symbols[0].functionName(), "lyraFixtureExported");
+  EXPECT_EQ(symbols[0].functionAddress(), fixture.exported);
+  EXPECT_NE(symbols[1].functionName(), "lyraFixtureHidden");
+  // The build id still comes from the loaded PT_NOTE.
+  EXPECT_EQ(symbols[0].buildId(), kBuildId);
+  dlclose(fixture.handle);
+}
+
+TEST(LyraSymbolizerTest, BatchResolvesEachAddressOnce) {
+  Fixture fixture = openFixture(LYRA_SYMBOLIZER_FIXTURE);
+  ASSERT_NE(fixture.handle, nullptr) << dlerror();
+  Symbolizer symbolizer;
+
+  InstructionPointer a = fixture.exported + 1;
+  InstructionPointer b = fixture.hidden + 1;
+  InstructionPointer c = fixture.exported + 2;
+  std::vector<std::vector<InstructionPointer>> traces = {{a, b, a}, {b, c}, {}};
+  std::vector<std::vector<StackTraceElement>> symbols;
+  symbolizer.symbolize(symbols, traces);
+
+  ASSERT_EQ(symbols.size(), 3u);
+  ASSERT_EQ(symbols[0].size(), 3u);
+  ASSERT_EQ(symbols[1].size(), 2u);
+  EXPECT_TRUE(symbols[2].empty());
+  EXPECT_EQ(symbols[0][0].absoluteProgramCounter(), a);
+  EXPECT_EQ(symbols[0][1].functionName(), "lyraFixtureHidden");
+  EXPECT_EQ(symbols[0][2].absoluteProgramCounter(), a);
+  EXPECT_EQ(symbols[1][0].absoluteProgramCounter(), b);
+  EXPECT_EQ(symbols[1][1].functionName(), "lyraFixtureExported");
+  EXPECT_EQ(symbols[1][1].functionOffset(), 2);
+  auto stats = symbolizer.stats();
+  EXPECT_EQ(stats.lookups, 3u);
+  EXPECT_EQ(stats.cacheHits, 0u);
+  dlclose(fixture.handle);
+}
+
+TEST(LyraSymbolizerTest, CacheEvictsLeastRecentlyUsed) {
+  Fixture fixture = openFixture(LYRA_SYMBOLIZER_FIXTURE);
+  ASSERT_NE(fixture.handle, nullptr) << dlerror();
+  Symbolizer symbolizer(2);
+  std::vector<StackTraceElement> symbols;
+  auto lookup = [&](InstructionPointer address) {
+    symbolizer.symbolize(symbols, {address});
+    return symbolizer.stats().cacheHits;
+  };
+
+  InstructionPointer a = fixture.exported + 1;
+  InstructionPointer b = fixture.exported + 2;
+  InstructionPointer c = fixture.exported + 3;
+  EXPECT_EQ(lookup(a), 0u);
+  EXPECT_EQ(lookup(b), 0u);
+  EXPECT_EQ(lookup(a), 1u);
+  // b is now the least recently used.
+  EXPECT_EQ(lookup(c), 1u);
+  EXPECT_EQ(lookup(a), 2u);
+  EXPECT_EQ(lookup(b), 2u);
+  EXPECT_EQ(symbols.size(), 1u);
+  EXPECT_EQ(symbols[0].functionName(), "lyraFixtureExported");
+
+  symbolizer.reset();
+  EXPECT_EQ(symbolizer.stats().modules, 0u);
+  EXPECT_EQ(lookup(a), 2u);
+  dlclose(fixture.handle);
+}
+
+TEST(LyraSymbolizerTest, UnknownAddressesAreSkipped) {
+  Symbolizer symbolizer;
+  std::vector<StackTraceElement> symbols;
+  symbolizer.symbolize(symbols, {reinterpret_cast<InstructionPointer>(16)});
+  EXPECT_TRUE(symbols.empty());
+}
@@ -0,0 +1,22 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+// The library that lyra_symbolizer_test.cpp symbolicates. See there for how
+// it is built.
+
+extern "C" {
+
+// Only in .symtab.
+__attribute__((noinline, visibility("hidden"))) int lyraFixtureHidden(int x) {
+  asm volatile("" : "+r"(x));
+  return x * 3 + 1;
+}
+
+// In .symtab and .dynsym.
+__attribute__((noinline)) int lyraFixtureExported(int x) {
+  return lyraFixtureHidden(x) + 2;
+}
+
+void* lyraFixtureHiddenAddress() {
+  return reinterpret_cast<void*>(&lyraFixtureHidden);
+}
+}
@@ -0,0 +1,158 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <fb/lyra.h>
+
+#include <gtest/gtest.h>
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+
+using namespace facebook::lyra;
+
+namespace {
+
+constexpr size_t kLimit = 32;
+
+// Where each level of the chain returns to in its caller, innermost first.
+InstructionPointer returnAddresses[3];
+InstructionPointer frames[kLimit];
+size_t frameCount;
+bool chainBroken;
+const void* stackEnd;
+
+enum class Capture {
+  kFramePointers,
+  kWithFallback,
+  kInSignalHandler,
+};
+
+__attribute__((noinline)) void captureFramePointers() {
+  frameCount =
+      getStackTraceFramePointers(frames, kLimit, stackEnd, 0, &chainBroken);
+}
+
+void onSignal(int) {
+  captureFramePointers();
+}
+
+// The empty asm after each call keeps it from becoming a tail call, so every
+// level keeps its own frame record.
+__attribute__((noinline)) void level2(Capture capture) {
+  returnAddresses[0] = __builtin_return_address(0);
+  switch (capture) {
+    case Capture::kFramePointers:
+      captureFramePointers();
+      break;
+    case Capture::kWithFallback:
+      frameCount = getStackTrace(frames, kLimit);
+      break;
+    case Capture::kInSignalHandler:
+      raise(SIGUSR1);
+      break;
+  }
+  asm volatile("" ::: "memory");
+}
+
+__attribute__((noinline)) void level1(Capture capture) {
+  returnAddresses[1] = __builtin_return_address(0);
+  level2(capture);
+  asm volatile("" ::: "memory");
+}
+
+__attribute__((noinline)) void level0(Capture capture) {
+  returnAddresses[2] = __builtin_return_address(0);
+  level1(capture);
+  asm volatile("" ::: "memory");
+}
+
+// The index of |address| in the captured trace, or frameCount.
+size_t findFrame(InstructionPointer address) {
+  return std::find(frames, frames + frameCount, address) - frames;
+}
+
+class LyraUnwindTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    stackEnd = getStackEnd();
+    ASSERT_NE(stackEnd, nullptr);
+    memset(frames, 0, sizeof(frames));
+    frameCount = 0;
+    chainBroken = false;
+  }
+};
+
+}  // namespace
+
+TEST_F(LyraUnwindTest, FramePointersFollowTheCallChain) {
+  level0(Capture::kFramePointers);
+
+  // frames[0] is in captureFramePointers and frames[1] in level2.
+  ASSERT_GE(frameCount, 5u);
+  EXPECT_EQ(frames[2], returnAddresses[0]);
+  EXPECT_EQ(frames[3], returnAddresses[1]);
+  EXPECT_EQ(frames[4], returnAddresses[2]);
+}
+
+TEST_F(LyraUnwindTest, SkipDropsInnermostFrames) {
+  InstructionPointer all[kLimit];
+  InstructionPointer skipped[kLimit];
+  size_t count = getStackTraceFramePointers(all, kLimit, stackEnd);
+  size_t skippedCount =
+      getStackTraceFramePointers(skipped, kLimit, stackEnd, 1);
+  ASSERT_GE(count, 2u);
+  ASSERT_EQ(skippedCount + 1, count);
+  // Same caller, so only the call sites of the two captures differ.
+  EXPECT_TRUE(std::equal(skipped + 1, skipped + skippedCount, all + 2));
+}
+
+TEST_F(LyraUnwindTest, NoStackEndCapturesNothing) {
+  EXPECT_EQ(getStackTraceFramePointers(frames, kLimit, nullptr, 0,
+                                       &chainBroken),
+            0u);
+  EXPECT_TRUE(chainBroken);
+}
+
+TEST_F(LyraUnwindTest, FallbackStartsAtTheCaller) {
+  level0(Capture::kWithFallback);
+
+  ASSERT_GE(frameCount, 4u);
+  EXPECT_EQ(frames[1], returnAddresses[0]);
+  EXPECT_EQ(frames[2], returnAddresses[1]);
+  EXPECT_EQ(frames[3], returnAddresses[2]);
+}
+
+TEST_F(LyraUnwindTest, StaysOnTheSignalStack) {
+  // Placed far from the thread's stack, so following the chain out of it
+  // would read memory that isn't there.
+  size_t size = 64 * 1024;
+  void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  ASSERT_NE(memory, MAP_FAILED);
+  stack_t signalStack = {};
+  signalStack.ss_sp = memory;
+  signalStack.ss_size = size;
+  stack_t previousStack;
+  ASSERT_EQ(sigaltstack(&signalStack, &previousStack), 0);
+  struct sigaction action = {};
+  action.sa_handler = onSignal;
+  action.sa_flags = SA_ONSTACK;
+  struct sigaction previousAction;
+  ASSERT_EQ(sigaction(SIGUSR1, &action, &previousAction), 0);
+
+  level0(Capture::kInSignalHandler);
+
+  sigaction(SIGUSR1, &previousAction, nullptr);
+  sigaltstack(&previousStack, nullptr);
+  munmap(memory, size);
+
+  // Only the handler's frames are captured, and the walk says it stopped
+  // early.
+  EXPECT_TRUE(chainBroken);
+  EXPECT_GE(frameCount, 1u);
+  EXPECT_EQ(findFrame(returnAddresses[0]), frameCount);
+}
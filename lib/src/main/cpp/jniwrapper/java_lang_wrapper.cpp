@@ -9,7 +9,7 @@ jstring Throwable::getMessage() const {
 }
 
 jobjectArray Throwable::getStackTrace() const {
-    jmethodID mid = jniEnv->GetMethodID(clazz, "getStackTrace",
+    jmethodID mid = FBJNI_CACHED_METHOD(jniEnv, "java/lang/Throwable", "getStackTrace",
                                         "()[Ljava/lang/StackTraceElement;");
     return (jobjectArray) jniEnv->CallObjectMethod(originObj, mid);
 }
@@ -19,31 +19,37 @@ void Throwable::printStackTrace() const {
 }
 
 Throwable Throwable::constuctor(JNIEnv *env) {
-    jclass clazz = env->FindClass("java/lang/Throwable");
-    jmethodID mid = env->GetMethodID(clazz, "<init>", "()V");
+    jclass clazz = FBJNI_CACHED_CLASS(env, "java/lang/Throwable");
+    jmethodID mid = FBJNI_CACHED_METHOD(env, "java/lang/Throwable", "<init>", "()V");
     jobject newT = env->NewObject(clazz, mid);
+    releaseCachedClass(env, clazz);
     return Throwable(env, newT);
 }
 
 jobject Thread::currentThread(JNIEnv *env) {
-    jclass clazz = env->FindClass("java/lang/Thread");
-    jmethodID currentThreadMethodId = env->GetStaticMethodID(clazz, "currentThread",
-                                                             "()Ljava/lang/Thread;");
-    return env->CallStaticObjectMethod(clazz, currentThreadMethodId);
+    jclass clazz = FBJNI_CACHED_CLASS(env, "java/lang/Thread");
+    jmethodID currentThreadMethodId = FBJNI_CACHED_STATIC_METHOD(env, "java/lang/Thread",
+                                                                 "currentThread",
+                                                                 "()Ljava/lang/Thread;");
+    jobject thread = env->CallStaticObjectMethod(clazz, currentThreadMethodId);
+    releaseCachedClass(env, clazz);
+    return thread;
 }
 
 jstring Thread::getName() const {
-    jmethodID getNameMethodId = jniEnv->GetMethodID(clazz, "getName", "()Ljava/lang/String;");
+    jmethodID getNameMethodId = FBJNI_CACHED_METHOD(jniEnv, "java/lang/Thread", "getName",
+                                                    "()Ljava/lang/String;");
     return (jstring) jniEnv->CallObjectMethod(originObj, getNameMethodId);
 }
 
 jlong Thread::getId() const {
-    jmethodID getIdMethodId = jniEnv->GetMethodID(clazz, "getId", "()J");
+    jmethodID getIdMethodId = FBJNI_CACHED_METHOD(jniEnv, "java/lang/Thread", "getId", "()J");
     return jniEnv->CallLongMethod(originObj, getIdMethodId);
 }
 
 
 jstring StackTraceElement::toString() const {
-    jmethodID toStringMethodId = jniEnv->GetMethodID(clazz, "toString", "()Ljava/lang/String;");
+    jmethodID toStringMethodId = FBJNI_CACHED_METHOD(jniEnv, "java/lang/StackTraceElement",
+                                                     "toString", "()Ljava/lang/String;");
     return (jstring) jniEnv->CallObjectMethod(originObj, toStringMethodId);
 }
@@ -9,24 +9,35 @@
 #include "../fb/include/fb/fbjni.h"
 #include <string>
 
+//IdCache满了时FBJNI_CACHED_CLASS返回的是局部引用, 用完要删; IdCache自己持有的引用不能删
+static inline void releaseCachedClass(JNIEnv *env, jclass clazz) {
+    if (clazz != NULL && env->GetObjectRefType(clazz) == JNILocalRefType) {
+        env->DeleteLocalRef(clazz);
+    }
+}
+
 class StackTraceElement {
 private:
     JNIEnv *jniEnv;
     jobject originObj;
     jclass clazz;
+    //调用方传进来的c归调用方
+    bool ownsClazz;
 
 public:
     StackTraceElement(JNIEnv *env, jobject ori, jclass c) :
             jniEnv(env),
-            originObj(ori), clazz(c) {
+            originObj(ori), clazz(c), ownsClazz(c == NULL) {
         if (c == NULL) {
-            clazz = jniEnv->FindClass("java/lang/StackTraceElement");
+            clazz = FBJNI_CACHED_CLASS(jniEnv, "java/lang/StackTraceElement");
         }
     }
 
 
     ~StackTraceElement() {
-//        jniEnv->DeleteLocalRef(clazz);
+        if (ownsClazz) {
+            releaseCachedClass(jniEnv, clazz);
+        }
         jniEnv = NULL;
     }
 
@@ -43,11 +54,11 @@ public:
     Throwable(JNIEnv *env, jobject ori) :
             jniEnv(env),
             originObj(ori) {
-        clazz = jniEnv->FindClass("java/lang/Throwable");
+        clazz = FBJNI_CACHED_CLASS(jniEnv, "java/lang/Throwable");
     }
 
     ~Throwable() {
-        jniEnv->DeleteLocalRef(clazz);
+        releaseCachedClass(jniEnv, clazz);
         jniEnv = NULL;
     }
 
@@ -75,7 +86,7 @@ public:
     Thread(JNIEnv *env, jobject ori) :
             jniEnv(env),
             originObj(ori) {
-        clazz = jniEnv->FindClass("java/lang/Thread");
+        clazz = FBJNI_CACHED_CLASS(jniEnv, "java/lang/Thread");
     }
 
     static jobject currentThread(JNIEnv *);
@@ -85,7 +96,7 @@ public:
     jlong getId() const;
 
     ~Thread() {
-        jniEnv->DeleteLocalRef(clazz);
+        releaseCachedClass(jniEnv, clazz);
         jniEnv = NULL;
     }
 
@@ -141,7 +141,194 @@ ffi_closure_free (void *ptr)
 
 #if FFI_CLOSURES
 
-#if FFI_EXEC_TRAMPOLINE_TABLE
+/* On Linux (Android included) closures come from preallocated slots of a
+   memfd that is mapped twice, once writable and once executable.  This
+   never touches the filesystem, unlike the dlmmap path below which probes
+   env vars, mount tables and temp dirs for an exec-capable file.  */
+#if !defined(FFI_MEMFD_CLOSURES) && defined(__linux__) && !FFI_EXEC_TRAMPOLINE_TABLE
+#define FFI_MEMFD_CLOSURES 1
+#endif
+
+#if FFI_MEMFD_CLOSURES
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+/* Every slot starts with this header; the closure the caller sees follows
+   it.  exec_delta turns a writable address into the executable alias.  */
+typedef struct ffi_memfd_slot
+{
+  intptr_t exec_delta;
+  /* 0 for pooled slots, the mapping size for oversized requests.  */
+  size_t map_size;
+  struct ffi_memfd_slot *next_free;
+#if defined(__LP64__)
+  void *pad;
+#endif
+} ffi_memfd_slot;
+
+typedef union
+{
+  ffi_closure closure;
+#if !FFI_NO_RAW_API
+  ffi_raw_closure raw_closure;
+  ffi_java_raw_closure java_raw_closure;
+#endif
+} ffi_memfd_payload;
+
+#define FFI_MEMFD_ALIGN 16
+#define FFI_MEMFD_ROUND(x) (((x) + FFI_MEMFD_ALIGN - 1) & ~(size_t) (FFI_MEMFD_ALIGN - 1))
+#define FFI_MEMFD_HEADER_SIZE FFI_MEMFD_ROUND (sizeof (ffi_memfd_slot))
+#define FFI_MEMFD_PAYLOAD_SIZE FFI_MEMFD_ROUND (sizeof (ffi_memfd_payload))
+#define FFI_MEMFD_SLOT_SIZE (FFI_MEMFD_HEADER_SIZE + FFI_MEMFD_PAYLOAD_SIZE)
+#define FFI_MEMFD_CHUNK_PAGES 4
+
+static pthread_mutex_t ffi_memfd_lock = PTHREAD_MUTEX_INITIALIZER;
+static ffi_memfd_slot *ffi_memfd_free_list;
+
+/* Map LENGTH bytes twice.  Returns the writable view and stores the
+   distance to the executable view in *DELTA.  Falls back to a single RWX
+   anonymous mapping when memfd_create is unavailable (kernels < 3.17).  */
+static void *
+ffi_memfd_map (size_t length, intptr_t *delta)
+{
+  void *writable, *executable;
+  int fd = -1;
+
+#ifdef __NR_memfd_create
+  fd = (int) syscall (__NR_memfd_create, "ffi-closures", MFD_CLOEXEC);
+#endif
+  if (fd != -1 && ftruncate (fd, (off_t) length) != 0)
+    {
+      close (fd);
+      fd = -1;
+    }
+
+  if (fd == -1)
+    {
+      writable = mmap (NULL, length, PROT_READ | PROT_WRITE | PROT_EXEC,
+		       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      *delta = 0;
+      return writable == MAP_FAILED ? NULL : writable;
+    }
+
+  writable = mmap (NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  executable = mmap (NULL, length, PROT_READ | PROT_EXEC, MAP_SHARED, fd, 0);
+  close (fd);
+  if (writable == MAP_FAILED || executable == MAP_FAILED)
+    {
+      if (writable != MAP_FAILED)
+	munmap (writable, length);
+      if (executable != MAP_FAILED)
+	munmap (executable, length);
+      return NULL;
+    }
+
+  *delta = (char *) executable - (char *) writable;
+  return writable;
+}
+
+/* Carve a fresh chunk into slots and push them on the free list.  Called
+   with ffi_memfd_lock held.  */
+static int
+ffi_memfd_refill (void)
+{
+  size_t page_size = (size_t) sysconf (_SC_PAGESIZE);
+  size_t length = FFI_MEMFD_CHUNK_PAGES * page_size;
+  size_t count = length / FFI_MEMFD_SLOT_SIZE;
+  intptr_t delta;
+  char *chunk = ffi_memfd_map (length, &delta);
+  size_t i;
+
+  if (chunk == NULL)
+    return 0;
+
+  for (i = count; i > 0; i--)
+    {
+      ffi_memfd_slot *slot =
+	(ffi_memfd_slot *) (chunk + (i - 1) * FFI_MEMFD_SLOT_SIZE);
+      slot->exec_delta = delta;
+      slot->map_size = 0;
+      slot->next_free = ffi_memfd_free_list;
+      ffi_memfd_free_list = slot;
+    }
+  return 1;
+}
+
+void *
+ffi_closure_alloc (size_t size, void **code)
+{
+  ffi_memfd_slot *slot;
+  char *ptr;
+
+  if (!code)
+    return NULL;
+
+  if (size > FFI_MEMFD_PAYLOAD_SIZE)
+    {
+      /* Rare: give oversized requests a dual mapping of their own.  */
+      size_t page_size = (size_t) sysconf (_SC_PAGESIZE);
+      size_t length = (FFI_MEMFD_HEADER_SIZE + size + page_size - 1)
+		      & ~(page_size - 1);
+      intptr_t delta;
+
+      slot = ffi_memfd_map (length, &delta);
+      if (slot == NULL)
+	return NULL;
+      slot->exec_delta = delta;
+      slot->map_size = length;
+    }
+  else
+    {
+      pthread_mutex_lock (&ffi_memfd_lock);
+      if (ffi_memfd_free_list == NULL && !ffi_memfd_refill ())
+	{
+	  pthread_mutex_unlock (&ffi_memfd_lock);
+	  return NULL;
+	}
+      slot = ffi_memfd_free_list;
+      ffi_memfd_free_list = slot->next_free;
+      pthread_mutex_unlock (&ffi_memfd_lock);
+    }
+
+  slot->next_free = NULL;
+  ptr = (char *) slot + FFI_MEMFD_HEADER_SIZE;
+  *code = ptr + slot->exec_delta;
+  return ptr;
+}
+
+void
+ffi_closure_free (void *ptr)
+{
+  ffi_memfd_slot *slot;
+
+  if (ptr == NULL)
+    return;
+
+  slot = (ffi_memfd_slot *) ((char *) ptr - FFI_MEMFD_HEADER_SIZE);
+  if (slot->map_size != 0)
+    {
+      if (slot->exec_delta != 0)
+	munmap ((char *) slot + slot->exec_delta, slot->map_size);
+      munmap (slot, slot->map_size);
+      return;
+    }
+
+  pthread_mutex_lock (&ffi_memfd_lock);
+  slot->next_free = ffi_memfd_free_list;
+  ffi_memfd_free_list = slot;
+  pthread_mutex_unlock (&ffi_memfd_lock);
+}
+
+#elif FFI_EXEC_TRAMPOLINE_TABLE
 
 #ifdef __MACH__
 
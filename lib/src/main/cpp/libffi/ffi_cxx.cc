@@ -1,11 +1,30 @@
 #include "ffi_cxx.h"
 
+constexpr uint32_t FFICallInterface::kClosureBlockShift;
+constexpr uint32_t FFICallInterface::kClosureBlockSize;
+constexpr uint32_t FFICallInterface::kMaxClosureBlocks;
+
+FFICallInterface::FFICallInterface(const FFIType return_type) : cif_(nullptr),
+                                                                types_(nullptr),
+                                                                return_type_(return_type),
+                                                                free_head_(0),
+                                                                block_count_(0) {
+    for (uint32_t i = 0; i < kMaxClosureBlocks; ++i) {
+        blocks_[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
 FFICallInterface::~FFICallInterface() {
-    for (FFIClosure *closure : closures_) {
-        delete closure;
+    // 按块整体释放, 不逐个遍历closure
+    for (uint32_t i = 0; i < kMaxClosureBlocks; ++i) {
+        ClosureBlock *block = blocks_[i].load(std::memory_order_acquire);
+        if (block != nullptr) {
+            ffi_closure_free(block->writable);
+            delete block;
+        }
     }
     delete cif_;
-    delete types_;
+    delete[] types_;
 }
 
 
@@ -15,13 +34,73 @@ void FFIDispatcher(ffi_cif *cif OPTION, void *ret, void **args, void *userdata)
     callback(closure, ret, args, closure->GetUserData());
 }
 
+void FFICallInterface::PushFreeClosures(uint32_t first, uint32_t last) {
+    uint64_t head = free_head_.load(std::memory_order_relaxed);
+    uint64_t next;
+    do {
+        GetClosure(last)->next_free_.store((uint32_t) head, std::memory_order_relaxed);
+        next = ((head >> 32) + 1) << 32 | (first + 1);
+    } while (!free_head_.compare_exchange_weak(head, next, std::memory_order_release,
+                                               std::memory_order_relaxed));
+}
+
+bool FFICallInterface::GrowClosures() {
+    uint32_t index = block_count_.fetch_add(1, std::memory_order_relaxed);
+    if (index >= kMaxClosureBlocks) {
+        block_count_.fetch_sub(1, std::memory_order_relaxed);
+        return false;
+    }
+    ClosureBlock *block = new ClosureBlock();
+    block->writable = reinterpret_cast<ffi_closure *>(
+            ffi_closure_alloc(sizeof(ffi_closure) * kClosureBlockSize, &block->code));
+    if (block->writable == nullptr) {
+        delete block;
+        // 这个块号作废, 不再复用
+        return false;
+    }
+    uint32_t base = index << kClosureBlockShift;
+    for (uint32_t i = 0; i < kClosureBlockSize; ++i) {
+        FFIClosure *closure = &block->closures[i];
+        closure->cif_ = this;
+        closure->index_ = base + i;
+        closure->closure_ = block->writable + i;
+        closure->code_ = reinterpret_cast<ffi_closure *>(block->code) + i;
+        closure->next_free_.store(i + 1 < kClosureBlockSize ? base + i + 2 : 0,
+                                  std::memory_order_relaxed);
+    }
+    blocks_[index].store(block, std::memory_order_release);
+    PushFreeClosures(base, base + kClosureBlockSize - 1);
+    return true;
+}
 
 FFIClosure *FFICallInterface::CreateClosure(void *userdata, FFICallback callback) {
-    std::lock_guard<std::mutex> guard(lock_);
-    FFIClosure *closure = new FFIClosure(this, userdata, callback);
-    ffi_prep_closure_loc(closure->closure_, cif_, FFIDispatcher, closure, closure->code_);
-    closures_.push_back(closure);
-    return closure;
+    uint64_t head = free_head_.load(std::memory_order_acquire);
+    for (;;) {
+        uint32_t top = (uint32_t) head;
+        if (top == 0) {
+            if (!GrowClosures()) {
+                return nullptr;
+            }
+            head = free_head_.load(std::memory_order_acquire);
+            continue;
+        }
+        FFIClosure *closure = GetClosure(top - 1);
+        uint64_t next = ((head & ~0xFFFFFFFFull) + (1ull << 32)) |
+                        closure->next_free_.load(std::memory_order_relaxed);
+        if (free_head_.compare_exchange_weak(head, next, std::memory_order_acquire,
+                                             std::memory_order_acquire)) {
+            closure->userdata_ = userdata;
+            closure->callback_ = callback;
+            ffi_prep_closure_loc(closure->closure_, cif_, FFIDispatcher, closure, closure->code_);
+            return closure;
+        }
+    }
+}
+
+void FFICallInterface::RemoveClosure(FFIClosure *closure) {
+    closure->callback_ = nullptr;
+    closure->userdata_ = nullptr;
+    PushFreeClosures(closure->index_, closure->index_);
 }
 
 static ffi_type *FFIGetCType(FFIType type) {
@@ -1,9 +1,10 @@
 #ifndef WHALE_FFI_CXX_H_
 #define WHALE_FFI_CXX_H_
 
+#include <atomic>
 #include <cstdarg>
+#include <cstdint>
 #include <list>
-#include <mutex>
 #include "ffi.h"
 #include "macros.h"
 
@@ -28,18 +29,15 @@ class FFIClosure;
 
 typedef void (*FFICallback)(FFIClosure *closure, void *ret, void **args, void *userdata);
 
+/*
+ * Closures are owned by their FFICallInterface and live in fixed-size blocks
+ * of a per-CIF pool. A closure is addressed by its index in that pool, and
+ * free slots are chained through the slots themselves, so creating and
+ * removing a closure is a lock-free pop/push. Slots are reused, never freed
+ * one by one; the whole pool goes away with the CIF.
+ */
 class FFIClosure {
  public:
-    FFIClosure(FFICallInterface *cif, void *userdata, FFICallback callback) : cif_(cif),
-                                                                              userdata_(userdata),
-                                                                              callback_(callback) {
-        closure_ = reinterpret_cast<ffi_closure *>(ffi_closure_alloc(sizeof(ffi_closure), &code_));
-    }
-
-    ~FFIClosure() {
-        ffi_closure_free(closure_);
-    }
-
     void *GetCode() {
         return code_;
     }
@@ -56,20 +54,35 @@ class FFIClosure {
         return callback_;
     }
 
+    uint32_t GetIndex() {
+        return index_;
+    }
+
  private:
     friend class FFICallInterface;
 
+    FFIClosure() : cif_(nullptr), closure_(nullptr), callback_(nullptr), code_(nullptr),
+                   userdata_(nullptr), index_(0), next_free_(0) {}
+
     FFICallInterface *cif_;
     ffi_closure *closure_;
     FFICallback callback_;
     void *code_;
     void *userdata_;
+    uint32_t index_;
+    // 空闲链表中下一个slot的index + 1, 0表示链表结束
+    std::atomic<uint32_t> next_free_;
 
+    DISALLOW_COPY_AND_ASSIGN(FFIClosure);
 };
 
 class FFICallInterface {
  public:
-    FFICallInterface(const FFIType return_type) : return_type_(return_type) {}
+    static constexpr uint32_t kClosureBlockShift = 8;
+    static constexpr uint32_t kClosureBlockSize = 1u << kClosureBlockShift;
+    static constexpr uint32_t kMaxClosureBlocks = 1024;
+
+    FFICallInterface(const FFIType return_type);
 
     ~FFICallInterface();
 
@@ -98,20 +111,48 @@ class FFICallInterface {
         return parameters_;
     }
 
+    ffi_cif *GetCif() {
+        return cif_;
+    }
+
+    /**
+     * @return nullptr if the pool is exhausted or executable memory can't be allocated
+     */
     FFIClosure *CreateClosure(void *userdata, FFICallback callback);
 
-    void RemoveClosure(FFIClosure *closure) {
-        std::lock_guard<std::mutex> guard(lock_);
-        closures_.remove(closure);
+    /**
+     * Returns the slot to the pool. The closure must no longer be reachable from
+     * any entry point, its code is rewritten when the slot is handed out again.
+     */
+    void RemoveClosure(FFIClosure *closure);
+
+    FFIClosure *GetClosure(uint32_t index) {
+        ClosureBlock *block = blocks_[index >> kClosureBlockShift].load(std::memory_order_acquire);
+        return &block->closures[index & (kClosureBlockSize - 1)];
     }
 
  private:
-    std::mutex lock_;
+    struct ClosureBlock {
+        FFIClosure closures[kClosureBlockSize];
+        // 整块一次性申请的可执行内存, 第i个slot用第i个ffi_closure
+        ffi_closure *writable;
+        void *code;
+    };
+
+    bool GrowClosures();
+
+    void PushFreeClosures(uint32_t first, uint32_t last);
+
     ffi_cif *cif_;
     ffi_type **types_;
     std::list<FFIType> parameters_;
     const FFIType return_type_;
-    std::list<FFIClosure *> closures_;
+    // 低32位是空闲链表头(index + 1), 高32位是防ABA的版本号
+    std::atomic<uint64_t> free_head_;
+    std::atomic<uint32_t> block_count_;
+    std::atomic<ClosureBlock *> blocks_[kMaxClosureBlocks];
+
+    DISALLOW_COPY_AND_ASSIGN(FFICallInterface);
 };
 
 #endif //WHALE_FFI_CXX_H_
@@ -0,0 +1,280 @@
+#ifndef WHALE_FFI_SIGNATURE_H_
+#define WHALE_FFI_SIGNATURE_H_
+
+#include <cstring>
+#include <type_traits>
+#include "ffi.h"
+
+/*
+ * Compile-time counterpart of FFICallInterface: the whole CIF description is
+ * derived from a C++ function type, e.g.
+ *
+ *   typedef FFISignature<jint(JNIEnv *, jobject, jlong, double)> Sig;
+ *   Sig::Call(fn, env, obj, 1L, 2.0);
+ *
+ *   static jint OnCall(void *userdata, JNIEnv *env, jobject obj, jlong l, double d);
+ *   FFITypedClosure<jint(JNIEnv *, jobject, jlong, double)> closure(OnCall, userdata);
+ *   void *entry = closure.GetCode();
+ *
+ * The argument type array is static constexpr storage and the ffi_cif is a
+ * function-local static prepared once, so neither the signature nor a closure
+ * built from it touches the heap or walks types per call.
+ */
+
+template<bool kSigned, unsigned kSize>
+struct FFIIntegerType;
+
+#define FFI_INTEGER_TYPE(is_signed, size, type) \
+    template<> \
+    struct FFIIntegerType<is_signed, size> { \
+        static constexpr ffi_type *Get() { return &type; } \
+    }
+
+FFI_INTEGER_TYPE(true, 1, ffi_type_sint8);
+FFI_INTEGER_TYPE(true, 2, ffi_type_sint16);
+FFI_INTEGER_TYPE(true, 4, ffi_type_sint32);
+FFI_INTEGER_TYPE(true, 8, ffi_type_sint64);
+FFI_INTEGER_TYPE(false, 1, ffi_type_uint8);
+FFI_INTEGER_TYPE(false, 2, ffi_type_uint16);
+FFI_INTEGER_TYPE(false, 4, ffi_type_uint32);
+FFI_INTEGER_TYPE(false, 8, ffi_type_uint64);
+
+#undef FFI_INTEGER_TYPE
+
+template<typename T, typename Enable = void>
+struct FFITypeOf;
+
+template<>
+struct FFITypeOf<void> {
+    static constexpr ffi_type *Get() { return &ffi_type_void; }
+};
+
+template<>
+struct FFITypeOf<float> {
+    static constexpr ffi_type *Get() { return &ffi_type_float; }
+};
+
+template<>
+struct FFITypeOf<double> {
+    static constexpr ffi_type *Get() { return &ffi_type_double; }
+};
+
+template<typename T>
+struct FFITypeOf<T *> {
+    static constexpr ffi_type *Get() { return &ffi_type_pointer; }
+};
+
+template<typename T>
+struct FFITypeOf<T, typename std::enable_if<std::is_integral<T>::value>::type>
+        : FFIIntegerType<std::is_signed<T>::value, sizeof(T)> {
+};
+
+template<typename T>
+constexpr ffi_type *FFITypeFor() {
+    return FFITypeOf<typename std::remove_cv<T>::type>::Get();
+}
+
+template<typename T>
+struct FFISupportedType {
+    static constexpr bool value = std::is_void<T>::value || std::is_pointer<T>::value ||
+                                  std::is_arithmetic<T>::value;
+};
+
+template<typename... Args>
+struct FFIAllSupported;
+
+template<>
+struct FFIAllSupported<> {
+    static constexpr bool value = true;
+};
+
+template<typename T, typename... Rest>
+struct FFIAllSupported<T, Rest...> {
+    static constexpr bool value = FFISupportedType<T>::value && FFIAllSupported<Rest...>::value;
+};
+
+template<unsigned... I>
+struct FFIIndices {
+};
+
+template<unsigned N, unsigned... I>
+struct FFIMakeIndices : FFIMakeIndices<N - 1, N - 1, I...> {
+};
+
+template<unsigned... I>
+struct FFIMakeIndices<0, I...> {
+    typedef FFIIndices<I...> type;
+};
+
+/*
+ * Return values narrower than a register are widened to ffi_arg/ffi_sarg,
+ * as libffi expects for both ffi_call results and closure results.
+ */
+template<typename R, typename Enable = void>
+struct FFIReturn {
+    typedef R Storage;
+
+    static void Store(void *ret, R value) {
+        memcpy(ret, &value, sizeof(R));
+    }
+
+    static R Load(const Storage &storage) {
+        return storage;
+    }
+};
+
+template<typename R>
+struct FFIReturn<R, typename std::enable_if<std::is_integral<R>::value &&
+                                            (sizeof(R) < sizeof(ffi_arg))>::type> {
+    typedef typename std::conditional<std::is_signed<R>::value, ffi_sarg, ffi_arg>::type Storage;
+
+    static void Store(void *ret, R value) {
+        *reinterpret_cast<Storage *>(ret) = static_cast<Storage>(value);
+    }
+
+    static R Load(const Storage &storage) {
+        return static_cast<R>(storage);
+    }
+};
+
+template<>
+struct FFIReturn<void> {
+    typedef ffi_arg Storage;
+
+    static void Load(const Storage &) {
+    }
+};
+
+template<typename Signature>
+class FFISignature;
+
+template<typename R, typename... Args>
+class FFISignature<R(Args...)> {
+ public:
+    static_assert(FFISupportedType<R>::value && FFIAllSupported<Args...>::value,
+                  "only void, pointer and arithmetic types can be described");
+
+    static constexpr unsigned kArgCount = sizeof...(Args);
+
+    static ffi_type *ReturnType() {
+        return FFITypeFor<R>();
+    }
+
+    static ffi_type *const *ArgTypes() {
+        return kArgTypes;
+    }
+
+    /*
+     * Prepared on first use, shared by every caller and closure of this
+     * signature.
+     */
+    static ffi_cif *GetCif() {
+        static Holder holder;
+        return &holder.cif;
+    }
+
+    static R Call(void *function, Args... args) {
+        return CallImpl(function, typename FFIMakeIndices<kArgCount>::type(), args...);
+    }
+
+ private:
+    struct Holder {
+        ffi_cif cif;
+
+        Holder() {
+            // ffi_prep_cif only reads the array, the const_cast is to fit its C signature.
+            ffi_prep_cif(&cif, FFI_DEFAULT_ABI, kArgCount, FFITypeFor<R>(),
+                         const_cast<ffi_type **>(kArgTypes));
+        }
+    };
+
+    template<unsigned... I>
+    static R CallImpl(void *function, FFIIndices<I...>, Args... args) {
+        void *values[kArgCount == 0 ? 1 : kArgCount] = {static_cast<void *>(&args)...};
+        typename FFIReturn<R>::Storage result;
+        ffi_call(GetCif(), FFI_FN(function), &result, values);
+        return FFIReturn<R>::Load(result);
+    }
+
+    static constexpr ffi_type *kArgTypes[kArgCount == 0 ? 1 : kArgCount] = {
+            FFITypeFor<Args>()...
+    };
+};
+
+template<typename R, typename... Args>
+constexpr unsigned FFISignature<R(Args...)>::kArgCount;
+
+template<typename R, typename... Args>
+constexpr ffi_type *FFISignature<R(Args...)>::kArgTypes[];
+
+/*
+ * A closure whose callback receives the unpacked, typed arguments plus the
+ * userdata given at construction.
+ */
+template<typename Signature>
+class FFITypedClosure;
+
+template<typename R, typename... Args>
+class FFITypedClosure<R(Args...)> {
+ public:
+    typedef R (*Callback)(void *userdata, Args... args);
+
+    FFITypedClosure(Callback callback, void *userdata) : callback_(callback),
+                                                          userdata_(userdata),
+                                                          code_(nullptr) {
+        closure_ = reinterpret_cast<ffi_closure *>(ffi_closure_alloc(sizeof(ffi_closure), &code_));
+        if (closure_ != nullptr) {
+            ffi_prep_closure_loc(closure_, FFISignature<R(Args...)>::GetCif(), Dispatch, this,
+                                 code_);
+        }
+    }
+
+    ~FFITypedClosure() {
+        if (closure_ != nullptr) {
+            ffi_closure_free(closure_);
+        }
+    }
+
+    FFITypedClosure(const FFITypedClosure &) = delete;
+
+    FFITypedClosure &operator=(const FFITypedClosure &) = delete;
+
+    void *GetCode() {
+        return code_;
+    }
+
+    void *GetUserData() {
+        return userdata_;
+    }
+
+ private:
+    template<typename T>
+    static T Arg(void **args, unsigned index) {
+        return *reinterpret_cast<T *>(args[index]);
+    }
+
+    template<unsigned... I>
+    static void Invoke(FFITypedClosure *self, void *ret, void **args, FFIIndices<I...>,
+                       std::false_type) {
+        FFIReturn<R>::Store(ret, self->callback_(self->userdata_, Arg<Args>(args, I)...));
+    }
+
+    template<unsigned... I>
+    static void Invoke(FFITypedClosure *self, void *, void **args, FFIIndices<I...>,
+                       std::true_type) {
+        (void) args;
+        self->callback_(self->userdata_, Arg<Args>(args, I)...);
+    }
+
+    static void Dispatch(ffi_cif *, void *ret, void **args, void *userdata) {
+        Invoke(reinterpret_cast<FFITypedClosure *>(userdata), ret, args,
+               typename FFIMakeIndices<sizeof...(Args)>::type(), std::is_void<R>());
+    }
+
+    Callback callback_;
+    void *userdata_;
+    ffi_closure *closure_;
+    void *code_;
+};
+
+#endif //WHALE_FFI_SIGNATURE_H_
@@ -0,0 +1,670 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "async_log.h"
+
+#include <pthread.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "utils/log.h"
+#include "utils/thread_name.h"
+
+using std::lock_guard;
+using std::mutex;
+
+namespace profiler {
+
+namespace {
+
+// Per-thread ring size. Must be a power of two.
+constexpr uint32_t kBufferSize = 16 * 1024;
+constexpr uint32_t kMaxRecordSize = kBufferSize / 4;
+constexpr size_t kMaxMessageLength = 1024;
+// How long the background thread lets a burst collect once it is woken.
+constexpr std::chrono::milliseconds kDrainDelay(20);
+constexpr const char *const kDroppedTag = "AsyncLog";
+
+constexpr size_t kSlot = 8;
+
+constexpr size_t Align(size_t size) { return (size + kSlot - 1) & ~(kSlot - 1); }
+
+constexpr size_t kMaxStringLength = 512;
+// Enough for "%", the flags, two numbers, a length modifier and a conversion.
+constexpr size_t kMaxSpecLength = 64;
+
+// Layout of a record header; the arguments follow it.
+struct Record {
+  uint32_t size;
+  int32_t level;
+  const char *tag;
+  const char *format;
+};
+
+constexpr size_t kHeaderSize = Align(sizeof(Record));
+
+// How the argument of a conversion is passed, and so how it is recorded.
+enum class ArgType {
+  kNone,  // %% and malformed conversions, copied as text
+  kInt,
+  kLong,
+  kLongLong,
+  kIntMax,
+  kSize,
+  kPtrDiff,
+  kDouble,
+  kLongDouble,
+  kString,
+  kPointer,
+  kUnsupported,  // %n and wide strings: the pointer is skipped, nothing printed
+};
+
+struct Conversion {
+  const char *begin;  // the '%'
+  const char *end;    // past the conversion character
+  int stars;          // '*' width and precision, each an int argument
+  ArgType type;
+};
+
+// Finds the first conversion in |fmt|. Returns false if there is none.
+bool NextConversion(const char *fmt, Conversion *conversion) {
+  const char *p = strchr(fmt, '%');
+  if (p == nullptr) return false;
+  conversion->begin = p++;
+  conversion->stars = 0;
+  conversion->type = ArgType::kNone;
+  while (*p != '\0' && strchr("-+ #0'", *p) != nullptr) p++;
+  if (*p == '*') {
+    conversion->stars++;
+    p++;
+  }
+  while (*p >= '0' && *p <= '9') p++;
+  if (*p == '.') {
+    p++;
+    if (*p == '*') {
+      conversion->stars++;
+      p++;
+    }
+    while (*p >= '0' && *p <= '9') p++;
+  }
+
+  ArgType integer = ArgType::kInt;
+  bool wide = false;
+  bool long_double = false;
+  switch (*p) {
+    case 'h':
+      p += p[1] == 'h' ? 2 : 1;
+      break;
+    case 'l':
+      if (p[1] == 'l') {
+        integer = ArgType::kLongLong;
+        p += 2;
+      } else {
+        integer = ArgType::kLong;
+        wide = true;
+        p++;
+      }
+      break;
+    case 'q':
+      integer = ArgType::kLongLong;
+      p++;
+      break;
+    case 'j':
+      integer = ArgType::kIntMax;
+      p++;
+      break;
+    case 'z':
+      integer = ArgType::kSize;
+      p++;
+      break;
+    case 't':
+      integer = ArgType::kPtrDiff;
+      p++;
+      break;
+    case 'L':
+      long_double = true;
+      p++;
+      break;
+  }
+
+  switch (*p) {
+    case 'd':
+    case 'i':
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+      conversion->type = integer;
+      break;
+    case 'c':
+      // wint_t is passed as an int as well.
+      conversion->type = ArgType::kInt;
+      break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+      conversion->type = long_double ? ArgType::kLongDouble : ArgType::kDouble;
+      break;
+    case 's':
+      conversion->type = wide ? ArgType::kUnsupported : ArgType::kString;
+      break;
+    case 'p':
+      conversion->type = ArgType::kPointer;
+      break;
+    case 'n':
+      conversion->type = ArgType::kUnsupported;
+      break;
+    case '\0':
+      // A trailing '%': copy it as text, with no argument.
+      conversion->stars = 0;
+      conversion->end = p;
+      return true;
+    default:
+      conversion->stars = 0;
+      break;
+  }
+  conversion->end = p + 1;
+  return true;
+}
+
+// Copies the arguments described by |fmt| to |out|, or only measures them when
+// |out| is null. Integers and pointers take one 8-byte slot each. A string is
+// a 16-bit length, the bytes and a NUL.
+size_t RecordArgs(const char *fmt, va_list args, uint8_t *out) {
+  size_t size = 0;
+  auto put = [&](const void *value, size_t length) {
+    if (out != nullptr) memcpy(out + size, value, length);
+    size += Align(length);
+  };
+  auto put_integer = [&](uint64_t value) { put(&value, sizeof(value)); };
+
+  Conversion conversion;
+  while (NextConversion(fmt, &conversion)) {
+    fmt = conversion.end;
+    for (int i = 0; i < conversion.stars; i++) put_integer(va_arg(args, int));
+    switch (conversion.type) {
+      case ArgType::kNone:
+        break;
+      case ArgType::kInt:
+        put_integer(va_arg(args, int));
+        break;
+      case ArgType::kLong:
+        put_integer(va_arg(args, long));
+        break;
+      case ArgType::kLongLong:
+        put_integer(va_arg(args, long long));
+        break;
+      case ArgType::kIntMax:
+        put_integer(va_arg(args, intmax_t));
+        break;
+      case ArgType::kSize:
+        put_integer(va_arg(args, size_t));
+        break;
+      case ArgType::kPtrDiff:
+        put_integer(va_arg(args, ptrdiff_t));
+        break;
+      case ArgType::kDouble: {
+        double value = va_arg(args, double);
+        put(&value, sizeof(value));
+        break;
+      }
+      case ArgType::kLongDouble: {
+        long double value = va_arg(args, long double);
+        put(&value, sizeof(value));
+        break;
+      }
+      case ArgType::kString: {
+        const char *value = va_arg(args, const char *);
+        uint16_t length = static_cast<uint16_t>(
+            value == nullptr ? 0 : strnlen(value, kMaxStringLength));
+        if (out != nullptr) {
+          uint8_t *p = out + size;
+          memcpy(p, &length, sizeof(length));
+          if (length > 0) memcpy(p + sizeof(length), value, length);
+          p[sizeof(length) + length] = '\0';
+        }
+        size += Align(sizeof(length) + length + 1);
+        break;
+      }
+      case ArgType::kPointer:
+        put_integer(reinterpret_cast<uintptr_t>(va_arg(args, void *)));
+        break;
+      case ArgType::kUnsupported:
+        va_arg(args, void *);
+        break;
+    }
+  }
+  return size;
+}
+
+// Writes at most |size| - 1 bytes of text at |out| + |*used|, keeping it NUL
+// terminated.
+void Append(char *out, size_t size, size_t *used, const char *text,
+            size_t length) {
+  length = std::min(length, size - 1 - *used);
+  memcpy(out + *used, text, length);
+  *used += length;
+  out[*used] = '\0';
+}
+
+// The inverse of RecordArgs: formats |fmt| with the arguments read from |args|,
+// one conversion at a time.
+void FormatRecord(char *out, size_t size, const char *fmt,
+                  const uint8_t *args) {
+  size_t used = 0;
+  out[0] = '\0';
+  auto get_integer = [&args]() {
+    uint64_t value;
+    memcpy(&value, args, sizeof(value));
+    args += Align(sizeof(value));
+    return value;
+  };
+
+  Conversion conversion;
+  while (NextConversion(fmt, &conversion)) {
+    Append(out, size, &used, fmt, conversion.begin - fmt);
+    fmt = conversion.end;
+    if (conversion.type == ArgType::kNone) {
+      bool percent = conversion.end - conversion.begin == 2 &&
+                     conversion.begin[1] == '%';
+      Append(out, size, &used, percent ? "%" : conversion.begin,
+             percent ? 1 : conversion.end - conversion.begin);
+      continue;
+    }
+
+    // Spell out '*' values so the spec takes exactly one argument. An absurdly
+    // long spec prints nothing, but its arguments are still skipped.
+    char spec[kMaxSpecLength];
+    size_t spec_length = 0;
+    bool fits = static_cast<size_t>(conversion.end - conversion.begin) +
+                    2 * sizeof("-2147483648") < sizeof(spec);
+    for (const char *p = conversion.begin; p < conversion.end; p++) {
+      if (*p == '*') {
+        int value = static_cast<int>(get_integer());
+        if (!fits) continue;
+        if (p[-1] == '.' && value < 0) {
+          // A negative precision counts as if none was given.
+          spec_length--;
+          continue;
+        }
+        spec_length += snprintf(spec + spec_length, sizeof(spec) - spec_length,
+                                "%d", value);
+      } else if (fits) {
+        spec[spec_length++] = *p;
+      }
+    }
+    spec[spec_length] = '\0';
+
+    char *end = out + used;
+    size_t left = size - used;
+    int written = 0;
+    switch (conversion.type) {
+      case ArgType::kNone:
+      case ArgType::kUnsupported:
+        break;
+      case ArgType::kInt:
+        written = snprintf(end, left, spec, static_cast<int>(get_integer()));
+        break;
+      case ArgType::kLong:
+        written = snprintf(end, left, spec, static_cast<long>(get_integer()));
+        break;
+      case ArgType::kLongLong:
+        written =
+            snprintf(end, left, spec, static_cast<long long>(get_integer()));
+        break;
+      case ArgType::kIntMax:
+        written =
+            snprintf(end, left, spec, static_cast<intmax_t>(get_integer()));
+        break;
+      case ArgType::kSize:
+        written = snprintf(end, left, spec, static_cast<size_t>(get_integer()));
+        break;
+      case ArgType::kPtrDiff:
+        written =
+            snprintf(end, left, spec, static_cast<ptrdiff_t>(get_integer()));
+        break;
+      case ArgType::kDouble: {
+        double value;
+        memcpy(&value, args, sizeof(value));
+        args += Align(sizeof(value));
+        written = snprintf(end, left, spec, value);
+        break;
+      }
+      case ArgType::kLongDouble: {
+        long double value;
+        memcpy(&value, args, sizeof(value));
+        args += Align(sizeof(value));
+        written = snprintf(end, left, spec, value);
+        break;
+      }
+      case ArgType::kString: {
+        uint16_t length;
+        memcpy(&length, args, sizeof(length));
+        written = snprintf(end, left, spec,
+                           reinterpret_cast<const char *>(args + sizeof(length)));
+        args += Align(sizeof(length) + length + 1);
+        break;
+      }
+      case ArgType::kPointer:
+        written = snprintf(end, left, spec,
+                           reinterpret_cast<void *>(
+                               static_cast<uintptr_t>(get_integer())));
+        break;
+    }
+    if (written > 0) used += std::min(static_cast<size_t>(written), left - 1);
+  }
+  Append(out, size, &used, fmt, strlen(fmt));
+}
+
+// Single producer (the owning thread), single consumer (whoever holds the
+// drain lock). |head| and |tail| count bytes and wrap naturally.
+struct ThreadBuffer {
+  std::atomic<uint32_t> head{0};
+  std::atomic<uint32_t> tail{0};
+  std::atomic<uint32_t> dropped{0};
+  // Set when the owning thread exits; the buffer is freed after its last drain.
+  std::atomic<bool> retired{false};
+  // Producer only: |head| after the record being written.
+  uint32_t pending = 0;
+  alignas(kSlot) uint8_t data[kBufferSize];
+};
+
+thread_local ThreadBuffer *current_buffer = nullptr;
+
+void DefaultSink(LogLevel level, const char *tag, const char *msg) {
+  Log::Sink(level, tag, msg);
+}
+
+class Logger {
+ public:
+  Logger() : sink_(&DefaultSink), has_records_(false) {
+    pthread_key_create(&retire_key_, &Logger::RetireBuffer);
+  }
+
+  // Reserves |size| bytes for a record in the calling thread's buffer. Returns
+  // null if the buffer is full; the message is then counted as dropped.
+  uint8_t *Reserve(size_t size) {
+    ThreadBuffer *buffer = current_buffer;
+    if (buffer == nullptr) {
+      buffer = current_buffer = CreateBuffer();
+    }
+    if (size > kMaxRecordSize) {
+      buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    }
+
+    uint32_t head = buffer->head.load(std::memory_order_relaxed);
+    uint32_t tail = buffer->tail.load(std::memory_order_acquire);
+    uint32_t offset = head & (kBufferSize - 1);
+    uint32_t contiguous = kBufferSize - offset;
+    // Records never wrap; skip to the start of the ring instead.
+    uint32_t padding = size > contiguous ? contiguous : 0;
+    if (kBufferSize - (head - tail) < padding + size) {
+      buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    if (padding >= kHeaderSize) {
+      Record skip = {padding, 0, nullptr, nullptr};
+      memcpy(buffer->data + offset, &skip, sizeof(skip));
+    }
+    buffer->pending = head + padding + static_cast<uint32_t>(size);
+    return buffer->data + ((head + padding) & (kBufferSize - 1));
+  }
+
+  // Publishes the record last returned by |Reserve|, and wakes the background
+  // thread if it is waiting for one.
+  void Commit() {
+    ThreadBuffer *buffer = current_buffer;
+    // Sequentially consistent with the exchange in DrainThread: either it sees
+    // this record, or this sees the flag cleared.
+    buffer->head.store(buffer->pending);
+    if (!has_records_.load() && !has_records_.exchange(true)) {
+      lock_guard<mutex> lock(wake_mutex_);
+      wake_.notify_one();
+    }
+  }
+
+  // Formats every committed record; only one caller drains at a time.
+  void Drain() {
+    lock_guard<mutex> drain_lock(drain_mutex_);
+    std::vector<ThreadBuffer *> buffers;
+    {
+      lock_guard<mutex> lock(registry_mutex_);
+      buffers = buffers_;
+    }
+    LogSink sink = sink_.load(std::memory_order_acquire);
+    for (ThreadBuffer *buffer : buffers) {
+      // Read before draining so nothing committed before retirement is lost.
+      bool retired = buffer->retired.load(std::memory_order_acquire);
+      DrainBuffer(buffer, sink);
+      if (retired) {
+        lock_guard<mutex> lock(registry_mutex_);
+        buffers_.erase(std::find(buffers_.begin(), buffers_.end(), buffer));
+        delete buffer;
+      }
+    }
+  }
+
+  LogSink SetSink(LogSink sink) { return sink_.exchange(sink); }
+
+ private:
+  ThreadBuffer *CreateBuffer() {
+    ThreadBuffer *buffer = new ThreadBuffer();
+    {
+      lock_guard<mutex> lock(registry_mutex_);
+      buffers_.push_back(buffer);
+    }
+    pthread_setspecific(retire_key_, buffer);
+    std::call_once(thread_started_, [this] {
+      std::thread(&Logger::DrainThread, this).detach();
+    });
+    return buffer;
+  }
+
+  static void RetireBuffer(void *buffer) {
+    current_buffer = nullptr;
+    static_cast<ThreadBuffer *>(buffer)->retired.store(
+        true, std::memory_order_release);
+  }
+
+  static void DrainBuffer(ThreadBuffer *buffer, LogSink sink) {
+    uint32_t head = buffer->head.load(std::memory_order_acquire);
+    uint32_t tail = buffer->tail.load(std::memory_order_relaxed);
+    char message[kMaxMessageLength];
+    while (tail != head) {
+      uint32_t offset = tail & (kBufferSize - 1);
+      uint32_t contiguous = kBufferSize - offset;
+      // Too little room left for a header: the producer wrapped silently.
+      if (contiguous < kHeaderSize) {
+        tail += contiguous;
+        continue;
+      }
+      Record record;
+      memcpy(&record, buffer->data + offset, sizeof(record));
+      if (record.format != nullptr) {
+        FormatRecord(message, sizeof(message), record.format,
+                     buffer->data + offset + kHeaderSize);
+        sink(static_cast<LogLevel>(record.level), record.tag, message);
+      }
+      tail += record.size;
+      buffer->tail.store(tail, std::memory_order_release);
+    }
+    buffer->tail.store(tail, std::memory_order_release);
+
+    uint32_t dropped = buffer->dropped.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0) {
+      snprintf(message, sizeof(message), "dropped %u messages", dropped);
+      sink(LogLevel::kWarn, kDroppedTag, message);
+    }
+  }
+
+  // Sleeps until a record is committed, so an idle process is never woken.
+  void DrainThread() {
+    SetThreadName("AsyncLog");
+    while (true) {
+      {
+        std::unique_lock<mutex> lock(wake_mutex_);
+        wake_.wait(lock, [this] {
+          return has_records_.load(std::memory_order_relaxed);
+        });
+      }
+      std::this_thread::sleep_for(kDrainDelay);
+      has_records_.exchange(false);
+      Drain();
+    }
+  }
+
+  std::atomic<LogSink> sink_;
+  pthread_key_t retire_key_;
+  std::once_flag thread_started_;
+  mutex registry_mutex_;
+  std::vector<ThreadBuffer *> buffers_;
+  mutex drain_mutex_;
+  // Set by the first commit after the background thread last drained.
+  std::atomic<bool> has_records_;
+  mutex wake_mutex_;
+  std::condition_variable wake_;
+};
+
+// Never destroyed: other threads may still log while the process exits.
+Logger &GetLogger() {
+  static Logger *logger = new Logger();
+  return *logger;
+}
+
+}  // namespace
+
+void AsyncLog::Write(LogLevel level, const char *tag, const char *fmt,
+                     va_list args) {
+  if (!IsEnabled(level)) return;
+  Logger &logger = GetLogger();
+  va_list measure;
+  va_copy(measure, args);
+  size_t size = kHeaderSize + RecordArgs(fmt, measure, nullptr);
+  va_end(measure);
+
+  // Make room rather than lose an error.
+  if (level == LogLevel::kError) logger.Drain();
+  uint8_t *p = logger.Reserve(size);
+  if (p != nullptr) {
+    Record record = {static_cast<uint32_t>(size), static_cast<int32_t>(level),
+                     tag, fmt};
+    memcpy(p, &record, sizeof(record));
+    RecordArgs(fmt, args, p + kHeaderSize);
+    logger.Commit();
+  }
+  if (level == LogLevel::kError) logger.Drain();
+}
+
+void AsyncLog::V(const char *tag, const char *fmt, ...) {
+  if (!IsEnabled(LogLevel::kVerbose)) return;
+  va_list args;
+  va_start(args, fmt);
+  Write(LogLevel::kVerbose, tag, fmt, args);
+  va_end(args);
+}
+
+void AsyncLog::D(const char *tag, const char *fmt, ...) {
+  if (!IsEnabled(LogLevel::kDebug)) return;
+  va_list args;
+  va_start(args, fmt);
+  Write(LogLevel::kDebug, tag, fmt, args);
+  va_end(args);
+}
+
+void AsyncLog::I(const char *tag, const char *fmt, ...) {
+  if (!IsEnabled(LogLevel::kInfo)) return;
+  va_list args;
+  va_start(args, fmt);
+  Write(LogLevel::kInfo, tag, fmt, args);
+  va_end(args);
+}
+
+void AsyncLog::W(const char *tag, const char *fmt, ...) {
+  if (!IsEnabled(LogLevel::kWarn)) return;
+  va_list args;
+  va_start(args, fmt);
+  Write(LogLevel::kWarn, tag, fmt, args);
+  va_end(args);
+}
+
+void AsyncLog::E(const char *tag, const char *fmt, ...) {
+  if (!IsEnabled(LogLevel::kError)) return;
+  va_list args;
+  va_start(args, fmt);
+  Write(LogLevel::kError, tag, fmt, args);
+  va_end(args);
+}
+
+void Log::V(const char *fmt, ...) {
+  if (!AsyncLog::IsEnabled(LogLevel::kVerbose)) return;
+  va_list args;
+  va_start(args, fmt);
+  AsyncLog::Write(LogLevel::kVerbose, kTag, fmt, args);
+  va_end(args);
+}
+
+void Log::D(const char *fmt, ...) {
+  if (!AsyncLog::IsEnabled(LogLevel::kDebug)) return;
+  va_list args;
+  va_start(args, fmt);
+  AsyncLog::Write(LogLevel::kDebug, kTag, fmt, args);
+  va_end(args);
+}
+
+void Log::I(const char *fmt, ...) {
+  if (!AsyncLog::IsEnabled(LogLevel::kInfo)) return;
+  va_list args;
+  va_start(args, fmt);
+  AsyncLog::Write(LogLevel::kInfo, kTag, fmt, args);
+  va_end(args);
+}
+
+void Log::W(const char *fmt, ...) {
+  if (!AsyncLog::IsEnabled(LogLevel::kWarn)) return;
+  va_list args;
+  va_start(args, fmt);
+  AsyncLog::Write(LogLevel::kWarn, kTag, fmt, args);
+  va_end(args);
+}
+
+void Log::E(const char *fmt, ...) {
+  if (!AsyncLog::IsEnabled(LogLevel::kError)) return;
+  va_list args;
+  va_start(args, fmt);
+  AsyncLog::Write(LogLevel::kError, kTag, fmt, args);
+  va_end(args);
+}
+
+void AsyncLog::Flush() { GetLogger().Drain(); }
+
+LogSink AsyncLog::SetSink(LogSink sink) { return GetLogger().SetSink(sink); }
+
+}  // namespace profiler
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef UTILS_ASYNC_LOG_H_
+#define UTILS_ASYNC_LOG_H_
+
+#include <cstdarg>
+
+namespace profiler {
+
+// Values match android_LogPriority so they can be handed to liblog as is.
+enum class LogLevel : int {
+  kVerbose = 2,
+  kDebug = 3,
+  kInfo = 4,
+  kWarn = 5,
+  kError = 6,
+};
+
+// Calls below this level return before reading their arguments. Release
+// builds keep info and above.
+#if defined(PROFILER_MIN_LOG_LEVEL)
+constexpr LogLevel kMinLogLevel = static_cast<LogLevel>(PROFILER_MIN_LOG_LEVEL);
+#elif defined(NDEBUG)
+constexpr LogLevel kMinLogLevel = LogLevel::kInfo;
+#else
+constexpr LogLevel kMinLogLevel = LogLevel::kVerbose;
+#endif
+
+// Receives each formatted message, normally on the background thread.
+typedef void (*LogSink)(LogLevel level, const char *tag, const char *msg);
+
+// Logging backend for hot paths. A call only records the format string
+// pointer, which must have static storage, and the raw argument values into a
+// lock-free per-thread ring buffer. A background thread formats and writes the
+// messages. If a thread's buffer is full, the message is dropped, and the
+// number of dropped messages is reported later.
+//
+// The arguments are recorded as the format string describes them, so the
+// format attribute below is what keeps a record readable. Strings are copied,
+// since the caller's buffer may be gone by the time they are formatted, and
+// are truncated at 512 bytes. %n is not supported.
+//
+// Errors are written before E returns, together with everything recorded
+// before them, so they are not lost if the process dies right after.
+class AsyncLog {
+ public:
+  static void V(const char *tag, const char *fmt, ...)
+      __attribute__((format(printf, 2, 3)));
+
+  static void D(const char *tag, const char *fmt, ...)
+      __attribute__((format(printf, 2, 3)));
+
+  static void I(const char *tag, const char *fmt, ...)
+      __attribute__((format(printf, 2, 3)));
+
+  static void W(const char *tag, const char *fmt, ...)
+      __attribute__((format(printf, 2, 3)));
+
+  static void E(const char *tag, const char *fmt, ...)
+      __attribute__((format(printf, 2, 3)));
+
+  // Records one message at |level|. |args| must match |fmt|.
+  static void Write(LogLevel level, const char *tag, const char *fmt,
+                    va_list args);
+
+  static constexpr bool IsEnabled(LogLevel level) {
+    return static_cast<int>(level) >= static_cast<int>(kMinLogLevel);
+  }
+
+  // Formats everything recorded so far by any thread and blocks until the
+  // sink has received it.
+  static void Flush();
+
+  // Replaces where messages are written and returns the previous sink. The
+  // default sink is |Log::Sink|.
+  static LogSink SetSink(LogSink sink);
+};
+
+}  // namespace profiler
+
+// Log through these rather than calling AsyncLog directly. The level check is
+// a constant, so a call below |kMinLogLevel| compiles to nothing and its
+// arguments are never evaluated, where AsyncLog::V still costs an
+// out-of-line call.
+#define PROFILER_ASYNC_LOG(level, func, ...)                            \
+  do {                                                                  \
+    if (::profiler::AsyncLog::IsEnabled(::profiler::LogLevel::level)) { \
+      ::profiler::AsyncLog::func(__VA_ARGS__);                          \
+    }                                                                   \
+  } while (0)
+
+#define ASYNC_LOGV(...) PROFILER_ASYNC_LOG(kVerbose, V, __VA_ARGS__)
+#define ASYNC_LOGD(...) PROFILER_ASYNC_LOG(kDebug, D, __VA_ARGS__)
+#define ASYNC_LOGI(...) PROFILER_ASYNC_LOG(kInfo, I, __VA_ARGS__)
+#define ASYNC_LOGW(...) PROFILER_ASYNC_LOG(kWarn, W, __VA_ARGS__)
+#define ASYNC_LOGE(...) PROFILER_ASYNC_LOG(kError, E, __VA_ARGS__)
+
+#endif  // UTILS_ASYNC_LOG_H_
@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "async_log.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using profiler::AsyncLog;
+using profiler::LogLevel;
+using profiler::LogSink;
+using std::string;
+using std::vector;
+
+namespace {
+
+std::mutex captured_mutex;
+vector<string> captured;
+
+void CaptureSink(LogLevel level, const char *tag, const char *msg) {
+  std::lock_guard<std::mutex> lock(captured_mutex);
+  captured.push_back(string(1, "??VDIWE"[static_cast<int>(level)]) + "/" +
+                     tag + ": " + msg);
+}
+
+// Routes messages into |captured| for the lifetime of the test.
+class AsyncLogTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    AsyncLog::Flush();
+    previous_ = AsyncLog::SetSink(&CaptureSink);
+    captured.clear();
+  }
+
+  void TearDown() override {
+    AsyncLog::Flush();
+    AsyncLog::SetSink(previous_);
+  }
+
+  LogSink previous_;
+};
+
+}  // namespace
+
+TEST_F(AsyncLogTest, FormatsScalarsAndStringsLazily) {
+  char name[] = "hooked";
+  AsyncLog::W("Tag", "%s %d %u %lld %.2f %c %p", name, -5, 7u, 1LL << 40,
+              2.5f, 'x', reinterpret_cast<void *>(0x1234));
+  // The caller's buffer may change before the message is formatted.
+  name[0] = 'X';
+  AsyncLog::W("Tag", "no arguments 100%%");
+  AsyncLog::Flush();
+
+  ASSERT_EQ(captured.size(), 2u);
+  EXPECT_EQ(captured[0], "W/Tag: hooked -5 7 1099511627776 2.50 x 0x1234");
+  EXPECT_EQ(captured[1], "W/Tag: no arguments 100%");
+}
+
+TEST_F(AsyncLogTest, FormatsEveryArgumentKind) {
+  AsyncLog::W("Tag", "[%*d|%-*s|%.*f|%.*s]", 4, 7, 3, "ab", 1, 3.14159, -1,
+              "all");
+  AsyncLog::W("Tag", "%zu %ld %hhd %jd %td %Lf %5.1e %#x %%",
+              static_cast<size_t>(1) << 33, -3L, static_cast<signed char>(-1),
+              static_cast<intmax_t>(9), static_cast<ptrdiff_t>(-2), 0.5L,
+              1234.5, 255);
+  AsyncLog::Flush();
+
+  ASSERT_EQ(captured.size(), 2u);
+  EXPECT_EQ(captured[0], "W/Tag: [   7|ab |3.1|all]");
+  EXPECT_EQ(captured[1],
+            "W/Tag: 8589934592 -3 -1 9 -2 0.500000 1.2e+03 0xff %");
+}
+
+TEST_F(AsyncLogTest, NullAndLongStrings) {
+  string longString(2000, 'a');
+  const char *volatile missing = nullptr;
+  AsyncLog::I("Tag", "[%s]", missing);
+  AsyncLog::I("Tag", "%s", longString.c_str());
+  AsyncLog::Flush();
+
+  ASSERT_EQ(captured.size(), 2u);
+  EXPECT_EQ(captured[0], "I/Tag: []");
+  EXPECT_EQ(captured[1], "I/Tag: " + string(512, 'a'));
+}
+
+TEST_F(AsyncLogTest, ErrorsAreWrittenBeforeReturning) {
+  AsyncLog::W("Tag", "before");
+  AsyncLog::E("Tag", "error %d", 1);
+
+  std::lock_guard<std::mutex> lock(captured_mutex);
+  ASSERT_EQ(captured.size(), 2u);
+  EXPECT_EQ(captured[0], "W/Tag: before");
+  EXPECT_EQ(captured[1], "E/Tag: error 1");
+}
+
+TEST_F(AsyncLogTest, BackgroundThreadWakesForNewRecords) {
+  // Let the background thread go idle first.
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  AsyncLog::W("Tag", "idle");
+  for (int i = 0; i < 200; i++) {
+    {
+      std::lock_guard<std::mutex> lock(captured_mutex);
+      if (!captured.empty()) break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  std::lock_guard<std::mutex> lock(captured_mutex);
+  ASSERT_EQ(captured.size(), 1u);
+  EXPECT_EQ(captured[0], "W/Tag: idle");
+}
+
+TEST_F(AsyncLogTest, LevelsBelowMinimumAreDropped) {
+  static_assert(AsyncLog::IsEnabled(LogLevel::kError),
+                "errors are always logged");
+  AsyncLog::V("Tag", "verbose");
+  AsyncLog::D("Tag", "debug");
+  AsyncLog::Flush();
+
+  size_t expected = (AsyncLog::IsEnabled(LogLevel::kVerbose) ? 1 : 0) +
+                    (AsyncLog::IsEnabled(LogLevel::kDebug) ? 1 : 0);
+  EXPECT_EQ(captured.size(), expected);
+}
+
+TEST_F(AsyncLogTest, MacrosSkipArgumentsBelowMinimum) {
+  int evaluated = 0;
+  ASYNC_LOGV("Tag", "verbose %d", ++evaluated);
+  ASYNC_LOGD("Tag", "debug %d", ++evaluated);
+  ASYNC_LOGE("Tag", "error %d", ++evaluated);
+  AsyncLog::Flush();
+
+  int expected = (AsyncLog::IsEnabled(LogLevel::kVerbose) ? 1 : 0) +
+                 (AsyncLog::IsEnabled(LogLevel::kDebug) ? 1 : 0) + 1;
+  EXPECT_EQ(evaluated, expected);
+  std::lock_guard<std::mutex> lock(captured_mutex);
+  ASSERT_EQ(captured.size(), static_cast<size_t>(expected));
+  EXPECT_EQ(captured.back(), "E/Tag: error " + std::to_string(expected));
+}
+
+TEST_F(AsyncLogTest, KeepsPerThreadOrderAcrossWraps) {
+  const int kThreads = 4;
+  const int kMessages = 20000;
+  vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([t] {
+      for (int i = 0; i < kMessages; i++) {
+        AsyncLog::W("T", "%d %d", t, i);
+        // Give the background thread room so nothing is dropped.
+        if (i % 64 == 0) AsyncLog::Flush();
+      }
+    });
+  }
+  for (auto &thread : threads) thread.join();
+  AsyncLog::Flush();
+
+  vector<int> next(kThreads, 0);
+  for (const string &line : captured) {
+    int t, i;
+    ASSERT_EQ(sscanf(line.c_str(), "W/T: %d %d", &t, &i), 2) << line;
+    EXPECT_EQ(i, next[t]);
+    next[t] = i + 1;
+  }
+  for (int t = 0; t < kThreads; t++) EXPECT_EQ(next[t], kMessages);
+}
+
+TEST_F(AsyncLogTest, ReportsDroppedMessages) {
+  // Nothing drains while this thread fills its own buffer.
+  std::thread writer([] {
+    for (int i = 0; i < 10000; i++) AsyncLog::W("T", "%d", i);
+  });
+  writer.join();
+  AsyncLog::Flush();
+
+  ASSERT_FALSE(captured.empty());
+  const string &last = captured.back();
+  EXPECT_EQ(last.find("W/AsyncLog: dropped "), 0u) << last;
+}
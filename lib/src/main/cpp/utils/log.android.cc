@@ -19,39 +19,8 @@
 
 namespace profiler {
 
-void Log::V(const char *fmt, ...) {
-  va_list args;
-  va_start(args, fmt);
-  __android_log_vprint(ANDROID_LOG_VERBOSE, kTag, fmt, args);
-  va_end(args);
-}
-
-void Log::D(const char *fmt, ...) {
-  va_list args;
-  va_start(args, fmt);
-  __android_log_vprint(ANDROID_LOG_DEBUG, kTag, fmt, args);
-  va_end(args);
-}
-
-void Log::I(const char *fmt, ...) {
-  va_list args;
-  va_start(args, fmt);
-  __android_log_vprint(ANDROID_LOG_INFO, kTag, fmt, args);
-  va_end(args);
-}
-
-void Log::W(const char *fmt, ...) {
-  va_list args;
-  va_start(args, fmt);
-  __android_log_vprint(ANDROID_LOG_WARN, kTag, fmt, args);
-  va_end(args);
-}
-
-void Log::E(const char *fmt, ...) {
-  va_list args;
-  va_start(args, fmt);
-  __android_log_vprint(ANDROID_LOG_ERROR, kTag, fmt, args);
-  va_end(args);
+void Log::Sink(LogLevel level, const char *tag, const char *msg) {
+  __android_log_write(static_cast<int>(level), tag, msg);
 }
 
 }  // namespace profiler
@@ -18,45 +18,9 @@
 
 namespace profiler {
 
-void Log::V(const char *fmt, ...) {
-  va_list args;
-  va_start(args, fmt);
-  Handle('V', fmt, args);
-  va_end(args);
-}
-
-void Log::D(const char *fmt, ...) {
-  va_list args;
-  va_start(args, fmt);
-  Handle('D', fmt, args);
-  va_end(args);
-}
-
-void Log::I(const char *fmt, ...) {
-  va_list args;
-  va_start(args, fmt);
-  Handle('I', fmt, args);
-  va_end(args);
-}
-
-void Log::W(const char *fmt, ...) {
-  va_list args;
-  va_start(args, fmt);
-  Handle('W', fmt, args);
-  va_end(args);
-}
-
-void Log::E(const char *fmt, ...) {
-  va_list args;
-  va_start(args, fmt);
-  Handle('E', fmt, args);
-  va_end(args);
-}
-
-void Log::Handle(const char level, const char *fmt, va_list args) {
-  printf("%s[%c]: ", kTag, level);
-  vprintf(fmt, args);
-  printf("\n");
+void Log::Sink(LogLevel level, const char *tag, const char *msg) {
+  static const char kLevels[] = "??VDIWE";
+  printf("%s[%c]: %s\n", tag, kLevels[static_cast<int>(level)], msg);
 }
 
 }  // namespace profiler
@@ -17,12 +17,15 @@
 #ifndef UTILS_LOG_H_
 #define UTILS_LOG_H_
 
-#include <cstdarg>
+#include "utils/async_log.h"
 
 namespace profiler {
 
 // Logging methods that mimic Android's log library. You do not need to add your
 // own newlines as these logging methods will do that automatically.
+//
+// Messages are recorded by |AsyncLog| and formatted on its background thread.
+// Verbose and debug calls do nothing in release builds.
 class Log {
  public:
   // Log a message at the verbose level
@@ -40,9 +43,11 @@ class Log {
   // Log a message at the error level
   static void E(const char *msg, ...) __attribute__((format(printf, 1, 2)));
 
- private:
-  static void Handle(const char level, const char *fmt, va_list args);
+  // Writes one formatted message to the platform log. This is the default
+  // sink of |AsyncLog|.
+  static void Sink(LogLevel level, const char *tag, const char *msg);
 
+ private:
   static constexpr const char *const kTag = "StudioProfiler";
 };
 
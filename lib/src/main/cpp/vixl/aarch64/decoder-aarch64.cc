@@ -24,6 +24,8 @@
 // OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <algorithm>
+
 #include "../globals-vixl.h"
 #include "../utils-vixl.h"
 
@@ -132,13 +134,13 @@ void Decoder::AppendVisitor(DecoderVisitor* new_visitor) {
 
 
 void Decoder::PrependVisitor(DecoderVisitor* new_visitor) {
-  visitors_.push_front(new_visitor);
+  visitors_.insert(visitors_.begin(), new_visitor);
 }
 
 
 void Decoder::InsertVisitorBefore(DecoderVisitor* new_visitor,
                                   DecoderVisitor* registered_visitor) {
-  std::list<DecoderVisitor*>::iterator it;
+  std::vector<DecoderVisitor*>::iterator it;
   for (it = visitors_.begin(); it != visitors_.end(); it++) {
     if (*it == registered_visitor) {
       visitors_.insert(it, new_visitor);
@@ -154,7 +156,7 @@ void Decoder::InsertVisitorBefore(DecoderVisitor* new_visitor,
 
 void Decoder::InsertVisitorAfter(DecoderVisitor* new_visitor,
                                  DecoderVisitor* registered_visitor) {
-  std::list<DecoderVisitor*>::iterator it;
+  std::vector<DecoderVisitor*>::iterator it;
   for (it = visitors_.begin(); it != visitors_.end(); it++) {
     if (*it == registered_visitor) {
       it++;
@@ -170,7 +172,8 @@ void Decoder::InsertVisitorAfter(DecoderVisitor* new_visitor,
 
 
 void Decoder::RemoveVisitor(DecoderVisitor* visitor) {
-  visitors_.remove(visitor);
+  visitors_.erase(std::remove(visitors_.begin(), visitors_.end(), visitor),
+                  visitors_.end());
 }
 
 
@@ -523,7 +526,6 @@ void Decoder::DecodeDataProcessing(const Instruction* instr) {
         case 6: {
           if (instr->ExtractBit(29) == 0x1) {
             VisitUnallocated(instr);
-            VIXL_FALLTHROUGH();
           } else {
             if (instr->ExtractBit(30) == 0) {
               if ((instr->ExtractBit(15) == 0x1) ||
@@ -554,8 +556,8 @@ void Decoder::DecodeDataProcessing(const Instruction* instr) {
                 VisitDataProcessing1Source(instr);
               }
             }
-            break;
           }
+          break;
         }
         case 1:
         case 3:
@@ -1018,12 +1020,58 @@ void Decoder::DecodeNEONScalarDataProcessing(const Instruction* instr) {
   void Decoder::Visit##A(const Instruction* instr) {            \
     VIXL_ASSERT(((A##FMask == 0) && (A##Fixed == 0)) ||         \
                 (instr->Mask(A##FMask) == A##Fixed));           \
-    std::list<DecoderVisitor*>::iterator it;                    \
-    for (it = visitors_.begin(); it != visitors_.end(); it++) { \
+    if (static_callers_ != NULL) {                              \
+      static_callers_[kVisit##A](static_visitor_, instr);       \
+      return;                                                   \
+    }                                                           \
+    DecoderVisitor* const* it = visitors_.data();               \
+    DecoderVisitor* const* end = it + visitors_.size();         \
+    for (; it != end; it++) {                                   \
       (*it)->Visit##A(instr);                                   \
     }                                                           \
   }
 VISITOR_LIST(DEFINE_VISITOR_CALLERS)
 #undef DEFINE_VISITOR_CALLERS
+
+
+const Decoder::VisitorCaller Decoder::kVisitorCallers[] = {
+#define DEFINE_VISITOR_CALLER_ENTRY(A) &Decoder::Visit##A,
+    VISITOR_LIST(DEFINE_VISITOR_CALLER_ENTRY)
+#undef DEFINE_VISITOR_CALLER_ENTRY
+};
+
+
+namespace {
+
+// Records which leaf of the decode tree was reached.
+class VisitorIdRecorder {
+ public:
+  VisitorIdRecorder() : id_(Decoder::kNumberOfVisitorIds) {}
+
+#define DECLARE(A)                                    \
+  void Visit##A(const Instruction* instr) {           \
+    USE(instr);                                       \
+    VIXL_ASSERT(id_ == Decoder::kNumberOfVisitorIds); \
+    id_ = Decoder::kVisit##A;                         \
+  }
+  VISITOR_LIST(DECLARE)
+#undef DECLARE
+
+  Decoder::VisitorId GetId() const { return id_; }
+
+ private:
+  Decoder::VisitorId id_;
+};
+
+}  // namespace
+
+
+Decoder::VisitorId Decoder::ResolveId(const Instruction* instr) {
+  // Every path through the decode tree ends in exactly one Visit##A call.
+  VisitorIdRecorder recorder;
+  DecodeWith(&recorder, instr);
+  VIXL_ASSERT(recorder.GetId() < kNumberOfVisitorIds);
+  return recorder.GetId();
+}
 }  // namespace aarch64
 }  // namespace vixl
@@ -27,7 +27,7 @@
 #ifndef VIXL_AARCH64_DECODER_AARCH64_H_
 #define VIXL_AARCH64_DECODER_AARCH64_H_
 
-#include <list>
+#include <vector>
 
 #include "../globals-vixl.h"
 
@@ -149,22 +149,88 @@ class DecoderVisitor {
 };
 
 
+// Type-erased, non-virtual entry point into one Visit##A method of a visitor.
+typedef void (*StaticVisitorCaller)(void* visitor, const Instruction* instr);
+
+// The entry points for a concrete visitor type V, indexed by
+// Decoder::VisitorId. The qualified calls bypass the vtable, so the visitor's
+// methods can be inlined into them.
+template <typename V>
+struct StaticVisitorTable {
+#define DECLARE(A)                                                  \
+  static void Visit##A(void* visitor, const Instruction* instr) {  \
+    static_cast<V*>(visitor)->V::Visit##A(instr);                   \
+  }
+  VISITOR_LIST(DECLARE)
+#undef DECLARE
+
+  static const StaticVisitorCaller kCallers[];
+};
+
+template <typename V>
+const StaticVisitorCaller StaticVisitorTable<V>::kCallers[] = {
+#define DECLARE(A) &StaticVisitorTable<V>::Visit##A,
+    VISITOR_LIST(DECLARE)
+#undef DECLARE
+};
+
+
 class Decoder {
  public:
-  Decoder() {}
+  Decoder() : static_callers_(NULL), static_visitor_(NULL) {}
+
+  // Identifies a leaf of the decode tree, that is one Visit##A method.
+  enum VisitorId {
+#define DECLARE(A) kVisit##A,
+    VISITOR_LIST(DECLARE)
+#undef DECLARE
+    kNumberOfVisitorIds
+  };
+
+  // One of the Visit##A members below, which forward an instruction to every
+  // registered visitor.
+  typedef void (Decoder::*VisitorCaller)(const Instruction* instr);
 
   // Top-level wrappers around the actual decoding function.
   void Decode(const Instruction* instr) {
-    std::list<DecoderVisitor*>::iterator it;
-    for (it = visitors_.begin(); it != visitors_.end(); it++) {
-      VIXL_ASSERT((*it)->IsConstVisitor());
+#ifdef VIXL_DEBUG
+    for (size_t i = 0; i < visitors_.size(); i++) {
+      VIXL_ASSERT(visitors_[i]->IsConstVisitor());
     }
+#endif
     DecodeInstruction(instr);
   }
   void Decode(Instruction* instr) {
     DecodeInstruction(const_cast<const Instruction*>(instr));
   }
 
+  // Walk the decode tree for `instr` without calling any visitor, and return
+  // the leaf that was reached. As long as the instruction bits do not change,
+  // `(decoder.*caller)(instr)` is equivalent to `decoder.Decode(instr)`, so
+  // callers can cache the result to skip decoding.
+  VisitorCaller Resolve(const Instruction* instr) {
+    return kVisitorCallers[ResolveId(instr)];
+  }
+  VisitorId ResolveId(const Instruction* instr);
+
+  // Decode and call the matching Visit##A method of `visitor` only, bypassing
+  // the registered visitors and the vtable. Use this when a single visitor of
+  // a known type is needed, for example for bulk disassembly; pass the most
+  // derived type as V. `visitor` must not call back into this decoder.
+  template <typename V>
+  void DecodeWith(V* visitor, const Instruction* instr) {
+    StaticDispatchScope scope(this, StaticVisitorTable<V>::kCallers, visitor);
+    DecodeInstruction(instr);
+  }
+
+  template <typename V, typename T>
+  void DecodeWith(V* visitor, T start, T end) {
+    StaticDispatchScope scope(this, StaticVisitorTable<V>::kCallers, visitor);
+    for (T instr = start; instr < end; instr = instr->GetNextInstruction()) {
+      DecodeInstruction(instr);
+    }
+  }
+
   // Decode all instructions from start (inclusive) to end (exclusive).
   template <typename T>
   void Decode(T start, T end) {
@@ -201,7 +267,7 @@ class Decoder {
   //   V1, V3, V4, V2, V1, V2
   //
   // For more complex modifications of the order of registered visitors, one can
-  // directly access and modify the list of visitors via the `visitors()'
+  // directly access and modify the array of visitors via the `visitors()'
   // accessor.
   void InsertVisitorBefore(DecoderVisitor* new_visitor,
                            DecoderVisitor* registered_visitor);
@@ -217,7 +283,7 @@ class Decoder {
 #undef DECLARE
 
 
-  std::list<DecoderVisitor*>* visitors() { return &visitors_; }
+  std::vector<DecoderVisitor*>* visitors() { return &visitors_; }
 
  private:
   // Decodes an instruction and calls the visitor functions registered with the
@@ -280,8 +346,38 @@ class Decoder {
   void DecodeNEONScalarDataProcessing(const Instruction* instr);
 
  private:
-  // Visitors are registered in a list.
-  std::list<DecoderVisitor*> visitors_;
+  static const VisitorCaller kVisitorCallers[];
+
+  // Visitors are registered in a contiguous array, so that dispatching an
+  // instruction to them does not chase list nodes.
+  std::vector<DecoderVisitor*> visitors_;
+
+  // While set, the Visit##A members call `static_callers_` on
+  // `static_visitor_` instead of the registered visitors.
+  class StaticDispatchScope {
+   public:
+    StaticDispatchScope(Decoder* decoder,
+                        const StaticVisitorCaller* callers,
+                        void* visitor)
+        : decoder_(decoder),
+          saved_callers_(decoder->static_callers_),
+          saved_visitor_(decoder->static_visitor_) {
+      decoder_->static_callers_ = callers;
+      decoder_->static_visitor_ = visitor;
+    }
+    ~StaticDispatchScope() {
+      decoder_->static_callers_ = saved_callers_;
+      decoder_->static_visitor_ = saved_visitor_;
+    }
+
+   private:
+    Decoder* decoder_;
+    const StaticVisitorCaller* saved_callers_;
+    void* saved_visitor_;
+  };
+
+  const StaticVisitorCaller* static_callers_;
+  void* static_visitor_;
 };
 
 }  // namespace aarch64
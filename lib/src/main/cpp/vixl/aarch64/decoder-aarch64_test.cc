@@ -0,0 +1,196 @@
+#include "aarch64/decoder-aarch64.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "aarch64/disasm-aarch64.h"
+#include "aarch64/macro-assembler-aarch64.h"
+
+namespace vixl {
+namespace aarch64 {
+namespace {
+
+// Records every leaf a registered decoder reaches, through the vtable.
+class LeafRecorder : public DecoderVisitor {
+ public:
+  explicit LeafRecorder(std::string* log = NULL, const char* name = "")
+      : log_(log), name_(name) {}
+
+#define DECLARE(A)                                 \
+  virtual void Visit##A(const Instruction* instr) { \
+    USE(instr);                                    \
+    leaves_.push_back(Decoder::kVisit##A);         \
+    if (log_ != NULL) log_->append(name_);         \
+  }
+  VISITOR_LIST(DECLARE)
+#undef DECLARE
+
+  std::vector<Decoder::VisitorId>* leaves() { return &leaves_; }
+
+ private:
+  std::vector<Decoder::VisitorId> leaves_;
+  std::string* log_;
+  const char* name_;
+};
+
+// A fixed pseudo-random sample of the whole encoding space.
+std::vector<Instr> RandomEncodings(size_t count) {
+  std::vector<Instr> encodings;
+  uint32_t state = 0x2545f491;
+  for (size_t i = 0; i < count; i++) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    encodings.push_back(state);
+  }
+  return encodings;
+}
+
+// Real code, so that the common leaves are covered too.
+std::vector<Instr> GeneratedEncodings() {
+  MacroAssembler masm;
+  Label loop;
+  masm.Mov(x0, 0x123456789abcdef0);
+  masm.Bind(&loop);
+  masm.Add(x1, x1, Operand(x2, LSL, 3));
+  masm.Ldr(x3, MemOperand(sp, 16, PreIndex));
+  masm.Stp(x4, x5, MemOperand(sp, -32));
+  masm.Fadd(d0, d1, d2);
+  masm.Fmov(s3, 1.5f);
+  masm.Csel(x6, x7, x8, eq);
+  masm.Udiv(w9, w10, w11);
+  masm.Rbit(x12, x13);
+  masm.Cbnz(x1, &loop);
+  masm.Blr(x16);
+  masm.Ret();
+  masm.FinalizeCode();
+  const Instr* start = masm.GetBuffer()->GetStartAddress<const Instr*>();
+  return std::vector<Instr>(start, start + masm.GetSizeOfCodeGenerated() /
+                                               kInstructionSize);
+}
+
+std::vector<Instr> AllEncodings() {
+  std::vector<Instr> encodings = GeneratedEncodings();
+  std::vector<Instr> random = RandomEncodings(50000);
+  encodings.insert(encodings.end(), random.begin(), random.end());
+  return encodings;
+}
+
+const Instruction* AsInstruction(const Instr* bits) {
+  return reinterpret_cast<const Instruction*>(bits);
+}
+
+}  // namespace
+
+TEST(DecoderTest, ResolveIdMatchesTheLeafReached) {
+  Decoder decoder;
+  LeafRecorder recorder;
+  decoder.AppendVisitor(&recorder);
+
+  std::vector<Instr> encodings = AllEncodings();
+  for (size_t i = 0; i < encodings.size(); i++) {
+    const Instruction* instr = AsInstruction(&encodings[i]);
+    recorder.leaves()->clear();
+    decoder.Decode(instr);
+    ASSERT_EQ(recorder.leaves()->size(), 1u) << std::hex << encodings[i];
+    EXPECT_EQ(decoder.ResolveId(instr), recorder.leaves()->at(0))
+        << std::hex << encodings[i];
+
+    // The resolved member forwards to the registered visitors.
+    (decoder.*decoder.Resolve(instr))(instr);
+    ASSERT_EQ(recorder.leaves()->size(), 2u);
+    EXPECT_EQ(recorder.leaves()->at(1), recorder.leaves()->at(0));
+  }
+}
+
+TEST(DecoderTest, DecodeWithMatchesDecode) {
+  Decoder decoder;
+  Disassembler registered;
+  decoder.AppendVisitor(&registered);
+  Disassembler direct;
+
+  std::vector<Instr> encodings = AllEncodings();
+  for (size_t i = 0; i < encodings.size(); i++) {
+    const Instruction* instr = AsInstruction(&encodings[i]);
+    decoder.Decode(instr);
+    decoder.DecodeWith(&direct, instr);
+    ASSERT_STREQ(direct.GetOutput(), registered.GetOutput())
+        << std::hex << encodings[i];
+  }
+}
+
+TEST(DecoderTest, DecodeWithBypassesRegisteredVisitors) {
+  Decoder decoder;
+  LeafRecorder registered;
+  decoder.AppendVisitor(&registered);
+  LeafRecorder direct;
+  std::vector<Instr> encodings = GeneratedEncodings();
+
+  decoder.DecodeWith(&direct,
+                     AsInstruction(&encodings.front()),
+                     AsInstruction(&encodings.back() + 1));
+  EXPECT_TRUE(registered.leaves()->empty());
+  EXPECT_EQ(direct.leaves()->size(), encodings.size());
+
+  // The registered visitors are back once DecodeWith returns.
+  decoder.Decode(AsInstruction(&encodings.front()));
+  EXPECT_EQ(registered.leaves()->size(), 1u);
+}
+
+// Two-source data processing with bit 29 set. It used to fall through into
+// the next case and visit Unallocated twice.
+TEST(DecoderTest, DataProcessingBit29IsUnallocatedOnce) {
+  Decoder decoder;
+  LeafRecorder recorder;
+  decoder.AppendVisitor(&recorder);
+
+  const Instr udiv = 0x1ac20820;  // udiv w0, w1, w2
+  const Instr bit29 = udiv | (1 << 29);
+  decoder.Decode(AsInstruction(&udiv));
+  decoder.Decode(AsInstruction(&bit29));
+
+  ASSERT_EQ(recorder.leaves()->size(), 2u);
+  EXPECT_EQ(recorder.leaves()->at(0), Decoder::kVisitDataProcessing2Source);
+  EXPECT_EQ(recorder.leaves()->at(1), Decoder::kVisitUnallocated);
+  EXPECT_EQ(decoder.ResolveId(AsInstruction(&bit29)),
+            Decoder::kVisitUnallocated);
+}
+
+TEST(DecoderTest, VisitorsAreCalledInRegistrationOrder) {
+  std::string log;
+  LeafRecorder v1(&log, "1");
+  LeafRecorder v2(&log, "2");
+  LeafRecorder v3(&log, "3");
+  LeafRecorder v4(&log, "4");
+  const Instr nop = 0xd503201f;
+
+  // The example from decoder-aarch64.h.
+  Decoder decoder;
+  decoder.AppendVisitor(&v1);
+  decoder.AppendVisitor(&v2);
+  decoder.PrependVisitor(&v2);
+  decoder.AppendVisitor(&v3);
+  decoder.Decode(AsInstruction(&nop));
+  EXPECT_EQ(log, "2123");
+
+  log.clear();
+  decoder.visitors()->clear();
+  decoder.AppendVisitor(&v1);
+  decoder.AppendVisitor(&v2);
+  decoder.AppendVisitor(&v1);
+  decoder.AppendVisitor(&v2);
+  decoder.InsertVisitorAfter(&v3, &v1);
+  decoder.InsertVisitorBefore(&v4, &v2);
+  decoder.Decode(AsInstruction(&nop));
+  EXPECT_EQ(log, "134212");
+
+  log.clear();
+  decoder.RemoveVisitor(&v1);
+  decoder.Decode(AsInstruction(&nop));
+  EXPECT_EQ(log, "3422");
+}
+
+}  // namespace aarch64
+}  // namespace vixl
@@ -27,6 +27,8 @@
 #ifndef VIXL_AARCH64_INSTRUMENT_AARCH64_H_
 #define VIXL_AARCH64_INSTRUMENT_AARCH64_H_
 
+#include <list>
+
 #include "../globals-vixl.h"
 #include "../utils-vixl.h"
 
@@ -107,6 +107,9 @@ Simulator::Simulator(Decoder* decoder, FILE* stream)
 
   instrumentation_ = NULL;
 
+  predecode_cache_ = NULL;
+  SetPredecodeCache(true);
+
   // Print a warning about exclusive-access instructions, but only the first
   // time they are encountered. This warning can be silenced using
   // SilenceExclusiveAccessWarning().
@@ -152,6 +155,30 @@ Simulator::~Simulator() {
 
   decoder_->RemoveVisitor(instrumentation_);
   delete instrumentation_;
+
+  delete[] predecode_cache_;
+}
+
+
+void Simulator::SetPredecodeCache(bool value) {
+  if (value == IsPredecodeCacheEnabled()) return;
+  if (value) {
+    predecode_cache_ = new PredecodedInstruction[kPredecodeCacheSize];
+    InvalidatePredecodeCache();
+  } else {
+    delete[] predecode_cache_;
+    predecode_cache_ = NULL;
+  }
+}
+
+
+void Simulator::InvalidatePredecodeCache() {
+  if (predecode_cache_ == NULL) return;
+  for (int i = 0; i < kPredecodeCacheSize; i++) {
+    predecode_cache_[i].pc = NULL;
+    predecode_cache_[i].bits = 0;
+    predecode_cache_[i].caller = NULL;
+  }
 }
 
 
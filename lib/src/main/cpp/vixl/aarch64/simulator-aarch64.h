@@ -726,7 +726,12 @@ class Simulator : public DecoderVisitor {
     //  3. The Simulator (`this`).
     // User can add additional visitors at any point, but the Simulator requires
     // that the ordering above is preserved.
-    decoder_->Decode(pc_);
+    if (predecode_cache_ != NULL) {
+      PredecodedInstruction* entry = LookupPredecoded(pc_);
+      (decoder_->*entry->caller)(pc_);
+    } else {
+      decoder_->Decode(pc_);
+    }
     IncrementPc();
     LogAllWrittenRegisters();
 
@@ -1577,6 +1582,15 @@ class Simulator : public DecoderVisitor {
     SetInstructionStats(value);
   }
 
+  // The predecode cache remembers, per instruction address, which visitor
+  // method the decoder reached, so hot code is not decoded again. It is
+  // enabled by default. Entries are checked against the current instruction
+  // bits, so code that is rewritten in place is decoded again.
+  // InvalidatePredecodeCache() only drops the entries.
+  bool IsPredecodeCacheEnabled() const { return predecode_cache_ != NULL; }
+  void SetPredecodeCache(bool value);
+  void InvalidatePredecodeCache();
+
   // Clear the simulated local monitor to force the next store-exclusive
   // instruction to fail.
   void ClearLocalMonitor() { local_monitor_.Clear(); }
@@ -3192,6 +3206,31 @@ class Simulator : public DecoderVisitor {
   byte* stack_limit_;
 
   Decoder* decoder_;
+
+  // A direct-mapped cache indexed by instruction address. An entry is valid
+  // for `pc` only while the instruction at `pc` still has the bits it was
+  // resolved from.
+  struct PredecodedInstruction {
+    const Instruction* pc;
+    Instr bits;
+    Decoder::VisitorCaller caller;
+  };
+  static const int kPredecodeCacheSize = 4096;
+  PredecodedInstruction* predecode_cache_;
+
+  PredecodedInstruction* LookupPredecoded(const Instruction* pc) {
+    uintptr_t index = reinterpret_cast<uintptr_t>(pc) >> kInstructionSizeLog2;
+    PredecodedInstruction* entry =
+        &predecode_cache_[index & (kPredecodeCacheSize - 1)];
+    Instr bits = pc->GetInstructionBits();
+    if ((entry->pc != pc) || (entry->bits != bits)) {
+      entry->pc = pc;
+      entry->bits = bits;
+      entry->caller = decoder_->Resolve(pc);
+    }
+    return entry;
+  }
+
   // Indicates if the pc has been modified by the instruction and should not be
   // automatically incremented.
   bool pc_modified_;
@@ -0,0 +1,88 @@
+#include "aarch64/simulator-aarch64.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+#include "aarch64/macro-assembler-aarch64.h"
+
+#ifdef VIXL_INCLUDE_SIMULATOR_AARCH64
+
+namespace vixl {
+namespace aarch64 {
+namespace {
+
+// Sums 1..count into x0.
+void GenerateSumLoop(MacroAssembler* masm, int count) {
+  Label loop;
+  masm->Mov(x0, 0);
+  masm->Mov(x1, count);
+  masm->Bind(&loop);
+  masm->Add(x0, x0, x1);
+  masm->Sub(x1, x1, 1);
+  masm->Cbnz(x1, &loop);
+  masm->Ret();
+  masm->FinalizeCode();
+}
+
+uint64_t RunCode(Simulator* simulator, const MacroAssembler& masm) {
+  simulator->RunFrom(masm.GetBuffer().GetStartAddress<const Instruction*>());
+  return simulator->ReadXRegister(0);
+}
+
+Instr Encode(void (*emit)(MacroAssembler*)) {
+  MacroAssembler masm;
+  emit(&masm);
+  masm.FinalizeCode();
+  return *masm.GetBuffer()->GetStartAddress<const Instr*>();
+}
+
+}  // namespace
+
+TEST(SimulatorPredecodeTest, CacheDoesNotChangeResults) {
+  MacroAssembler masm;
+  GenerateSumLoop(&masm, 1000);
+  Decoder decoder;
+  Simulator simulator(&decoder);
+
+  ASSERT_TRUE(simulator.IsPredecodeCacheEnabled());
+  uint64_t cached = RunCode(&simulator, masm);
+  // The second run is served from the cache from the first instruction on.
+  uint64_t warm = RunCode(&simulator, masm);
+
+  simulator.SetPredecodeCache(false);
+  ASSERT_FALSE(simulator.IsPredecodeCacheEnabled());
+  uint64_t uncached = RunCode(&simulator, masm);
+
+  EXPECT_EQ(cached, 500500u);
+  EXPECT_EQ(warm, cached);
+  EXPECT_EQ(uncached, cached);
+
+  simulator.SetPredecodeCache(true);
+  EXPECT_EQ(RunCode(&simulator, masm), cached);
+}
+
+TEST(SimulatorPredecodeTest, CodeRewrittenInPlaceIsDecodedAgain) {
+  MacroAssembler masm;
+  masm.Mov(x0, 1);
+  masm.Ret();
+  masm.FinalizeCode();
+  Decoder decoder;
+  Simulator simulator(&decoder);
+  EXPECT_EQ(RunCode(&simulator, masm), 1u);
+
+  // Same visitor, different operand.
+  Instr movz = Encode([](MacroAssembler* m) { m->Mov(x0, 2); });
+  memcpy(masm.GetBuffer()->GetStartAddress<Instr*>(), &movz, sizeof(movz));
+  EXPECT_EQ(RunCode(&simulator, masm), 2u);
+
+  // A different visitor at the same address.
+  Instr add = Encode([](MacroAssembler* m) { m->Add(x0, x0, 40); });
+  memcpy(masm.GetBuffer()->GetStartAddress<Instr*>(), &add, sizeof(add));
+  EXPECT_EQ(RunCode(&simulator, masm), 42u);
+}
+
+}  // namespace aarch64
+}  // namespace vixl
+
+#endif  // VIXL_INCLUDE_SIMULATOR_AARCH64
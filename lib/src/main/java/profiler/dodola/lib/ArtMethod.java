@@ -178,6 +178,44 @@ public class ArtMethod {
         }
     }
 
+    /**
+     * get the dex shorty of the method/constructor, return type first, every reference is 'L'
+     *
+     * @return the shorty, such as "VJLD"
+     */
+    public String getShorty() {
+        StringBuilder shorty = new StringBuilder();
+        shorty.append(constructor != null ? 'V' : shortyOf(method.getReturnType()));
+        for (Class<?> type : getParameterTypes()) {
+            shorty.append(shortyOf(type));
+        }
+        return shorty.toString();
+    }
+
+    private static char shortyOf(Class<?> type) {
+        if (!type.isPrimitive()) {
+            return 'L';
+        } else if (type == int.class) {
+            return 'I';
+        } else if (type == long.class) {
+            return 'J';
+        } else if (type == boolean.class) {
+            return 'Z';
+        } else if (type == byte.class) {
+            return 'B';
+        } else if (type == char.class) {
+            return 'C';
+        } else if (type == short.class) {
+            return 'S';
+        } else if (type == float.class) {
+            return 'F';
+        } else if (type == double.class) {
+            return 'D';
+        } else {
+            return 'V';
+        }
+    }
+
     public String toGenericString() {
         if (constructor != null) {
             return constructor.toGenericString();
@@ -251,6 +289,31 @@ public class ArtMethod {
         return Offset.read(address, Offset.ART_JNI_ENTRY_OFFSET);
     }
 
+    /**
+     * read quick code, jni entry and access flags of all methods in one native call
+     *
+     * @return struct-of-arrays, see {@link Offset#readEntryFields(long[])}
+     */
+    public static long[] readEntryFields(ArtMethod[] methods) {
+        return Offset.readEntryFields(addressesOf(methods));
+    }
+
+    /**
+     * write quick code, jni entry and access flags of all methods in one native call
+     *
+     * @param values same layout as {@link #readEntryFields(ArtMethod[])}
+     */
+    public static void writeEntryFields(ArtMethod[] methods, long[] values) {
+        Offset.writeEntryFields(addressesOf(methods), values);
+    }
+
+    private static long[] addressesOf(ArtMethod[] methods) {
+        long[] addresses = new long[methods.length];
+        for (int i = 0; i < methods.length; i++) {
+            addresses[i] = methods[i].address;
+        }
+        return addresses;
+    }
 
     public ArtMethod backup() {
         try {
@@ -3,11 +3,51 @@ package profiler.dodola.lib;
 import android.util.Log;
 
 import java.lang.reflect.Method;
+import java.nio.ByteBuffer;
 
 /**
  * Created by dodola on 2018/10/22.
  */
 public class InnerHooker {
+    /**
+     * indexes into {@link #poolStats()}, followed by {@link #POOL_STAT_CLASS_COUNT} in-use block
+     * counts, one per size class from 16 to 2048 bytes
+     */
+    public static final int POOL_STAT_MAPPED_BYTES = 0;
+    public static final int POOL_STAT_USED_BYTES = 1;
+    public static final int POOL_STAT_REQUESTED_BYTES = 2;
+    public static final int POOL_STAT_ALLOCATIONS = 3;
+    public static final int POOL_STAT_FREES = 4;
+    public static final int POOL_STAT_MMAP_CALLS = 5;
+    public static final int POOL_STAT_MUNMAP_CALLS = 6;
+    public static final int POOL_STAT_CACHED_PAGES = 7;
+    public static final int POOL_STAT_CLASS_BLOCKS = 8;
+    public static final int POOL_STAT_CLASS_COUNT = 8;
+
+    /**
+     * indexes into {@link #trampolineStats()}
+     */
+    public static final int TRAMPOLINE_STAT_VARIANT = 0;
+    public static final int TRAMPOLINE_STAT_CPU_FEATURES = 1;
+    public static final int TRAMPOLINE_STAT_CPU_SOURCE = 2;
+    public static final int TRAMPOLINE_STAT_HWCAP = 3;
+    public static final int TRAMPOLINE_STAT_HWCAP2 = 4;
+    public static final int TRAMPOLINE_STAT_BLOCKS = 5;
+    public static final int TRAMPOLINE_STAT_TRAMPOLINES = 6;
+    public static final int TRAMPOLINE_STAT_CODE_BYTES = 7;
+    public static final int TRAMPOLINE_STAT_CONSTANT_BYTES = 8;
+    public static final int TRAMPOLINE_STAT_SHARED_CONSTANT_HITS = 9;
+    public static final int TRAMPOLINE_STAT_ICACHE_RANGES = 10;
+    public static final int TRAMPOLINE_STAT_ICACHE_FLUSHES = 11;
+    public static final int TRAMPOLINE_STAT_ICACHE_BATCHES = 12;
+
+    /**
+     * values of {@link #TRAMPOLINE_STAT_VARIANT}
+     */
+    public static final int TRAMPOLINE_VARIANT_A32 = 0;
+    public static final int TRAMPOLINE_VARIANT_X64_SSE = 1;
+    public static final int TRAMPOLINE_VARIANT_X64_AVX = 2;
+
     private InnerHooker() {
     }
 
@@ -19,15 +59,63 @@ public class InnerHooker {
 
     public static native byte[] memget(long src, int length);
 
+    public static native void memgetInto(long src, byte[] dest, int offset, int length);
+
+    public static native void memgetv(long[] addresses, int[] lengths, byte[] dest);
+
+    public static native void memputv(byte[] src, long[] addresses, int[] lengths);
+
+    public static native void memgetDirect(long src, ByteBuffer dest, int offset, int length);
+
+    public static native void memputDirect(ByteBuffer src, int offset, int length, long dest);
+
     public static native long getMethodAddress(Object method);
 
+    public static native void readFields(long[] methods, int[] offsets, int[] widths, long[] out);
+
+    public static native void writeFields(long[] methods, int[] offsets, int[] widths, long[] values);
+
     public static native void testMethod(Object method, int flags, Object backup);
 
+    /**
+     * same as calling {@link #testMethod(Object, int, Object)} for every pair, but the instruction
+     * cache is flushed once for all trampolines, and no method is hooked if any trampoline fails
+     *
+     * @throws NullPointerException if either array or any of their elements is null
+     */
+    public static native void testMethods(Object[] methods, int flags, Object[] backups);
+
+    /**
+     * same as {@link #testMethod(Object, int, Object)}, but the hook entry is a libffi closure built
+     * from {@code shorty}, so the native callback receives typed arguments
+     *
+     * @param shorty see {@link ArtMethod#getShorty()}
+     * @throws NullPointerException if {@code shorty} is null
+     */
+    public static native void testMethodTyped(Object method, int flags, Object backup, String shorty);
+
+    /**
+     * same as {@link #testMethodTyped(Object, int, Object, String)}, but the native callback receives
+     * the arguments packed in Java slot order (long/double take two slots) instead of one pointer
+     * per argument
+     *
+     * @throws NullPointerException if {@code shorty} is null
+     */
+    public static native void testMethodRaw(Object method, int flags, Object backup, String shorty);
+
 
     public static native long mmap(int length);
 
     public static native boolean munmap(long address, int length);
 
+    public static native long[] poolStats();
+
+    /**
+     * the trampoline variant picked for this CPU, the detected CPU features and the trampoline
+     * arena usage, see the {@code TRAMPOLINE_STAT_*} indexes
+     */
+    public static native long[] trampolineStats();
+
     public static void put(byte[] bytes, long dest) {
         memput(bytes, dest);
     }
@@ -37,12 +125,56 @@ public class InnerHooker {
         return bytes;
     }
 
+    /**
+     * read {@code length} bytes at {@code src} into {@code dest[offset]}, without allocating
+     */
+    public static void get(long src, byte[] dest, int offset, int length) {
+        memgetInto(src, dest, offset, length);
+    }
+
+    /**
+     * read every (addresses[i], lengths[i]) range back to back into {@code dest} in one call
+     */
+    public static void gather(long[] addresses, int[] lengths, byte[] dest) {
+        memgetv(addresses, lengths, dest);
+    }
+
+    /**
+     * write {@code src} back to back into every (addresses[i], lengths[i]) range in one call
+     */
+    public static void scatter(byte[] src, long[] addresses, int[] lengths) {
+        memputv(src, addresses, lengths);
+    }
+
+    /**
+     * zero-copy read into a direct buffer, {@code offset} is absolute and position is untouched
+     */
+    public static void get(long src, ByteBuffer dest, int offset, int length) {
+        memgetDirect(src, dest, offset, length);
+    }
+
+    /**
+     * zero-copy write from a direct buffer, {@code offset} is absolute and position is untouched
+     */
+    public static void put(ByteBuffer src, int offset, int length, long dest) {
+        memputDirect(src, offset, length, dest);
+    }
+
 
+    /**
+     * allocate zeroed RWX memory from the native page pool, small requests share pages
+     *
+     * @return the address, 0 when failed
+     */
     public static long map(int length) {
         long m = mmap(length);
         return m;
     }
 
+    /**
+     * @param length must be the same length passed to {@link #map(int)}
+     * @return false if the address was not mapped by {@link #map(int)} or was already unmapped
+     */
     public static boolean unmap(long address, int length) {
         return munmap(address, length);
     }
@@ -26,8 +26,20 @@ class Offset {
      */
     static Offset ART_JNI_ENTRY_OFFSET;
 
+    /**
+     * index of each field in the struct-of-arrays returned by {@link #readEntryFields(long[])}
+     */
+    static final int FIELD_QUICK_CODE = 0;
+    static final int FIELD_JNI_ENTRY = 1;
+    static final int FIELD_ACCESS_FLAGS = 2;
+    static final int FIELD_COUNT = 3;
+
+    private static int[] entryFieldOffsets;
+    private static int[] entryFieldWidths;
+
     static {
         initFields();
+        initEntryFieldLayout();
     }
 
     private enum BitWidth {
@@ -86,6 +98,41 @@ class Offset {
     }
 
 
+    /**
+     * read quick code, jni entry and access flags of every method in one native call
+     *
+     * @param bases the ArtMethod addresses
+     * @return struct-of-arrays, the field {@code FIELD_*} of {@code bases[i]} is at
+     * {@code [FIELD_* * bases.length + i]}
+     */
+    public static long[] readEntryFields(long[] bases) {
+        long[] out = new long[FIELD_COUNT * bases.length];
+        InnerHooker.readFields(bases, entryFieldOffsets, entryFieldWidths, out);
+        return out;
+    }
+
+    /**
+     * write quick code, jni entry and access flags of every method in one native call
+     *
+     * @param bases  the ArtMethod addresses
+     * @param values same layout as {@link #readEntryFields(long[])}
+     */
+    public static void writeEntryFields(long[] bases, long[] values) {
+        InnerHooker.writeFields(bases, entryFieldOffsets, entryFieldWidths, values);
+    }
+
+    private static void initEntryFieldLayout() {
+        Offset[] fields = new Offset[FIELD_COUNT];
+        fields[FIELD_QUICK_CODE] = ART_QUICK_CODE_OFFSET;
+        fields[FIELD_JNI_ENTRY] = ART_JNI_ENTRY_OFFSET;
+        fields[FIELD_ACCESS_FLAGS] = ART_ACCESS_FLAG_OFFSET;
+        entryFieldOffsets = new int[FIELD_COUNT];
+        entryFieldWidths = new int[FIELD_COUNT];
+        for (int i = 0; i < FIELD_COUNT; i++) {
+            entryFieldOffsets[i] = (int) fields[i].offset;
+            entryFieldWidths[i] = fields[i].length.width;
+        }
+    }
 
     private static void initFields() {
         ART_QUICK_CODE_OFFSET = new Offset();